@@ -0,0 +1,692 @@
+/**
+ * @brief Batch carving on a farm of forked worker processes
+ *
+ * The supervisor hands images to N forked workers through one ring of slots
+ * per worker in POSIX shared memory. A slot names the job only: each worker
+ * decodes its image into the slot itself, so decoding runs on all workers in
+ * parallel instead of serially in the supervisor. JPEGs go scanline by
+ * scanline from libjpeg straight into the slot; other formats (and JPEGs
+ * libjpeg cannot turn into RGB) fall back to stb, which decodes to the heap,
+ * and are copied in. Workers then run the engine on the slot memory itself
+ * (source view in, carved view out), so nothing is serialised or copied
+ * between processes; each worker keeps its own CarveBuffers, and throughput
+ * scales with the worker count until memory bandwidth runs out.
+ *
+ *     seam_carving_batch [-w workers] [-s percent] [-a greedy|dynamic] [--dp16]
+ *                        [-d slots per worker] [-m MB per slot] [-o dir]
+ *                        [--stream] [--metrics file] image...
+ *
+ * --dp16 runs the dynamic programming seam search in 16-bit levels
+ * (SeamCarving::DpMemory::QUANTIZED): faster, seams near-optimal.
+ *
+ * A worker that crashes is restarted on the same ring and picks up the slot
+ * it was working on; a slot that took down kMaxAttempts workers is reported
+ * as failed and skipped, so one bad image cannot stall the queue.
+ *
+ * Each worker publishes its latency histograms and counters in its ring;
+ * the supervisor merges them (including those of crashed workers) into the
+ * summary and, with --metrics, a Prometheus text file.
+ *
+ * --stream skips the farm: each image is carved with greedy seams while it
+ * decodes (SeamCarving::StreamingCarver), on -w threads of this process.
+ * JPEGs go scanline by scanline from libjpeg to a carved JPEG and never sit
+ * in memory whole, so images of any height (and larger than a slot) work;
+ * other formats are decoded by stb first and written as PNG.
+ *
+ * POSIX only (fork, shm_open, process-shared semaphores).
+ */
+#include "cost_model.h"
+#include "jpeg_decoder.h"
+#include "metrics.h"
+#include "seam_carving.h"
+#include "streaming_carve.h"
+
+#include <fmt/format.h>
+#include <spdlog/spdlog.h>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include <stb_image_write.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <deque>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <semaphore.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace {
+
+    static_assert(std::atomic<std::uint64_t>::is_always_lock_free, "ring indices must be address-free atomics");
+
+    /// Workers a slot may crash before it is given up
+    constexpr int kMaxAttempts = 2;
+
+    enum SlotStatus : std::int32_t {
+        SLOT_OK = 0,
+        SLOT_FAILED = 1
+    };
+
+    /**
+     * @brief One image in flight, followed in shared memory by its pixels
+     *
+     * The supervisor fills in the job and settings; the worker decodes the
+     * input image into the slot's pixel area and writes the sizes and the
+     * carved output, which starts right after the largest input the slot can
+     * hold.
+     */
+    struct SlotHeader {
+        std::uint64_t job;      ///< Index into the job list every worker inherited through fork
+        float scale_percent;
+        std::int32_t algorithm;
+        std::int32_t dp_memory;
+        std::int32_t width;     ///< Set by the worker once decoded
+        std::int32_t height;
+        std::int32_t channels;
+        std::int32_t target_width;
+        std::int32_t status;
+        std::int32_t attempts;  ///< Workers that started on this slot
+        double decode_ms;
+        double carve_ms;
+    };
+
+    /**
+     * @brief Single-producer (supervisor) single-consumer (worker) ring
+     *
+     * Slot k of the sequence lives at index k % depth. The supervisor fills
+     * slots up to `submitted`, the worker carves them up to `completed`; the
+     * supervisor's own `released` index (not shared) frees them again.
+     */
+    struct RingHeader {
+        sem_t items;  ///< Posted per submitted slot and on shutdown
+        std::atomic<std::uint64_t> submitted;
+        std::atomic<std::uint64_t> completed;
+        std::atomic<std::int32_t> shutdown;
+        /// Worker metrics as of its last completed slot; read once the worker exited
+        Metrics::Snapshot metrics;
+    };
+
+    /// Start of the segment: what every worker shares with the supervisor
+    struct ControlHeader {
+        sem_t results;  ///< Posted by workers per completed slot
+    };
+
+    constexpr std::size_t kPage = 4096;
+
+    std::size_t round_up(std::size_t bytes) {
+        return (bytes + kPage - 1) / kPage * kPage;
+    }
+
+    /**
+     * @brief The shared memory segment: control page, then one ring per worker
+     *
+     * Created with shm_open and unlinked right after mapping, so no name is
+     * left behind whatever happens to the processes; forked workers inherit
+     * the mapping.
+     */
+    class SharedSegment {
+    public:
+        SharedSegment(int workers, int depth, std::size_t image_bytes)
+            : workers_(workers), depth_(depth), image_bytes_(round_up(image_bytes)) {
+            slot_bytes_ = round_up(sizeof(SlotHeader)) + 2 * image_bytes_;
+            ring_bytes_ = round_up(sizeof(RingHeader)) + static_cast<std::size_t>(depth_) * slot_bytes_;
+            bytes_ = round_up(sizeof(ControlHeader)) + static_cast<std::size_t>(workers_) * ring_bytes_;
+
+            std::string name = fmt::format("/flink-farm-{}", getpid());
+            int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+            if (fd < 0) {
+                throw std::runtime_error(fmt::format("shm_open failed: {}", std::strerror(errno)));
+            }
+            // Pages are only backed once touched, so large slots cost nothing until used
+            if (ftruncate(fd, static_cast<off_t>(bytes_)) != 0) {
+                close(fd);
+                shm_unlink(name.c_str());
+                throw std::runtime_error(fmt::format("ftruncate failed: {}", std::strerror(errno)));
+            }
+            void* base = mmap(nullptr, bytes_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            close(fd);
+            shm_unlink(name.c_str());
+            if (base == MAP_FAILED) {
+                throw std::runtime_error(fmt::format("mmap failed: {}", std::strerror(errno)));
+            }
+            base_ = static_cast<unsigned char*>(base);
+
+            sem_init(&control()->results, 1, 0);
+            for (int w = 0; w < workers_; w++) {
+                RingHeader* ring = new (ring_base(w)) RingHeader;
+                sem_init(&ring->items, 1, 0);
+                ring->submitted = 0;
+                ring->completed = 0;
+                ring->shutdown = 0;
+            }
+        }
+
+        ~SharedSegment() {
+            munmap(base_, bytes_);
+        }
+
+        SharedSegment(const SharedSegment&) = delete;
+        SharedSegment& operator=(const SharedSegment&) = delete;
+
+        ControlHeader* control() const { return reinterpret_cast<ControlHeader*>(base_); }
+        RingHeader* ring(int worker) const { return reinterpret_cast<RingHeader*>(ring_base(worker)); }
+
+        SlotHeader* slot(int worker, std::uint64_t sequence) const {
+            return reinterpret_cast<SlotHeader*>(slot_base(worker, sequence));
+        }
+        unsigned char* input(int worker, std::uint64_t sequence) const {
+            return slot_base(worker, sequence) + round_up(sizeof(SlotHeader));
+        }
+        unsigned char* output(int worker, std::uint64_t sequence) const {
+            return input(worker, sequence) + image_bytes_;
+        }
+
+        int depth() const { return depth_; }
+        std::size_t image_bytes() const { return image_bytes_; }
+        std::size_t bytes() const { return bytes_; }
+
+    private:
+        unsigned char* ring_base(int worker) const {
+            return base_ + round_up(sizeof(ControlHeader)) + static_cast<std::size_t>(worker) * ring_bytes_;
+        }
+        unsigned char* slot_base(int worker, std::uint64_t sequence) const {
+            return ring_base(worker) + round_up(sizeof(RingHeader)) + (sequence % depth_) * slot_bytes_;
+        }
+
+        int workers_;
+        int depth_;
+        std::size_t image_bytes_;
+        std::size_t slot_bytes_ = 0;
+        std::size_t ring_bytes_ = 0;
+        std::size_t bytes_ = 0;
+        unsigned char* base_ = nullptr;
+    };
+
+    void wait_semaphore(sem_t* semaphore) {
+        while (sem_wait(semaphore) != 0 && errno == EINTR) {
+        }
+    }
+
+    struct Job {
+        std::string input;
+        std::string output;
+    };
+
+    /**
+     * Decode an image into the input area of its slot and record its size.
+     *
+     * @param path Image file path
+     * @param pixels Input area of the slot
+     * @param capacity Bytes the input area holds
+     * @param slot Receives width, height and channels
+     * @return False when the image cannot be decoded or does not fit
+     */
+    bool decode_input(const std::string& path, unsigned char* pixels, std::size_t capacity, SlotHeader& slot) {
+        int width = 0, height = 0, channels = 3;
+        auto too_large = [&] {
+            std::size_t bytes = static_cast<std::size_t>(width) * height * channels;
+            if (bytes <= capacity) {
+                return false;
+            }
+            spdlog::error("{} is {:.0f} MB, more than a slot holds (-m)", path, bytes / 1048576.0);
+            return true;
+        };
+
+        bool decoded = false;
+        if (Jpeg::is_jpeg(path)) {
+            decoded = Jpeg::decode_into(path, pixels, capacity, width, height);
+            if (!decoded && too_large()) {
+                return false;
+            }
+        }
+        if (!decoded) {
+            // stb has no scanline API: the image is decoded to the heap and copied
+            int file_channels = 0;
+            if (!stbi_info(path.c_str(), &width, &height, &file_channels)) {
+                spdlog::error("Failed to load image: {}", path);
+                return false;
+            }
+            if (too_large()) {
+                return false;
+            }
+            unsigned char* heap = stbi_load(path.c_str(), &width, &height, &file_channels, STBI_rgb);
+            if (!heap) {
+                spdlog::error("Failed to load image: {}", path);
+                return false;
+            }
+            std::memcpy(pixels, heap, static_cast<std::size_t>(width) * height * channels);
+            stbi_image_free(heap);
+        }
+        slot.width = width;
+        slot.height = height;
+        slot.channels = channels;
+        return true;
+    }
+
+    /// Body of a forked worker: decode and carve slots of its ring until shutdown
+    [[noreturn]] void worker_main(const SharedSegment& segment, int worker, const std::vector<Job>& jobs) {
+        RingHeader* ring = segment.ring(worker);
+        SeamCarving::CarveBuffers buffers;
+        // Metrics inherited through fork belong to the supervisor
+        Metrics::reset();
+        while (true) {
+            wait_semaphore(&ring->items);
+            std::uint64_t sequence = ring->completed.load(std::memory_order_acquire);
+            if (sequence == ring->submitted.load(std::memory_order_acquire)) {
+                if (ring->shutdown.load()) {
+                    _exit(0);
+                }
+                continue;
+            }
+
+            SlotHeader* slot = segment.slot(worker, sequence);
+            slot->attempts++;
+            auto publish = [&] {
+                ring->metrics = Metrics::snapshot();
+                ring->completed.store(sequence + 1, std::memory_order_release);
+                sem_post(&segment.control()->results);
+            };
+
+            auto start = std::chrono::steady_clock::now();
+            if (!decode_input(jobs[slot->job].input, segment.input(worker, sequence), segment.image_bytes(), *slot)) {
+                slot->status = SLOT_FAILED;
+                publish();
+                continue;
+            }
+            slot->target_width = std::max(1, static_cast<int>(slot->width * slot->scale_percent / 100.0f));
+            auto decoded = std::chrono::steady_clock::now();
+            slot->decode_ms = std::chrono::duration<double, std::milli>(decoded - start).count();
+
+            SeamCarving::ImageView src = SeamCarving::ImageView::packed(
+                segment.input(worker, sequence), slot->width, slot->height, slot->channels);
+            SeamCarving::MutableImageView dst = SeamCarving::MutableImageView::packed(
+                segment.output(worker, sequence), slot->target_width, slot->height, slot->channels);
+            if (slot->target_width < slot->width) {
+                buffers.set_dp_memory(static_cast<SeamCarving::DpMemory>(slot->dp_memory));
+                SeamCarving::reduce_width_iteratively(src, dst, buffers,
+                                                      static_cast<SeamCarving::Algorithm>(slot->algorithm));
+            } else {
+                std::memcpy(dst.data, src.data, static_cast<std::size_t>(src.stride) * src.height);
+            }
+            slot->carve_ms =
+                std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - decoded).count();
+            slot->status = SLOT_OK;
+            publish();
+        }
+    }
+
+    struct Options {
+        int workers = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+        int depth = 2;
+        std::size_t slot_mb = 64;
+        float scale_percent = 50.0f;
+        SeamCarving::Algorithm algorithm = SeamCarving::Algorithm::DYNAMIC;
+        SeamCarving::DpMemory dp_memory = SeamCarving::DpMemory::FULL;
+        std::string output_dir = ".";
+        std::string metrics_file;
+        bool stream = false;
+    };
+
+    /**
+     * @brief Forks the workers, keeps their rings fed and restarts crashed ones
+     */
+    class Supervisor {
+    public:
+        Supervisor(const Options& options, std::vector<Job> jobs)
+            : options_(options), jobs_(std::move(jobs)), segment_(options.workers, options.depth, options.slot_mb << 20),
+              pids_(options.workers, -1), released_(options.workers, 0) {
+            for (std::size_t i = 0; i < jobs_.size(); i++) {
+                pending_.push_back(i);
+            }
+        }
+
+        /// @return Exit status: 0 when every image was carved
+        int run() {
+            auto start = std::chrono::steady_clock::now();
+            for (int w = 0; w < options_.workers; w++) {
+                spawn(w);
+            }
+            fmt::print("{} image(s), {} worker(s), {} slot(s) of {} MB each\n", jobs_.size(), options_.workers,
+                       options_.depth, options_.slot_mb);
+
+            while (!pending_.empty() || in_flight() > 0) {
+                fill_rings();
+                wait_for_results();
+                collect_results();
+                reap_workers();
+            }
+            shutdown();
+
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            fmt::print("{} carved, {} failed, {} worker restart(s) in {:.2f}s ({:.2f} images/s)\n", carved_, failed_,
+                       restarts_, seconds, carved_ / std::max(seconds, 1e-9));
+            metrics_.seconds = seconds;
+            fmt::print("{}", Metrics::summary(metrics_));
+            if (!options_.metrics_file.empty() && !Metrics::write_text_file(metrics_, options_.metrics_file)) {
+                spdlog::error("Failed to write {}", options_.metrics_file);
+            }
+            return failed_ == 0 ? 0 : 1;
+        }
+
+    private:
+        int in_flight() const {
+            int count = 0;
+            for (int w = 0; w < options_.workers; w++) {
+                count += static_cast<int>(segment_.ring(w)->submitted.load() - released_[w]);
+            }
+            return count;
+        }
+
+        void spawn(int worker) {
+            // A restarted worker finds as many items as slots are waiting
+            RingHeader* ring = segment_.ring(worker);
+            sem_destroy(&ring->items);
+            sem_init(&ring->items, 1, static_cast<unsigned int>(ring->submitted.load() - ring->completed.load()));
+
+            pid_t pid = fork();
+            if (pid == 0) {
+                worker_main(segment_, worker, jobs_);
+            }
+            if (pid < 0) {
+                throw std::runtime_error(fmt::format("fork failed: {}", std::strerror(errno)));
+            }
+            pids_[worker] = pid;
+        }
+
+        // Hand queued images to the free slots of the least loaded rings
+        void fill_rings() {
+            while (!pending_.empty()) {
+                int best = -1;
+                std::uint64_t best_load = segment_.depth();
+                for (int w = 0; w < options_.workers; w++) {
+                    std::uint64_t load = segment_.ring(w)->submitted.load() - released_[w];
+                    if (load < best_load) {
+                        best = w;
+                        best_load = load;
+                    }
+                }
+                if (best < 0) {
+                    return;
+                }
+                std::size_t job = pending_.front();
+                pending_.pop_front();
+                submit(best, job);
+            }
+        }
+
+        void submit(int worker, std::size_t job) {
+            RingHeader* ring = segment_.ring(worker);
+            std::uint64_t sequence = ring->submitted.load();
+            SlotHeader* slot = segment_.slot(worker, sequence);
+
+            // The worker decodes the image; until it did, the slot holds no size
+            *slot = SlotHeader{};
+            slot->job = job;
+            slot->scale_percent = options_.scale_percent;
+            slot->algorithm = static_cast<std::int32_t>(options_.algorithm);
+            slot->dp_memory = static_cast<std::int32_t>(options_.dp_memory);
+            slot->status = SLOT_FAILED;
+
+            ring->submitted.store(sequence + 1, std::memory_order_release);
+            sem_post(&ring->items);
+        }
+
+        void wait_for_results() {
+            // Wakes on a result or after a short timeout to notice crashed workers
+            timespec deadline{};
+            clock_gettime(CLOCK_REALTIME, &deadline);
+            deadline.tv_nsec += 100 * 1000 * 1000;
+            if (deadline.tv_nsec >= 1000 * 1000 * 1000) {
+                deadline.tv_sec++;
+                deadline.tv_nsec -= 1000 * 1000 * 1000;
+            }
+            if (sem_timedwait(&segment_.control()->results, &deadline) == 0) {
+                // Drain the other posts; every ring is checked anyway
+                while (sem_trywait(&segment_.control()->results) == 0) {
+                }
+            }
+        }
+
+        void collect_results() {
+            for (int w = 0; w < options_.workers; w++) {
+                std::uint64_t completed = segment_.ring(w)->completed.load(std::memory_order_acquire);
+                for (; released_[w] < completed; released_[w]++) {
+                    SlotHeader* slot = segment_.slot(w, released_[w]);
+                    const Job& job = jobs_[slot->job];
+                    if (slot->status != SLOT_OK) {
+                        failed_++;
+                        continue;
+                    }
+                    // Written straight from the worker's output in shared memory
+                    if (!stbi_write_png(job.output.c_str(), slot->target_width, slot->height, slot->channels,
+                                        segment_.output(w, released_[w]), slot->target_width * slot->channels)) {
+                        spdlog::error("Failed to write {}", job.output);
+                        failed_++;
+                        continue;
+                    }
+                    carved_++;
+                    fmt::print("[worker {}] {} {}x{} -> {} px, decoded in {:.0f}ms, carved in {:.0f}ms\n", w,
+                               job.input, slot->width, slot->height, slot->target_width, slot->decode_ms,
+                               slot->carve_ms);
+                }
+            }
+        }
+
+        void reap_workers() {
+            int status = 0;
+            pid_t pid;
+            while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
+                auto it = std::find(pids_.begin(), pids_.end(), pid);
+                if (it == pids_.end()) {
+                    continue;
+                }
+                int worker = static_cast<int>(it - pids_.begin());
+                RingHeader* ring = segment_.ring(worker);
+                std::uint64_t sequence = ring->completed.load();
+                spdlog::warn("Worker {} (pid {}) died ({}), restarting it", worker, pid,
+                             WIFSIGNALED(status) ? fmt::format("signal {}", WTERMSIG(status))
+                                                 : fmt::format("exit {}", WEXITSTATUS(status)));
+
+                // The dead worker cannot race us: give up a slot that keeps crashing workers
+                if (sequence < ring->submitted.load()) {
+                    SlotHeader* slot = segment_.slot(worker, sequence);
+                    if (slot->attempts >= kMaxAttempts) {
+                        spdlog::error("Giving up {} after {} crashed workers", jobs_[slot->job].input, slot->attempts);
+                        slot->status = SLOT_FAILED;
+                        ring->completed.store(sequence + 1, std::memory_order_release);
+                    }
+                }
+                retire_metrics(worker);
+                restarts_++;
+                spawn(worker);
+            }
+        }
+
+        void shutdown() {
+            for (int w = 0; w < options_.workers; w++) {
+                segment_.ring(w)->shutdown = 1;
+                sem_post(&segment_.ring(w)->items);
+            }
+            for (int w = 0; w < options_.workers; w++) {
+                int status = 0;
+                waitpid(pids_[w], &status, 0);
+                retire_metrics(w);
+            }
+        }
+
+        // Only called once the worker exited, so its ring metrics are stable
+        void retire_metrics(int worker) {
+            RingHeader* ring = segment_.ring(worker);
+            metrics_.merge(ring->metrics);
+            ring->metrics = Metrics::Snapshot();
+        }
+
+        Options options_;
+        std::vector<Job> jobs_;
+        SharedSegment segment_;
+        std::vector<pid_t> pids_;
+        std::vector<std::uint64_t> released_;  ///< Per ring: slots whose result was written
+        std::deque<std::size_t> pending_;      ///< Jobs not handed to a worker yet
+        int carved_ = 0;
+        int failed_ = 0;
+        int restarts_ = 0;
+        Metrics::Snapshot metrics_;  ///< Merged metrics of the workers that exited
+    };
+
+    std::string output_path(const std::string& dir, const std::string& input, const char* extension = "png") {
+        std::string name = input.substr(input.find_last_of("/\\") + 1);
+        name = name.substr(0, name.find_last_of('.'));
+        return fmt::format("{}/{}_carved.{}", dir, name, extension);
+    }
+
+    /// Carve one image with the streaming greedy carver
+    bool carve_streaming(const Options& options, const Job& job) {
+        if (Jpeg::is_jpeg(job.input)) {
+            return Jpeg::carve_streaming(job.input, output_path(options.output_dir, job.input, "jpg"),
+                                         options.scale_percent);
+        }
+
+        // stb has no scanline API: rows come from the decoded image, the
+        // output is still assembled row by row
+        int width = 0, height = 0, channels = 0;
+        unsigned char* pixels = stbi_load(job.input.c_str(), &width, &height, &channels, STBI_rgb);
+        if (!pixels) {
+            spdlog::error("Failed to load image: {}", job.input);
+            return false;
+        }
+        int target_width = std::max(1, static_cast<int>(width * options.scale_percent / 100.0f));
+        std::vector<unsigned char> carved(static_cast<std::size_t>(target_width) * height * 3);
+        SeamCarving::StreamingCarver carver(width, height, 3, width - target_width,
+                                            [&](int y, const unsigned char* row) {
+                                                std::memcpy(carved.data() + static_cast<std::size_t>(y) * target_width * 3,
+                                                            row, static_cast<std::size_t>(target_width) * 3);
+                                            });
+        for (int y = 0; y < height; y++) {
+            carver.push_row(pixels + static_cast<std::size_t>(y) * width * 3);
+        }
+        stbi_image_free(pixels);
+
+        if (!stbi_write_png(job.output.c_str(), target_width, height, 3, carved.data(), target_width * 3)) {
+            spdlog::error("Failed to write {}", job.output);
+            return false;
+        }
+        return true;
+    }
+
+    /// --stream: every image on one of options.workers threads, no worker processes
+    int run_streaming(const Options& options, const std::vector<Job>& jobs) {
+        auto start = std::chrono::steady_clock::now();
+        int threads = std::max(1, std::min(options.workers, static_cast<int>(jobs.size())));
+        fmt::print("{} image(s), streaming greedy carve on {} thread(s)\n", jobs.size(), threads);
+
+        std::atomic<std::size_t> next{0};
+        std::atomic<int> carved{0};
+        std::atomic<int> failed{0};
+        std::vector<std::thread> pool;
+        for (int t = 0; t < threads; t++) {
+            pool.emplace_back([&] {
+                for (std::size_t job = next++; job < jobs.size(); job = next++) {
+                    if (carve_streaming(options, jobs[job])) {
+                        carved++;
+                    } else {
+                        failed++;
+                    }
+                }
+            });
+        }
+        for (std::thread& thread : pool) {
+            thread.join();
+        }
+
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        fmt::print("{} carved, {} failed in {:.2f}s ({:.2f} images/s)\n", carved.load(), failed.load(), seconds,
+                   carved / std::max(seconds, 1e-9));
+        Metrics::Snapshot metrics = Metrics::snapshot();
+        metrics.seconds = seconds;
+        fmt::print("{}", Metrics::summary(metrics));
+        if (!options.metrics_file.empty() && !Metrics::write_text_file(metrics, options.metrics_file)) {
+            spdlog::error("Failed to write {}", options.metrics_file);
+        }
+        return failed == 0 ? 0 : 1;
+    }
+
+    void usage(const char* program) {
+        fmt::print(stderr,
+                   "usage: {} [-w workers] [-s percent] [-a greedy|dynamic] [--dp16] [-d slots per worker]\n"
+                   "       [-m MB per slot] [-o output dir] [--stream] [--metrics file] image...\n",
+                   program);
+    }
+
+} // namespace
+
+int main(int argc, char** argv) {
+    spdlog::set_level(spdlog::level::warn);
+
+    Options options;
+    std::vector<Job> jobs;
+    std::vector<std::string> inputs;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "-w" && has_value) {
+            options.workers = std::max(1, std::atoi(argv[++i]));
+        } else if (arg == "-s" && has_value) {
+            options.scale_percent = std::min(100.0f, std::max(1.0f, static_cast<float>(std::atof(argv[++i]))));
+        } else if (arg == "-a" && has_value) {
+            std::string name = argv[++i];
+            options.algorithm = name == "greedy" ? SeamCarving::Algorithm::GREEDY : SeamCarving::Algorithm::DYNAMIC;
+        } else if (arg == "-d" && has_value) {
+            options.depth = std::max(1, std::atoi(argv[++i]));
+        } else if (arg == "-m" && has_value) {
+            options.slot_mb = static_cast<std::size_t>(std::max(1, std::atoi(argv[++i])));
+        } else if (arg == "-o" && has_value) {
+            options.output_dir = argv[++i];
+        } else if (arg == "--metrics" && has_value) {
+            options.metrics_file = argv[++i];
+        } else if (arg == "--dp16") {
+            options.dp_memory = SeamCarving::DpMemory::QUANTIZED;
+        } else if (arg == "--stream") {
+            options.stream = true;
+        } else if (!arg.empty() && arg[0] == '-') {
+            usage(argv[0]);
+            return 2;
+        } else {
+            inputs.push_back(arg);
+        }
+    }
+    if (inputs.empty()) {
+        usage(argv[0]);
+        return 2;
+    }
+    for (const std::string& input : inputs) {
+        jobs.push_back({input, output_path(options.output_dir, input)});
+    }
+    if (options.stream) {
+        return run_streaming(options, jobs);
+    }
+
+    // Calibrated once here; forked (and restarted) workers inherit the model
+    SeamCarving::CostModel::host();
+    try {
+        Supervisor supervisor(options, std::move(jobs));
+        return supervisor.run();
+    } catch (const std::exception& error) {
+        fmt::print(stderr, "{}\n", error.what());
+        return 1;
+    }
+}
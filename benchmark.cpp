@@ -0,0 +1,265 @@
+/**
+ * @brief Benchmark of the engine's memory-bound passes
+ *
+ * Runs the energy, DP seam search and seam removal passes on a synthetic image
+ * once per huge page mode and reports wall time and dTLB misses per pass, then
+ * compares the float DP with the 16-bit saturating one (time, rows where the
+ * seams differ and how much more the 16-bit seam costs in float energy).
+ *
+ *     seam_carving_bench [width] [height] [repetitions]
+ *
+ * dTLB misses are read through perf_event_open; when the kernel denies access
+ * (see /proc/sys/kernel/perf_event_paranoid) only times are reported.
+ */
+#include "huge_pages.h"
+#include "seam_carving.h"
+
+#include <fmt/format.h>
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <random>
+#include <string>
+#include <vector>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+    /**
+     * @brief Hardware counter of dTLB load misses of the calling thread
+     */
+    class TlbMissCounter {
+    public:
+        TlbMissCounter() {
+#if defined(__linux__)
+            perf_event_attr attr{};
+            attr.type = PERF_TYPE_HW_CACHE;
+            attr.size = sizeof(attr);
+            attr.config = PERF_COUNT_HW_CACHE_DTLB |
+                          (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                          (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+            attr.disabled = 1;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            fd_ = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+#endif
+        }
+
+        ~TlbMissCounter() {
+#if defined(__linux__)
+            if (fd_ >= 0) {
+                close(fd_);
+            }
+#endif
+        }
+
+        TlbMissCounter(const TlbMissCounter&) = delete;
+        TlbMissCounter& operator=(const TlbMissCounter&) = delete;
+
+        bool available() const { return fd_ >= 0; }
+
+        void start() {
+#if defined(__linux__)
+            if (fd_ >= 0) {
+                ioctl(fd_, PERF_EVENT_IOC_RESET, 0);
+                ioctl(fd_, PERF_EVENT_IOC_ENABLE, 0);
+            }
+#endif
+        }
+
+        /// Misses since start(), 0 when unavailable
+        std::uint64_t stop() {
+            std::uint64_t count = 0;
+#if defined(__linux__)
+            if (fd_ >= 0) {
+                ioctl(fd_, PERF_EVENT_IOC_DISABLE, 0);
+                if (read(fd_, &count, sizeof(count)) != sizeof(count)) {
+                    count = 0;
+                }
+            }
+#endif
+            return count;
+        }
+
+    private:
+        int fd_ = -1;
+    };
+
+    struct Measurement {
+        double milliseconds = 0.0;
+        std::uint64_t tlb_misses = 0;
+    };
+
+    /// Best of `repetitions` runs (minimum time, misses of that run)
+    Measurement measure(TlbMissCounter& counter, int repetitions, const std::function<void()>& pass) {
+        Measurement best;
+        for (int i = 0; i < repetitions; i++) {
+            counter.start();
+            auto start = std::chrono::steady_clock::now();
+            pass();
+            auto end = std::chrono::steady_clock::now();
+            std::uint64_t misses = counter.stop();
+            double ms = std::chrono::duration<double, std::milli>(end - start).count();
+            if (i == 0 || ms < best.milliseconds) {
+                best = {ms, misses};
+            }
+        }
+        return best;
+    }
+
+    /// AnonHugePages of this process in kB, -1 when unknown
+    long anon_huge_pages_kb() {
+        std::ifstream smaps("/proc/self/smaps_rollup");
+        const std::string key = "AnonHugePages:";
+        std::string line;
+        while (std::getline(smaps, line)) {
+            if (line.compare(0, key.size(), key) == 0) {
+                return std::atol(line.c_str() + key.size());
+            }
+        }
+        return -1;
+    }
+
+    void run_mode(Memory::HugePageMode mode, int width, int height, int repetitions, TlbMissCounter& counter) {
+        Memory::set_huge_page_mode(mode);
+
+        // All buffers are allocated under the selected mode
+        const int channels = 3;
+        Memory::LargeBuffer<unsigned char> image(static_cast<size_t>(width) * height * channels);
+        std::mt19937 rng(42);
+        for (auto& value : image) {
+            value = static_cast<unsigned char>(rng() & 0xff);
+        }
+        SeamCarving::CarveBuffers buffers;
+        buffers.reserve(width, height, channels);
+
+        SeamCarving::ImageView src = SeamCarving::ImageView::packed(image.data(), width, height, channels);
+        SeamCarving::MatrixView<float> energy{buffers.energy.data(), width, height, width};
+        SeamCarving::MatrixView<float> dp{buffers.dp.data(), width, height, width};
+
+        Measurement energy_pass = measure(counter, repetitions, [&] {
+            SeamCarving::calculate_energy(src, energy);
+        });
+        Measurement dp_pass = measure(counter, repetitions, [&] {
+            SeamCarving::find_low_energy_seam_dyn(energy, dp, buffers.seam.data());
+        });
+        // Seam removal from the source into the working buffer (not in place, so it can repeat)
+        SeamCarving::MutableImageView working{buffers.pixels.data(), width - 1, height, channels,
+                                              static_cast<std::ptrdiff_t>(width) * channels};
+        Measurement remove_pass = measure(counter, repetitions, [&] {
+            SeamCarving::remove_seam(src, buffers.seam.data(), working);
+        });
+
+        auto misses = [&](const Measurement& m) {
+            return counter.available() ? fmt::format("{:>14}", m.tlb_misses) : fmt::format("{:>14}", "n/a");
+        };
+        fmt::print("{:<12} {:<8} {:>10.1f} {}\n", Memory::huge_page_mode_name(mode), "energy",
+                   energy_pass.milliseconds, misses(energy_pass));
+        fmt::print("{:<12} {:<8} {:>10.1f} {}\n", "", "dp", dp_pass.milliseconds, misses(dp_pass));
+        fmt::print("{:<12} {:<8} {:>10.1f} {}\n", "", "remove", remove_pass.milliseconds, misses(remove_pass));
+        long huge_kb = anon_huge_pages_kb();
+        if (huge_kb >= 0) {
+            fmt::print("{:<12} AnonHugePages while allocated: {} MB\n", "", huge_kb / 1024);
+        }
+    }
+
+    /// Float energy along a seam
+    double seam_cost(const SeamCarving::MatrixView<const float>& energy, const int* seam) {
+        double cost = 0.0;
+        for (int y = 0; y < energy.height; y++) {
+            cost += energy.row(y)[seam[y]];
+        }
+        return cost;
+    }
+
+    void compare_dp16(int width, int height, int repetitions, TlbMissCounter& counter) {
+        Memory::set_huge_page_mode(Memory::HugePageMode::TRANSPARENT);
+
+        // Smooth gradients with a little noise, so seams have a clear minimum to find
+        const int channels = 3;
+        Memory::LargeBuffer<unsigned char> image(static_cast<size_t>(width) * height * channels);
+        std::mt19937 rng(7);
+        for (int y = 0; y < height; y++) {
+            for (int x = 0; x < width; x++) {
+                unsigned char* pixel = image.data() + (static_cast<size_t>(y) * width + x) * channels;
+                int base = (x * 255 / width + y * 127 / height) & 0xff;
+                for (int c = 0; c < channels; c++) {
+                    pixel[c] = static_cast<unsigned char>(std::min(255, base + static_cast<int>(rng() % 8)));
+                }
+            }
+        }
+        SeamCarving::CarveBuffers buffers;
+        buffers.reserve(width, height, channels);
+        SeamCarving::ImageView src = SeamCarving::ImageView::packed(image.data(), width, height, channels);
+        SeamCarving::MatrixView<float> energy{buffers.energy.data(), width, height, width};
+        SeamCarving::calculate_energy(src, energy);
+
+        // Leave out the zero-energy border columns, which would win every search
+        SeamCarving::MatrixView<const float> interior{energy.data + 1, width - 2, height, energy.stride};
+        SeamCarving::MatrixView<float> dp{buffers.dp.data(), width - 2, height, width - 2};
+        std::vector<std::uint16_t> dp16(static_cast<size_t>(width) * height);
+        SeamCarving::MatrixView<std::uint16_t> dp16_view{dp16.data(), width - 2, height, width};
+        std::vector<std::uint64_t> offsets(height);
+        std::vector<int> seam(height), seam16(height);
+
+        Measurement float_pass = measure(counter, repetitions, [&] {
+            SeamCarving::find_low_energy_seam_dyn(interior, dp, seam.data());
+        });
+        Measurement int_pass = measure(counter, repetitions, [&] {
+            SeamCarving::find_low_energy_seam_dyn16(interior, dp16_view, offsets.data(), seam16.data());
+        });
+
+        int differing = 0;
+        for (int y = 0; y < height; y++) {
+            differing += seam[y] != seam16[y];
+        }
+        double cost = seam_cost(interior, seam.data());
+        double cost16 = seam_cost(interior, seam16.data());
+        fmt::print("\nDP seam search on a smooth image\n");
+        fmt::print("{:<12} {:>10} {:>14}\n", "dp", "ms", "seam cost");
+        fmt::print("{:<12} {:>10.1f} {:>14.1f}\n", "float", float_pass.milliseconds, cost);
+        fmt::print("{:<12} {:>10.1f} {:>14.1f}\n", "uint16", int_pass.milliseconds, cost16);
+        fmt::print("uint16 seam differs in {} of {} rows, costs {:+.3f}%\n", differing, height,
+                   cost > 0.0 ? (cost16 - cost) / cost * 100.0 : 0.0);
+    }
+
+} // namespace
+
+int main(int argc, char** argv) {
+    spdlog::set_level(spdlog::level::warn);
+
+    // Default: a 108 megapixel image
+    int width = argc > 1 ? std::atoi(argv[1]) : 12000;
+    int height = argc > 2 ? std::atoi(argv[2]) : 9000;
+    int repetitions = argc > 3 ? std::max(1, std::atoi(argv[3])) : 3;
+    if (width < 3 || height < 3) {
+        fmt::print(stderr, "usage: {} [width >= 3] [height >= 3] [repetitions]\n", argv[0]);
+        return 1;
+    }
+
+    TlbMissCounter counter;
+    fmt::print("{}x{} RGB ({:.1f} MP), best of {} run(s)\n", width, height,
+               static_cast<double>(width) * height / 1e6, repetitions);
+    if (!counter.available()) {
+        fmt::print("dTLB counter unavailable (perf_event_open denied or unsupported)\n");
+    }
+    fmt::print("{:<12} {:<8} {:>10} {:>14}\n", "huge pages", "pass", "ms", "dTLB misses");
+
+    for (Memory::HugePageMode mode : {Memory::HugePageMode::OFF, Memory::HugePageMode::TRANSPARENT,
+                                      Memory::HugePageMode::EXPLICIT}) {
+        run_mode(mode, width, height, repetitions, counter);
+    }
+    compare_dp16(width, height, repetitions, counter);
+    return 0;
+}
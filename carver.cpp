@@ -0,0 +1,389 @@
+#include "carver.h"
+#include "checkpoint.h"
+#include "metrics.h"
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cstring>
+#include <spdlog/spdlog.h>
+
+namespace SeamCarving {
+
+Carver::Carver(Algorithm algorithm) : algorithm_(algorithm) {}
+
+Carver::~Carver() = default;
+Carver::Carver(Carver&&) noexcept = default;
+Carver& Carver::operator=(Carver&&) noexcept = default;
+
+void Carver::set_image(const ImageView& image) {
+    width_ = image.width;
+    height_ = image.height;
+    channels_ = image.channels;
+    size_t row_bytes = static_cast<size_t>(width_) * channels_;
+    image_.resize(row_bytes * height_);
+    for (int y = 0; y < height_; y++) {
+        std::memcpy(image_.data() + y * row_bytes, image.row(y), row_bytes);
+    }
+    protection_ = Memory::LargeBuffer<float>();
+    order_.assign(static_cast<size_t>(width_) * height_, kNeverRemoved);
+    valid_seams_ = 0;
+    working_seam_ = -1;
+    reused_seams_ = 0;
+    revision_++;
+}
+
+void Carver::set_algorithm(Algorithm algorithm) {
+    if (algorithm != algorithm_) {
+        algorithm_ = algorithm;
+        valid_seams_ = 0;
+        working_seam_ = -1;
+        revision_++;
+    }
+}
+
+void Carver::set_smoothing(float sigma) {
+    sigma = std::max(sigma, 0.0f);
+    if (sigma != sigma_) {
+        sigma_ = sigma;
+        valid_seams_ = 0;
+        working_seam_ = -1;
+        revision_++;
+    }
+}
+
+void Carver::set_checkpoint(const std::string& path, double interval_seconds) {
+    if (path.empty()) {
+        checkpoint_.reset();
+    } else if (!checkpoint_ || checkpoint_->path() != path) {
+        checkpoint_ = std::make_unique<CheckpointWriter>(path);
+    }
+    checkpoint_interval_ = std::max(interval_seconds, 0.0);
+}
+
+void Carver::set_dp_memory(DpMemory mode) {
+    // The quantized search finds other seams than the float modes; degrading
+    // from it to a smaller float mode keeps them (carve() may do so mid-run)
+    bool entering = mode == DpMemory::QUANTIZED && buffers_.dp_memory != DpMemory::QUANTIZED;
+    bool leaving = mode == DpMemory::FULL && buffers_.dp_memory == DpMemory::QUANTIZED;
+    if (algorithm_ == Algorithm::DYNAMIC && (entering || leaving)) {
+        valid_seams_ = 0;
+        working_seam_ = -1;
+        revision_++;
+    }
+    buffers_.set_dp_memory(mode);
+}
+
+void Carver::release_scratch() {
+    CarveBuffers released;
+    released.dp_memory = buffers_.dp_memory;
+    released.threads = buffers_.threads;
+    buffers_ = std::move(released);
+    smoothed_.release();
+    working_seam_ = -1;
+}
+
+std::size_t Carver::footprint(int width, int height, int channels, int seams, DpMemory dp_memory, bool smoothing) {
+    size_t pixel_count = static_cast<size_t>(width) * height;
+    // Image, order map, protection and column map, plus the working buffers
+    size_t bytes = pixel_count * channels + 3 * pixel_count * sizeof(int) +
+                   static_cast<size_t>(seams) * height * sizeof(int) +
+                   CarveBuffers::footprint(width, height, channels, dp_memory);
+    if (smoothing) {
+        // Luma, its two blur passes and the energy (prefilter.h)
+        bytes += 4 * pixel_count * sizeof(float);
+    }
+    return bytes;
+}
+
+MatrixView<const float> Carver::protection() const {
+    if (protection_.empty()) {
+        return {nullptr, width_, height_, width_};
+    }
+    return {protection_.data(), width_, height_, width_};
+}
+
+void Carver::update_pixels(int x, int y, const ImageView& patch) {
+    if (patch.channels != channels_) {
+        spdlog::error("Pixel patch has {} channels, image has {}", patch.channels, channels_);
+        return;
+    }
+    Edit edit{std::max(x, 0), std::max(y, 0), std::min(x + patch.width, width_),
+              std::min(y + patch.height, height_), true, false};
+    if (edit.x0 >= edit.x1 || edit.y0 >= edit.y1) {
+        return;
+    }
+
+    bool changed = false;
+    size_t bytes = static_cast<size_t>(edit.x1 - edit.x0) * channels_;
+    for (int row = edit.y0; row < edit.y1; row++) {
+        unsigned char* out = image_.data() + (static_cast<size_t>(row) * width_ + edit.x0) * channels_;
+        const unsigned char* in = patch.row(row - y) + static_cast<size_t>(edit.x0 - x) * channels_;
+        if (std::memcmp(out, in, bytes) != 0) {
+            std::memcpy(out, in, bytes);
+            changed = true;
+        }
+    }
+    if (changed) {
+        revision_++;
+        invalidate(edit);
+    }
+}
+
+void Carver::update_protection(int x, int y, const MatrixView<const float>& weights) {
+    Edit edit{std::max(x, 0), std::max(y, 0), std::min(x + weights.width, width_),
+              std::min(y + weights.height, height_), false, true};
+    if (edit.x0 >= edit.x1 || edit.y0 >= edit.y1) {
+        return;
+    }
+    if (protection_.empty()) {
+        protection_.assign(static_cast<size_t>(width_) * height_, 0.0f);
+    }
+
+    bool changed = false;
+    for (int row = edit.y0; row < edit.y1; row++) {
+        float* out = protection_.data() + static_cast<size_t>(row) * width_;
+        const float* in = weights.row(row - y) + (edit.x0 - x);
+        for (int col = edit.x0; col < edit.x1; col++, in++) {
+            if (*in != out[col]) {
+                edit.raised_only = edit.raised_only && *in > out[col];
+                out[col] = *in;
+                changed = true;
+            }
+        }
+    }
+    if (changed) {
+        revision_++;
+        invalidate(edit);
+    }
+}
+
+void Carver::invalidate(const Edit& edit) {
+    int first = first_affected_seam(edit);
+    if (first < valid_seams_) {
+        spdlog::debug("Edit [{}, {}) x [{}, {}) keeps {} of {} seams",
+                      edit.x0, edit.x1, edit.y0, edit.y1, first, valid_seams_);
+    }
+    valid_seams_ = first;
+    // The working copy holds the old pixels; protection is looked up per seam
+    if (edit.pixels || working_seam_ > valid_seams_) {
+        working_seam_ = -1;
+    }
+}
+
+int Carver::first_affected_seam(const Edit& edit) const {
+    // Energy rows that can change: Sobel reaches one pixel beyond a pixel
+    // edit (plus the blur radius when smoothing), but border rows and
+    // columns stay zero whatever the pixels
+    int border = edit.pixels ? 1 : 0;
+    int reach = edit.pixels ? 1 + (sigma_ > 0.0f ? smoothed_.radius() : 0) : 0;
+    int row_begin = std::max(edit.y0 - reach, border);
+    int row_end = std::min(edit.y1 + reach, height_ - border);
+
+    // Working columns [begin, end) still holding the edited pixels of each
+    // edited row; removing a pixel left of them shifts the range
+    int rows = edit.y1 - edit.y0;
+    std::vector<int> begin(rows, edit.x0);
+    std::vector<int> end(rows, edit.x1);
+
+    for (int i = 0; i < valid_seams_; i++) {
+        const int* seam = seams_.data() + static_cast<size_t>(i) * height_;
+        int width = width_ - i;
+
+        for (int y = row_begin; y < row_end; y++) {
+            // Changed energies of working row y
+            int lo = INT_MAX;
+            int hi = INT_MIN;
+            for (int edited = std::max(edit.y0, y - reach); edited < std::min(edit.y1, y + reach + 1); edited++) {
+                int k = edited - edit.y0;
+                if (begin[k] < end[k]) {
+                    lo = std::min(lo, begin[k] - reach);
+                    hi = std::max(hi, end[k] + reach);
+                }
+            }
+            lo = std::max(lo, border);
+            hi = std::min(hi, width - border);
+            if (lo >= hi) {
+                continue;
+            }
+
+            bool affected;
+            if (algorithm_ == Algorithm::DYNAMIC && buffers_.dp_memory == DpMemory::QUANTIZED) {
+                // The quantization step follows the cost of a cheap seam, so
+                // any change may move every quantized cost
+                affected = true;
+            } else if (edit.raised_only) {
+                affected = seam[y] >= lo && seam[y] < hi;
+            } else if (algorithm_ == Algorithm::DYNAMIC || y == 0) {
+                // Any lowered energy may create a cheaper path / a new row 0 minimum
+                affected = true;
+            } else {
+                affected = seam[y - 1] + 1 >= lo && seam[y - 1] - 1 < hi;
+            }
+            if (affected) {
+                return i;
+            }
+        }
+
+        for (int k = 0; k < rows; k++) {
+            int removed = seam[edit.y0 + k];
+            if (removed < begin[k]) {
+                begin[k]--;
+                end[k]--;
+            } else if (removed < end[k]) {
+                end[k]--;
+            }
+        }
+    }
+    return valid_seams_;
+}
+
+void Carver::rebuild_working(int seam) {
+    size_t pixel_count = static_cast<size_t>(width_) * height_;
+    for (int& order : order_) {
+        if (order >= seam) {
+            order = kNeverRemoved;
+        }
+    }
+    if (buffers_.source_x.size() < pixel_count) {
+        buffers_.source_x.resize(pixel_count);
+    }
+
+    int working_width = width_ - seam;
+    build_carve_lookup(seam_order(), {buffers_.source_x.data(), working_width, height_, width_});
+    for (int y = 0; y < height_; y++) {
+        const int* columns = buffers_.source_x.data() + static_cast<size_t>(y) * width_;
+        const unsigned char* in = image_.data() + static_cast<size_t>(y) * width_ * channels_;
+        unsigned char* out = buffers_.pixels.data() + static_cast<size_t>(y) * width_ * channels_;
+        for (int x = 0; x < working_width; x++) {
+            std::memcpy(out + x * channels_, in + static_cast<size_t>(columns[x]) * channels_, channels_);
+        }
+    }
+    working_seam_ = seam;
+}
+
+int Carver::carve(int min_width, const ProgressCallback& progress) {
+    min_width = std::max(1, std::min(min_width, width_));
+    int seams_to_remove = width_ - min_width;
+    reused_seams_ = std::min(valid_seams_, seams_to_remove);
+    if (valid_seams_ >= seams_to_remove) {
+        return valid_seams_;
+    }
+
+    buffers_.reserve(width_, height_, channels_);
+    if (seams_.size() < static_cast<size_t>(seams_to_remove) * height_) {
+        seams_.resize(static_cast<size_t>(seams_to_remove) * height_);
+    }
+    if (working_seam_ != valid_seams_) {
+        rebuild_working(valid_seams_);
+    }
+
+    spdlog::info("Carving {}x{} down to {} px, reusing {} of {} seams",
+                 width_, height_, min_width, reused_seams_, seams_to_remove);
+    auto start_time = std::chrono::high_resolution_clock::now();
+    auto job_start = std::chrono::steady_clock::now();
+    int first_seam = valid_seams_;
+    auto finish_job = [&]() {
+        Metrics::record(Metrics::Latency::JOB, std::chrono::steady_clock::now() - job_start);
+        Metrics::add(Metrics::Counter::JOBS);
+        Metrics::add(Metrics::Counter::SEAMS, valid_seams_ - first_seam);
+        Metrics::add(Metrics::Counter::PIXELS, static_cast<std::uint64_t>(valid_seams_ - first_seam) * height_);
+    };
+
+    // Between seams the state is complete, so a checkpoint can be taken there
+    auto last_checkpoint = std::chrono::steady_clock::now();
+    auto checkpoint = [&](bool force) {
+        if (!checkpoint_) {
+            return;
+        }
+        auto now = std::chrono::steady_clock::now();
+        if (force || std::chrono::duration<double>(now - last_checkpoint).count() >= checkpoint_interval_) {
+            if (force) {
+                checkpoint_->wait();
+            }
+            if (checkpoint_->submit(*this)) {
+                last_checkpoint = now;
+            }
+        }
+    };
+
+    // Working rows keep the original stride while they shrink
+    std::ptrdiff_t pixel_stride = static_cast<std::ptrdiff_t>(width_) * channels_;
+    if (sigma_ > 0.0f) {
+        smoothed_.compute({buffers_.pixels.data(), width_ - valid_seams_, height_, channels_, pixel_stride}, sigma_,
+                          buffers_.threads);
+    }
+    while (valid_seams_ < seams_to_remove) {
+        checkpoint(false);
+        if (progress && !progress(valid_seams_, seams_to_remove)) {
+            spdlog::info("Carving aborted after {}/{} seams", valid_seams_, seams_to_remove);
+            finish_job();
+            checkpoint(true);
+            return valid_seams_;
+        }
+
+        auto seam_start = std::chrono::steady_clock::now();
+        int width = width_ - valid_seams_;
+        MutableImageView working{buffers_.pixels.data(), width, height_, channels_, pixel_stride};
+        MatrixView<int> columns{buffers_.source_x.data(), width, height_, width_};
+        MatrixView<float> energy{buffers_.energy.data(), width, height_, width};
+
+        if (sigma_ > 0.0f) {
+            MatrixView<float> smoothed = smoothed_.energy();
+            if (protection_.empty()) {
+                energy = smoothed;
+            } else {
+                for (int y = 0; y < height_; y++) {
+                    std::copy(smoothed.row(y), smoothed.row(y) + width, energy.row(y));
+                }
+            }
+        } else {
+            calculate_energy(working, energy);
+        }
+        if (!protection_.empty()) {
+            for (int y = 0; y < height_; y++) {
+                float* e = energy.row(y);
+                const int* source = columns.row(y);
+                const float* weights = protection_.data() + static_cast<size_t>(y) * width_;
+                for (int x = 0; x < width; x++) {
+                    e[x] += weights[source[x]];
+                }
+            }
+        }
+
+        auto energy_done = std::chrono::steady_clock::now();
+
+        int* seam = seams_.data() + static_cast<size_t>(valid_seams_) * height_;
+        find_low_energy_seam(energy, buffers_, seam, algorithm_);
+        auto search_done = std::chrono::steady_clock::now();
+        for (int y = 0; y < height_; y++) {
+            order_[static_cast<size_t>(y) * width_ + columns.row(y)[seam[y]]] = valid_seams_;
+        }
+
+        remove_seam(working, seam, {working.data, width - 1, height_, channels_, pixel_stride});
+        if (sigma_ > 0.0f) {
+            smoothed_.remove_seam(seam);
+        }
+        MutableImageView column_plane{reinterpret_cast<unsigned char*>(columns.data), width, height_,
+                                      static_cast<int>(sizeof(int)),
+                                      static_cast<std::ptrdiff_t>(width_) * static_cast<std::ptrdiff_t>(sizeof(int))};
+        remove_seam(column_plane, seam, {column_plane.data, width - 1, height_, column_plane.channels,
+                                         column_plane.stride});
+        valid_seams_++;
+        working_seam_ = valid_seams_;
+
+        auto seam_done = std::chrono::steady_clock::now();
+        Metrics::record(Metrics::Latency::ENERGY, energy_done - seam_start);
+        Metrics::record(Metrics::Latency::SEAM_SEARCH, search_done - energy_done);
+        Metrics::record(Metrics::Latency::SEAM_REMOVAL, seam_done - search_done);
+        Metrics::record(Metrics::Latency::SEAM, seam_done - seam_start);
+    }
+
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::high_resolution_clock::now() - start_time);
+    spdlog::info("Carving completed: {} new seams in {}ms", seams_to_remove - reused_seams_, elapsed.count());
+    finish_job();
+    checkpoint(true);
+    return valid_seams_;
+}
+
+} // namespace SeamCarving
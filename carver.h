@@ -0,0 +1,184 @@
+#pragma once
+
+#include "prefilter.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace SeamCarving {
+
+    class CheckpointWriter;
+
+    /**
+     * @brief Seam order of one image, kept up to date under local edits
+     *
+     * Owns a copy of the image, an optional protection map (added to the
+     * energy of each pixel) and every seam computed so far. An edit finds the
+     * first seam it can affect; the next carve() reuses all earlier seams and
+     * recomputes energy and seams only from there on.
+     *
+     * Seam i is provably unaffected when seams 0..i-1 are (its working image
+     * then differs from the old one only at the edited pixels) and either
+     * - none of the energies it read changed: for GREEDY the row 0 minimum
+     *   and the three candidates of every later row, for DYNAMIC all of them;
+     * - or the edit only raised energies (painting protection) and the seam
+     *   avoids every raised pixel: its cost is unchanged and no other path got
+     *   cheaper, so both algorithms pick it again, ties included. Not so
+     *   under DpMemory::QUANTIZED, whose quantization step follows the cost
+     *   of a cheap seam: there any edit restarts DYNAMIC from the first seam.
+     * Pixel edits move the Sobel energy around them in either direction, so
+     * under DYNAMIC they restart from the first seam: a lowered energy
+     * anywhere can make a new path optimal. With smoothing on, a pixel edit
+     * reaches SmoothedEnergy::radius() pixels further through the blur, and
+     * a resumed carve starts from a fresh blur instead of band updates, so
+     * its seams match a full recarve up to the blur's truncated tail.
+     *
+     * The state can be saved to and restored from a checkpoint file (see
+     * checkpoint.h), periodically during carve() with set_checkpoint().
+     *
+     * Not thread-safe; one job at a time may use a Carver.
+     */
+    class Carver {
+    public:
+        explicit Carver(Algorithm algorithm = Algorithm::GREEDY);
+        ~Carver();
+        Carver(Carver&&) noexcept;
+        Carver& operator=(Carver&&) noexcept;
+
+        /// Copy the image and drop all seams and protection
+        void set_image(const ImageView& image);
+        /// Switch the seam finding algorithm (drops all seams when it changes)
+        void set_algorithm(Algorithm algorithm);
+        /// Blur the luma by sigma pixels before the energy, 0 = off (drops all seams when it changes)
+        void set_smoothing(float sigma);
+        /**
+         * DP storage of the DYNAMIC search. Switching among the float modes
+         * keeps the seams and may happen during carve() (from its progress
+         * callback), as may degrading from QUANTIZED to a smaller one.
+         * Switching to QUANTIZED, or from it back to FULL, drops the seams.
+         */
+        void set_dp_memory(DpMemory mode);
+        /**
+         * Free the working buffers between carves: the working image, energy,
+         * DP storage and blur maps. Image, protection and seams stay, so the
+         * next carve() resumes where this one stopped after rebuilding the
+         * working image from the order map.
+         */
+        void release_scratch();
+        /// Threads of the full-image passes (the blur when smoothing is on); 1 = the caller's only
+        void set_threads(int threads) { buffers_.threads = std::max(1, threads); }
+
+        /**
+         * Bytes a Carver holds for an image carved by `seams` seams.
+         *
+         * @param width Image width
+         * @param height Image height
+         * @param channels Bytes per pixel
+         * @param seams Seams carve() will keep
+         * @param dp_memory DP storage mode
+         * @param smoothing True when the luma is blurred (set_smoothing() above 0)
+         */
+        static std::size_t footprint(int width, int height, int channels, int seams, DpMemory dp_memory,
+                                     bool smoothing);
+
+        /**
+         * Checkpoint the state every interval_seconds while carve() runs, and
+         * when it returns. Files are written on a background thread.
+         *
+         * @param path Checkpoint file path, empty to stop checkpointing
+         * @param interval_seconds Time between checkpoints
+         */
+        void set_checkpoint(const std::string& path, double interval_seconds = 60.0);
+
+        /**
+         * Replace a rectangle of the image.
+         *
+         * @param x Left edge of the patch in the image
+         * @param y Top edge of the patch in the image
+         * @param patch New pixels with the image's channel count; clipped to the image
+         */
+        void update_pixels(int x, int y, const ImageView& patch);
+
+        /**
+         * Replace a rectangle of the protection map.
+         *
+         * Protection is added to the energy of each pixel: large positive
+         * values keep pixels, negative values attract seams. The map is zero
+         * until first updated.
+         *
+         * @param x Left edge of the rectangle in the image
+         * @param y Top edge of the rectangle in the image
+         * @param weights New values; clipped to the image
+         */
+        void update_protection(int x, int y, const MatrixView<const float>& weights);
+
+        /**
+         * Compute the seam order down to min_width, or bring it up to date
+         * after edits.
+         *
+         * @param min_width Narrowest width the order map has to describe
+         * @param progress Optional callback; returning false aborts, and the
+         *                 next call resumes from the last completed seam
+         * @return Number of valid seams
+         */
+        int carve(int min_width, const ProgressCallback& progress = nullptr);
+
+        /**
+         * Seam order map as from compute_seam_order(), once carve() returned.
+         * Entries are valid for widths down to width() - seams().
+         */
+        MatrixView<const int> seam_order() const { return {order_.data(), width_, height_, width_}; }
+        /// Protection map, empty data pointer until first updated
+        MatrixView<const float> protection() const;
+        ImageView image() const { return ImageView::packed(image_.data(), width_, height_, channels_); }
+
+        int seams() const { return valid_seams_; }
+        /// Seams the last carve() kept from before the edits
+        int reused_seams() const { return reused_seams_; }
+        int width() const { return width_; }
+        int height() const { return height_; }
+        int channels() const { return channels_; }
+        Algorithm algorithm() const { return algorithm_; }
+        float smoothing() const { return sigma_; }
+        DpMemory dp_memory() const { return buffers_.dp_memory; }
+        int threads() const { return buffers_.threads; }
+
+    private:
+        friend class CheckpointWriter;
+        friend bool save_checkpoint(const Carver& carver, const std::string& path);
+        friend bool load_checkpoint(const std::string& path, Carver& carver);
+
+        /// Edited rectangle [x0, x1) x [y0, y1) in image coordinates
+        struct Edit {
+            int x0, y0, x1, y1;
+            bool pixels;       ///< Image pixels changed (otherwise protection)
+            bool raised_only;  ///< No energy went down
+        };
+
+        int first_affected_seam(const Edit& edit) const;
+        void invalidate(const Edit& edit);
+        /// Working image and columns after `seam` seams, from the order map
+        void rebuild_working(int seam);
+
+        Algorithm algorithm_;
+        float sigma_ = 0.0f;
+        int width_ = 0;
+        int height_ = 0;
+        int channels_ = 0;
+        Memory::LargeBuffer<unsigned char> image_;
+        Memory::LargeBuffer<float> protection_;  ///< Empty until first updated
+        Memory::LargeBuffer<int> order_;
+        Memory::LargeBuffer<int> seams_;         ///< Working column of seam i in row y at [i * height + y]
+        int valid_seams_ = 0;
+        int working_seam_ = -1;                  ///< Seams applied to the working buffers, -1 = stale
+        int reused_seams_ = 0;
+        std::uint64_t revision_ = 0;             ///< Bumped by every change other than new seams
+        CarveBuffers buffers_;                   ///< pixels/source_x hold the working image between calls
+        SmoothedEnergy smoothed_;                ///< Blurred energy of the working image (smoothing on)
+        std::unique_ptr<CheckpointWriter> checkpoint_;
+        double checkpoint_interval_ = 0.0;       ///< Seconds between checkpoints during carve()
+    };
+
+} // namespace SeamCarving
@@ -0,0 +1,419 @@
+#include "checkpoint.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <spdlog/spdlog.h>
+
+#if defined(__linux__)
+#include <unistd.h>
+#endif
+
+namespace SeamCarving {
+
+namespace {
+
+    constexpr char kMagic[8] = {'F', 'L', 'I', 'N', 'K', 'C', 'K', 'P'};
+    constexpr std::uint32_t kVersion = 1;
+    constexpr std::uint32_t kByteOrderMark = 0x01020304;
+
+    struct FileHeader {
+        char magic[8];
+        std::uint32_t version;
+        std::uint32_t byte_order;
+        std::int32_t width;
+        std::int32_t height;
+        std::int32_t channels;
+        std::int32_t algorithm;
+        float sigma;
+        std::int32_t dp_memory;
+        std::int32_t seams;
+        std::int32_t reserved;
+        std::uint64_t image_offset;
+        std::uint64_t protection_offset;  ///< 0 = no protection map
+        std::uint64_t order_offset;
+        std::uint64_t seams_offset;
+        std::uint64_t file_bytes;
+    };
+    static_assert(sizeof(FileHeader) <= kCheckpointHeaderBytes, "checkpoint header must fit its page");
+
+    /// Views of the state being written; the image and maps are packed
+    struct State {
+        int width;
+        int height;
+        int channels;
+        Algorithm algorithm;
+        float sigma;
+        DpMemory dp_memory;
+        int seams;
+        const unsigned char* image;
+        const float* protection;  ///< nullptr = none
+        const int* order;         ///< Entries of seams >= `seams` must already be kNeverRemoved
+        const int* seam_columns;
+    };
+
+    std::uint64_t align(std::uint64_t offset) {
+        return (offset + kCheckpointAlignment - 1) / kCheckpointAlignment * kCheckpointAlignment;
+    }
+
+    // Header with the section offsets of an image; settings are left zero
+    FileHeader layout(int width, int height, int channels, int seams, bool protection) {
+        std::uint64_t pixels = static_cast<std::uint64_t>(width) * height;
+        FileHeader header{};
+        std::memcpy(header.magic, kMagic, sizeof(kMagic));
+        header.version = kVersion;
+        header.byte_order = kByteOrderMark;
+        header.width = width;
+        header.height = height;
+        header.channels = channels;
+        header.seams = seams;
+        header.image_offset = kCheckpointHeaderBytes;
+        std::uint64_t end = header.image_offset + pixels * channels;
+        if (protection) {
+            header.protection_offset = align(end);
+            end = header.protection_offset + pixels * sizeof(float);
+        }
+        header.order_offset = align(end);
+        header.seams_offset = align(header.order_offset + pixels * sizeof(int));
+        header.file_bytes = header.seams_offset + static_cast<std::uint64_t>(seams) * height * sizeof(int);
+        return header;
+    }
+
+    // Gigapixel checkpoints pass 2 GB, beyond a 32-bit long
+    bool seek(std::FILE* file, std::uint64_t offset) {
+#if defined(_WIN32)
+        return _fseeki64(file, static_cast<long long>(offset), SEEK_SET) == 0;
+#else
+        return fseeko(file, static_cast<off_t>(offset), SEEK_SET) == 0;
+#endif
+    }
+
+    std::uint64_t file_size(std::FILE* file) {
+#if defined(_WIN32)
+        _fseeki64(file, 0, SEEK_END);
+        return static_cast<std::uint64_t>(_ftelli64(file));
+#else
+        fseeko(file, 0, SEEK_END);
+        return static_cast<std::uint64_t>(ftello(file));
+#endif
+    }
+
+    bool write_at(std::FILE* file, std::uint64_t offset, const void* data, std::uint64_t bytes) {
+        // Gaps between sections are zero-filled by seeking past the end
+        return seek(file, offset) && (bytes == 0 || std::fwrite(data, 1, bytes, file) == bytes);
+    }
+
+    bool write_file(const State& state, const std::string& path) {
+        auto start_time = std::chrono::high_resolution_clock::now();
+        FileHeader header = layout(state.width, state.height, state.channels, state.seams, state.protection != nullptr);
+        header.algorithm = static_cast<std::int32_t>(state.algorithm);
+        header.sigma = state.sigma;
+        header.dp_memory = static_cast<std::int32_t>(state.dp_memory);
+        std::uint64_t pixels = static_cast<std::uint64_t>(state.width) * state.height;
+
+        std::string temporary = path + ".tmp";
+        std::FILE* file = std::fopen(temporary.c_str(), "wb");
+        if (!file) {
+            spdlog::error("Failed to create checkpoint: {}", temporary);
+            return false;
+        }
+        bool ok = write_at(file, 0, &header, sizeof(header)) &&
+                  write_at(file, header.image_offset, state.image, pixels * state.channels) &&
+                  (!state.protection ||
+                   write_at(file, header.protection_offset, state.protection, pixels * sizeof(float))) &&
+                  write_at(file, header.order_offset, state.order, pixels * sizeof(int)) &&
+                  write_at(file, header.seams_offset, state.seam_columns,
+                           static_cast<std::uint64_t>(state.seams) * state.height * sizeof(int));
+        ok = std::fflush(file) == 0 && ok;
+#if defined(__linux__)
+        // The rename must not become visible before the data
+        ok = fsync(fileno(file)) == 0 && ok;
+#endif
+        ok = std::fclose(file) == 0 && ok;
+        if (!ok) {
+            spdlog::error("Failed to write checkpoint: {}", temporary);
+            std::remove(temporary.c_str());
+            return false;
+        }
+#if defined(_WIN32)
+        std::remove(path.c_str());
+#endif
+        if (std::rename(temporary.c_str(), path.c_str()) != 0) {
+            spdlog::error("Failed to replace checkpoint: {}", path);
+            std::remove(temporary.c_str());
+            return false;
+        }
+
+        auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::high_resolution_clock::now() - start_time);
+        spdlog::info("Checkpoint of {} seams written to {} ({:.1f} MB, {}ms)", state.seams, path,
+                     header.file_bytes / (1024.0 * 1024.0), elapsed.count());
+        return true;
+    }
+
+    bool read_at(std::FILE* file, std::uint64_t offset, void* data, std::uint64_t bytes) {
+        return seek(file, offset) && (bytes == 0 || std::fread(data, 1, bytes, file) == bytes);
+    }
+
+    // Settings the reader casts to enums must name one
+    bool valid_settings(const FileHeader& header) {
+        return (header.algorithm == static_cast<std::int32_t>(Algorithm::GREEDY) ||
+                header.algorithm == static_cast<std::int32_t>(Algorithm::DYNAMIC)) &&
+               header.dp_memory >= static_cast<std::int32_t>(DpMemory::FULL) &&
+               header.dp_memory <= static_cast<std::int32_t>(DpMemory::QUANTIZED) &&
+               std::isfinite(header.sigma) && header.sigma >= 0.0f;
+    }
+
+    /**
+     * Check the sections a resumed carve indexes with: seam i holds working
+     * columns in [0, width - i), and every row of the order map names each
+     * of the seams exactly once, all other entries kNeverRemoved.
+     */
+    bool valid_sections(const FileHeader& header, const int* order, const int* seam_columns,
+                        const float* protection) {
+        int width = header.width;
+        int height = header.height;
+        int seams = header.seams;
+        for (int i = 0; i < seams; i++) {
+            const int* seam = seam_columns + static_cast<size_t>(i) * height;
+            for (int y = 0; y < height; y++) {
+                if (seam[y] < 0 || seam[y] >= width - i) {
+                    return false;
+                }
+            }
+        }
+
+        std::vector<int> seen_in_row(seams, -1);
+        for (int y = 0; y < height; y++) {
+            const int* row = order + static_cast<size_t>(y) * width;
+            int removed = 0;
+            for (int x = 0; x < width; x++) {
+                int seam = row[x];
+                if (seam == kNeverRemoved) {
+                    continue;
+                }
+                if (seam < 0 || seam >= seams || seen_in_row[seam] == y) {
+                    return false;
+                }
+                seen_in_row[seam] = y;
+                removed++;
+            }
+            if (removed != seams) {
+                return false;
+            }
+        }
+
+        // A NaN or infinite weight would poison every DP sum it reaches
+        size_t pixels = static_cast<size_t>(width) * height;
+        return !protection || std::all_of(protection, protection + pixels, [](float w) { return std::isfinite(w); });
+    }
+
+    // Copy the order map, dropping entries of seams past `seams` (left by edits)
+    void copy_order(const int* order, size_t count, int seams, int* out) {
+        for (size_t i = 0; i < count; i++) {
+            out[i] = order[i] < seams ? order[i] : kNeverRemoved;
+        }
+    }
+
+} // namespace
+
+bool save_checkpoint(const Carver& carver, const std::string& path) {
+    size_t pixels = static_cast<size_t>(carver.width_) * carver.height_;
+    Memory::LargeBuffer<int> order(pixels);
+    copy_order(carver.order_.data(), pixels, carver.valid_seams_, order.data());
+    State state{carver.width_, carver.height_, carver.channels_, carver.algorithm_, carver.sigma_,
+                carver.dp_memory(), carver.valid_seams_, carver.image_.data(),
+                carver.protection_.empty() ? nullptr : carver.protection_.data(), order.data(), carver.seams_.data()};
+    return write_file(state, path);
+}
+
+bool load_checkpoint(const std::string& path, Carver& carver) {
+    std::FILE* file = std::fopen(path.c_str(), "rb");
+    if (!file) {
+        return false;
+    }
+    FileHeader header{};
+    std::uint64_t file_bytes = file_size(file);
+    bool valid = read_at(file, 0, &header, sizeof(header)) &&
+                 std::memcmp(header.magic, kMagic, sizeof(kMagic)) == 0 && header.version == kVersion &&
+                 header.byte_order == kByteOrderMark && header.width > 0 && header.height > 0 &&
+                 header.channels > 0 && header.seams >= 0 && header.seams < header.width && valid_settings(header);
+    if (valid) {
+        // The offsets must be the ones this version writes for these sizes
+        FileHeader layout_header = layout(header.width, header.height, header.channels, header.seams,
+                                          header.protection_offset != 0);
+        valid = layout_header.image_offset == header.image_offset &&
+                layout_header.protection_offset == header.protection_offset &&
+                layout_header.order_offset == header.order_offset &&
+                layout_header.seams_offset == header.seams_offset && header.file_bytes == file_bytes;
+    }
+    if (!valid) {
+        spdlog::error("Not a valid checkpoint: {}", path);
+        std::fclose(file);
+        return false;
+    }
+
+    size_t pixels = static_cast<size_t>(header.width) * header.height;
+    Memory::LargeBuffer<unsigned char> image(pixels * header.channels);
+    Memory::LargeBuffer<float> protection(header.protection_offset ? pixels : 0);
+    Memory::LargeBuffer<int> order(pixels);
+    Memory::LargeBuffer<int> seams(static_cast<size_t>(header.seams) * header.height);
+    bool ok = read_at(file, header.image_offset, image.data(), image.size()) &&
+              (!header.protection_offset ||
+               read_at(file, header.protection_offset, protection.data(), protection.size() * sizeof(float))) &&
+              read_at(file, header.order_offset, order.data(), order.size() * sizeof(int)) &&
+              read_at(file, header.seams_offset, seams.data(), seams.size() * sizeof(int));
+    std::fclose(file);
+    if (!ok) {
+        spdlog::error("Failed to read checkpoint: {}", path);
+        return false;
+    }
+    if (!valid_sections(header, order.data(), seams.data(), header.protection_offset ? protection.data() : nullptr)) {
+        spdlog::error("Corrupt checkpoint: {}", path);
+        return false;
+    }
+
+    carver.width_ = header.width;
+    carver.height_ = header.height;
+    carver.channels_ = header.channels;
+    carver.algorithm_ = static_cast<Algorithm>(header.algorithm);
+    carver.sigma_ = header.sigma;
+    carver.set_dp_memory(static_cast<DpMemory>(header.dp_memory));
+    carver.image_ = std::move(image);
+    carver.protection_ = std::move(protection);
+    carver.order_ = std::move(order);
+    carver.seams_ = std::move(seams);
+    carver.valid_seams_ = header.seams;
+    carver.working_seam_ = -1;
+    carver.reused_seams_ = 0;
+    carver.revision_++;
+    spdlog::info("Resumed {}x{} carve from {} after {} seams", header.width, header.height, path, header.seams);
+    return true;
+}
+
+CheckpointWriter::CheckpointWriter(std::string path) : path_(std::move(path)) {
+    thread_ = std::thread(&CheckpointWriter::run, this);
+}
+
+CheckpointWriter::~CheckpointWriter() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+        cv_.notify_all();
+    }
+    thread_.join();
+}
+
+bool CheckpointWriter::submit(const Carver& carver) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (pending_) {
+        return false;
+    }
+
+    size_t pixels = static_cast<size_t>(carver.width_) * carver.height_;
+    Snapshot& snapshot = snapshot_;
+    bool resized = snapshot.width != carver.width_ || snapshot.height != carver.height_ ||
+                   snapshot.channels != carver.channels_;
+    if (!has_snapshot_ || resized || snapshot.revision != carver.revision_) {
+        snapshot.image.assign(carver.image_.begin(), carver.image_.end());
+        snapshot.protection.assign(carver.protection_.begin(), carver.protection_.end());
+        snapshot.revision = carver.revision_;
+    }
+    snapshot.width = carver.width_;
+    snapshot.height = carver.height_;
+    snapshot.channels = carver.channels_;
+    snapshot.algorithm = carver.algorithm_;
+    snapshot.sigma = carver.sigma_;
+    snapshot.dp_memory = carver.dp_memory();
+    snapshot.order.resize(pixels);
+    copy_order(carver.order_.data(), pixels, carver.valid_seams_, snapshot.order.data());
+
+    // Seams only grow between edits: copy the new ones
+    size_t seam_values = static_cast<size_t>(carver.valid_seams_) * carver.height_;
+    size_t kept = has_snapshot_ && !resized && snapshot.revision == carver.revision_
+                      ? std::min(snapshot.seam_columns.size(), seam_values)
+                      : 0;
+    snapshot.seam_columns.resize(seam_values);
+    std::copy(carver.seams_.begin() + kept, carver.seams_.begin() + seam_values, snapshot.seam_columns.begin() + kept);
+    snapshot.seams = carver.valid_seams_;
+
+    has_snapshot_ = true;
+    pending_ = true;
+    cv_.notify_all();
+    return true;
+}
+
+void CheckpointWriter::wait() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    cv_.wait(lock, [this] { return !pending_; });
+}
+
+bool CheckpointWriter::ok() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return ok_;
+}
+
+void CheckpointWriter::run() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        cv_.wait(lock, [this] { return pending_ || stopping_; });
+        if (!pending_) {
+            return;
+        }
+        // submit() does not touch the snapshot while pending_ is set
+        lock.unlock();
+        const Snapshot& snapshot = snapshot_;
+        State state{snapshot.width, snapshot.height, snapshot.channels, snapshot.algorithm, snapshot.sigma,
+                    snapshot.dp_memory, snapshot.seams, snapshot.image.data(),
+                    snapshot.protection.empty() ? nullptr : snapshot.protection.data(), snapshot.order.data(),
+                    snapshot.seam_columns.data()};
+        bool ok = write_file(state, path_);
+        lock.lock();
+        ok_ = ok;
+        pending_ = false;
+        cv_.notify_all();
+    }
+}
+
+int reduce_width_resumable(
+    const ImageView& src,
+    const MutableImageView& dst,
+    const std::string& checkpoint_path,
+    double interval_seconds,
+    Algorithm algorithm,
+    const ProgressCallback& progress
+) {
+    if (dst.width >= src.width) {
+        CarveBuffers buffers;
+        return reduce_width_iteratively(src, dst, buffers, algorithm, progress);
+    }
+
+    // A checkpoint of another image (or another channel layout) is ignored
+    Carver carver(algorithm);
+    bool resumed = load_checkpoint(checkpoint_path, carver) && carver.width() == src.width &&
+                   carver.height() == src.height && carver.channels() == src.channels;
+    size_t row_bytes = static_cast<size_t>(src.width) * src.channels;
+    for (int y = 0; resumed && y < src.height; y++) {
+        resumed = std::memcmp(carver.image().row(y), src.row(y), row_bytes) == 0;
+    }
+    if (!resumed) {
+        carver.set_image(src);
+    }
+    // Different settings drop the resumed seams
+    carver.set_algorithm(algorithm);
+    carver.set_smoothing(0.0f);
+    carver.set_checkpoint(checkpoint_path, interval_seconds);
+
+    int seams = carver.carve(dst.width, progress);
+    // Joins the writer, so the final checkpoint is on disk
+    carver.set_checkpoint("");
+    if (seams < src.width - dst.width) {
+        return src.width - seams;
+    }
+    carve_from_order(src, carver.seam_order(), dst);
+    std::remove(checkpoint_path.c_str());
+    return dst.width;
+}
+
+} // namespace SeamCarving
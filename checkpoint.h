@@ -0,0 +1,140 @@
+#pragma once
+
+#include "carver.h"
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace SeamCarving {
+
+    /**
+     * Checkpoint file layout (version 1, host byte order):
+     *
+     *     offset 0      header (kCheckpointHeaderBytes): magic "FLINKCKP",
+     *                   version, byte order mark, image size and channels,
+     *                   algorithm, sigma, DP storage, seam count and the
+     *                   offset of every section
+     *     image         height x width x channels bytes, packed rows
+     *     protection    height x width float32 (absent until first painted)
+     *     order         height x width int32 seam order map
+     *     seams         seams x height int32 working columns, seam-major
+     *
+     * Every section starts on a kCheckpointAlignment boundary, so each one
+     * can be memory-mapped straight into an array (e.g. numpy.memmap).
+     */
+    constexpr std::size_t kCheckpointHeaderBytes = 4096;
+    constexpr std::size_t kCheckpointAlignment = 4096;
+
+    /**
+     * Write the state of a Carver (image, protection, seams, settings) synchronously.
+     *
+     * The file is written next to path and renamed over it once complete,
+     * so an interrupted write keeps the previous checkpoint.
+     *
+     * @param carver Carver to save
+     * @param path Checkpoint file path
+     * @return True on success
+     */
+    bool save_checkpoint(const Carver& carver, const std::string& path);
+
+    /**
+     * Restore a Carver from a checkpoint; the next carve() continues after its last seam.
+     *
+     * The settings, seam columns, order map and protection weights are
+     * checked before use, so a corrupt file is rejected rather than resumed.
+     *
+     * @param path Checkpoint file path
+     * @param carver Carver to overwrite; untouched when the file is missing or invalid
+     * @return True on success
+     */
+    bool load_checkpoint(const std::string& path, Carver& carver);
+
+    /**
+     * @brief Writes Carver checkpoints on a background thread
+     *
+     * submit() copies the state into a snapshot and returns; the image and
+     * protection are only copied again after an edit, the order map and the
+     * new seams every time. A submit() while the previous write still runs
+     * is skipped, so carving never waits for the disk.
+     */
+    class CheckpointWriter {
+    public:
+        /// @param path Checkpoint file path
+        explicit CheckpointWriter(std::string path);
+        /// Finishes the pending write
+        ~CheckpointWriter();
+        CheckpointWriter(const CheckpointWriter&) = delete;
+        CheckpointWriter& operator=(const CheckpointWriter&) = delete;
+
+        /**
+         * Snapshot a Carver and write it in the background.
+         *
+         * @return False when the previous write is still running (nothing is written)
+         */
+        bool submit(const Carver& carver);
+
+        /// Block until the pending write finished
+        void wait();
+
+        const std::string& path() const { return path_; }
+        /// False when the last finished write failed
+        bool ok() const;
+
+    private:
+        /// Copy of the Carver fields a checkpoint holds
+        struct Snapshot {
+            int width = 0;
+            int height = 0;
+            int channels = 0;
+            Algorithm algorithm = Algorithm::GREEDY;
+            float sigma = 0.0f;
+            DpMemory dp_memory = DpMemory::FULL;
+            int seams = 0;
+            std::uint64_t revision = 0;  ///< Carver::revision_ the image and protection were copied at
+            Memory::LargeBuffer<unsigned char> image;
+            Memory::LargeBuffer<float> protection;
+            Memory::LargeBuffer<int> order;
+            Memory::LargeBuffer<int> seam_columns;
+        };
+
+        void run();
+
+        std::string path_;
+        mutable std::mutex mutex_;
+        std::condition_variable cv_;
+        Snapshot snapshot_;
+        bool has_snapshot_ = false;
+        bool pending_ = false;  ///< Snapshot taken and not written yet
+        bool stopping_ = false;
+        bool ok_ = true;
+        std::thread thread_;
+    };
+
+    /**
+     * Carve to dst.width through a Carver that checkpoints periodically.
+     *
+     * When `checkpoint_path` holds a checkpoint of the same image, carving
+     * continues after its last seam instead of starting over. The file is
+     * removed once dst is written.
+     *
+     * @param src Input image view
+     * @param dst Output view with the target width
+     * @param checkpoint_path Checkpoint file path
+     * @param interval_seconds Time between checkpoints
+     * @param algorithm Algorithm to use for seam finding
+     * @param progress Optional callback; returning false aborts after writing a checkpoint
+     * @return Width reached: dst.width on success, larger when aborted (dst untouched)
+     */
+    int reduce_width_resumable(
+        const ImageView& src,
+        const MutableImageView& dst,
+        const std::string& checkpoint_path,
+        double interval_seconds = 60.0,
+        Algorithm algorithm = Algorithm::GREEDY,
+        const ProgressCallback& progress = nullptr
+    );
+
+} // namespace SeamCarving
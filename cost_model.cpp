@@ -0,0 +1,407 @@
+#include "cost_model.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <random>
+#include <thread>
+#include <spdlog/spdlog.h>
+
+namespace SeamCarving {
+
+namespace {
+
+    /// Predictions are fit on a small image; leave headroom for cache effects and noise
+    constexpr double kSafetyFactor = 1.25;
+
+    /// Set by CostModel::host() once the model is calibrated
+    std::atomic<const CostModel*> g_host_model{nullptr};
+
+    /// Sum of the widths a seam loop works on: width, width - 1, ..., width - seams + 1
+    double summed_widths(int width, int seams) {
+        return static_cast<double>(seams) * width - static_cast<double>(seams) * (seams - 1) / 2.0;
+    }
+
+    /// Nanoseconds per element of the fastest of a few runs of pass
+    template <typename Pass>
+    double ns_per_element(double elements, Pass pass) {
+        double best = 0.0;
+        for (int i = 0; i < 2; i++) {
+            auto start = std::chrono::steady_clock::now();
+            pass();
+            double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+            best = (i == 0) ? ns : std::min(best, ns);
+        }
+        return best / elements;
+    }
+
+    // Average factor x factor blocks; the last block row also takes the rows
+    // left over when the height is not a multiple of the factor
+    void downscale_box(const ImageView& src, int factor, const MutableImageView& dst) {
+        int channels = src.channels;
+        for (int ly = 0; ly < dst.height; ly++) {
+            int y0 = ly * factor;
+            int y1 = (ly == dst.height - 1) ? src.height : y0 + factor;
+            unsigned char* out = dst.row(ly);
+            for (int lx = 0; lx < dst.width; lx++) {
+                for (int c = 0; c < channels; c++) {
+                    int sum = 0;
+                    for (int y = y0; y < y1; y++) {
+                        const unsigned char* in = src.row(y) + static_cast<size_t>(lx) * factor * channels + c;
+                        for (int x = 0; x < factor; x++) {
+                            sum += in[x * channels];
+                        }
+                    }
+                    int count = (y1 - y0) * factor;
+                    out[lx * channels + c] = static_cast<unsigned char>((sum + count / 2) / count);
+                }
+            }
+        }
+    }
+
+} // namespace
+
+const char* quality_mode_name(QualityMode mode) {
+    switch (mode) {
+        case QualityMode::EXACT: return "exact";
+        case QualityMode::APPROX_ENERGY: return "approximate energy";
+        case QualityMode::PYRAMID: return "pyramid";
+        case QualityMode::HYBRID: return "hybrid";
+    }
+    return "unknown";
+}
+
+CostModel CostModel::calibrate() {
+    // Large enough that the passes stream from memory, as they do on real images
+    const int width = 1024;
+    const int height = 512;
+    const int channels = 3;
+    const double pixels = static_cast<double>(width) * height;
+
+    std::vector<unsigned char> image(static_cast<size_t>(width) * height * channels);
+    std::mt19937 rng(1);
+    for (auto& value : image) {
+        value = static_cast<unsigned char>(rng() & 0xff);
+    }
+    ImageView src = ImageView::packed(image.data(), width, height, channels);
+    std::vector<float> energy(static_cast<size_t>(width) * height);
+    std::vector<float> dp(energy.size());
+    std::vector<int> seam(height);
+    std::vector<unsigned char> out(image.size());
+    // Every row removes a scattered quarter of its pixels
+    std::vector<int> order(energy.size());
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            order[static_cast<size_t>(y) * width + x] = (x * 37 + y) % width;  // a permutation, 37 is odd
+        }
+    }
+    MatrixView<float> energy_view{energy.data(), width, height, width};
+    MatrixView<float> dp_view{dp.data(), width, height, width};
+
+    CostModel model;
+    model.energy_ns = ns_per_element(pixels, [&] { calculate_energy(src, energy_view); });
+    model.dp_ns = ns_per_element(pixels, [&] { find_low_energy_seam_dyn(energy_view, dp_view, seam.data()); });
+    model.greedy_ns = ns_per_element(width + height, [&] { find_low_energy_seam_greedy(energy_view, seam.data()); });
+    model.remove_ns = ns_per_element(pixels, [&] {
+        remove_seam(src, seam.data(), MutableImageView::packed(out.data(), width - 1, height, channels));
+    });
+    model.compact_ns = ns_per_element(pixels, [&] {
+        MutableImageView plane = mutable_plane_view(energy.data(), width, height);
+        remove_seam(plane, seam.data(), {plane.data, width - 1, height, plane.channels, plane.stride});
+    });
+    model.gather_ns = ns_per_element(pixels, [&] {
+        carve_from_order(src, {order.data(), width, height, width},
+                         MutableImageView::packed(out.data(), width - width / 4, height, channels));
+    });
+    model.resample_ns = ns_per_element(pixels * 3 / 4, [&] {
+        scale_width(src, MutableImageView::packed(out.data(), width * 3 / 4, height, channels));
+    });
+    model.cores = std::max(1u, std::thread::hardware_concurrency());
+
+    spdlog::info("Cost model (ns/pixel): energy {:.2f}, dp {:.2f}, greedy {:.2f}, remove {:.2f}, "
+                 "compact {:.2f}, gather {:.2f}, resample {:.2f}; {} cores",
+                 model.energy_ns, model.dp_ns, model.greedy_ns, model.remove_ns,
+                 model.compact_ns, model.gather_ns, model.resample_ns, model.cores);
+    return model;
+}
+
+const CostModel& CostModel::host() {
+    static const CostModel model = calibrate();
+    g_host_model.store(&model, std::memory_order_release);
+    return model;
+}
+
+const CostModel* CostModel::host_if_calibrated() {
+    return g_host_model.load(std::memory_order_acquire);
+}
+
+double CostModel::seam_loop_ms(int width, int height, int seams, Algorithm algorithm, bool recompute_energy) const {
+    if (seams <= 0) {
+        return 0.0;
+    }
+    double columns = summed_widths(width, seams);
+    double pixels = columns * height;
+    double ns = pixels * (remove_ns + (recompute_energy ? energy_ns : compact_ns));
+    if (!recompute_energy) {
+        ns += static_cast<double>(width) * height * energy_ns;
+    }
+    if (algorithm == Algorithm::DYNAMIC) {
+        ns += pixels * dp_ns;
+    } else {
+        ns += (columns + static_cast<double>(seams) * height) * greedy_ns;
+    }
+    return ns / 1e6;
+}
+
+double CostModel::predict_ms(QualityMode mode, int width, int height, int seams, Algorithm algorithm,
+                             int threads, int exact_seams, int pyramid_factor) const {
+    double source_pixels = static_cast<double>(width) * height;
+    double target_pixels = static_cast<double>(width - seams) * height;
+    double ms = 0.0;
+
+    switch (mode) {
+        case QualityMode::EXACT:
+            ms = seam_loop_ms(width, height, seams, algorithm);
+            break;
+        case QualityMode::APPROX_ENERGY:
+            ms = seam_loop_ms(width, height, seams, algorithm, false);
+            break;
+        case QualityMode::PYRAMID: {
+            int factor = std::max(2, pyramid_factor);
+            int low_width = width / factor;
+            int low_height = std::max(1, height / factor);
+            int low_seams = std::min((seams + factor - 1) / factor, low_width - 1);
+            ms = (source_pixels * resample_ns + source_pixels * gather_ns) / 1e6 +
+                 seam_loop_ms(low_width, low_height, low_seams, algorithm);
+            if (low_seams * factor < seams) {
+                ms += target_pixels * resample_ns / 1e6;
+            }
+            break;
+        }
+        case QualityMode::HYBRID:
+            exact_seams = std::max(0, std::min(exact_seams, seams));
+            ms = seam_loop_ms(width, height, exact_seams, algorithm);
+            if (exact_seams < seams) {
+                ms += target_pixels * resample_ns / 1e6;
+            }
+            break;
+    }
+    // Jobs beyond the core count share the CPU
+    return ms * std::max(1.0, static_cast<double>(threads) / cores);
+}
+
+CarvePlan plan_carve(const CostModel& model, int width, int height, int target_width, Algorithm algorithm,
+                     double deadline_ms, int threads) {
+    CarvePlan plan;
+    int seams = width - target_width;
+    if (seams <= 0) {
+        return plan;
+    }
+    double budget = deadline_ms / kSafetyFactor;
+
+    for (QualityMode mode : {QualityMode::EXACT, QualityMode::APPROX_ENERGY}) {
+        plan.mode = mode;
+        plan.predicted_ms = model.predict_ms(mode, width, height, seams, algorithm, threads);
+        if (plan.predicted_ms <= budget) {
+            return plan;
+        }
+    }
+
+    plan.mode = QualityMode::PYRAMID;
+    for (int factor : {2, 4}) {
+        if (width / factor < 2) {
+            break;
+        }
+        plan.pyramid_factor = factor;
+        plan.predicted_ms = model.predict_ms(plan.mode, width, height, seams, algorithm, threads, 0, factor);
+        if (plan.predicted_ms <= budget) {
+            return plan;
+        }
+    }
+
+    // As many exact seams as fit; with none, plain scaling
+    plan.mode = QualityMode::HYBRID;
+    int low = 0;
+    int high = seams;
+    while (low < high) {
+        int middle = (low + high + 1) / 2;
+        if (model.predict_ms(plan.mode, width, height, seams, algorithm, threads, middle) <= budget) {
+            low = middle;
+        } else {
+            high = middle - 1;
+        }
+    }
+    plan.exact_seams = low;
+    plan.predicted_ms = model.predict_ms(plan.mode, width, height, seams, algorithm, threads, low);
+    return plan;
+}
+
+DeadlineReport reduce_width_with_deadline(
+    const ImageView& src,
+    const MutableImageView& dst,
+    CarveBuffers& buffers,
+    Algorithm algorithm,
+    double deadline_ms,
+    int threads
+) {
+    // Calibration (first call only) is not part of the carve's time
+    const CostModel& model = CostModel::host();
+    auto start_time = std::chrono::steady_clock::now();
+    auto elapsed_ms = [&] {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start_time).count();
+    };
+
+    DeadlineReport report;
+    int target_width = std::min(dst.width, src.width);
+    int seams = src.width - target_width;
+    report.plan = plan_carve(model, src.width, src.height, target_width, algorithm, deadline_ms, threads);
+    if (seams <= 0) {
+        reduce_width_iteratively(src, dst, buffers, algorithm);
+        report.elapsed_ms = elapsed_ms();
+        return report;
+    }
+
+    // Carve the next seam only if it and the scaling of what is left still
+    // fit. Seams get cheaper as the width shrinks, so the last seam's time
+    // bounds the next one; the first is predicted by the model.
+    double scale_ms = model.predict_ms(QualityMode::HYBRID, src.width, src.height, seams, algorithm, threads, 0);
+    // Whatever the pyramid seams reach, the full-size source is still gathered
+    // through the coarse order after the guard stopped them
+    double reserve_ms = scale_ms;
+    if (report.plan.mode == QualityMode::PYRAMID) {
+        reserve_ms += static_cast<double>(src.width) * src.height * model.gather_ns / 1e6 *
+                      std::max(1.0, static_cast<double>(threads) / model.cores);
+    }
+    double step_ms = kSafetyFactor * model.seam_loop_ms(src.width, src.height, 1, algorithm);
+    if (report.plan.mode == QualityMode::APPROX_ENERGY) {
+        step_ms = kSafetyFactor * model.seam_loop_ms(src.width, src.height, 1, algorithm, false);
+    } else if (report.plan.mode == QualityMode::PYRAMID) {
+        int factor = report.plan.pyramid_factor;
+        step_ms = kSafetyFactor * (model.seam_loop_ms(src.width / factor, std::max(1, src.height / factor), 1, algorithm) +
+                                   static_cast<double>(src.width) * src.height * model.resample_ns / 1e6);
+    }
+    double last_call_ms = -1.0;
+    ProgressCallback guard = [&](int, int) {
+        double now_ms = elapsed_ms();
+        if (last_call_ms >= 0.0) {
+            step_ms = now_ms - last_call_ms;
+        }
+        last_call_ms = now_ms;
+        if (now_ms + step_ms + kSafetyFactor * reserve_ms < deadline_ms) {
+            return true;
+        }
+        report.degraded = true;
+        return false;
+    };
+
+    int channels = src.channels;
+    std::ptrdiff_t work_stride = static_cast<std::ptrdiff_t>(src.width) * channels;
+    size_t image_bytes = static_cast<size_t>(src.width) * src.height * channels;
+    // Result of the carving part when it stops short of the target
+    auto partial = [&](int reached) {
+        return reached == src.width ? src : ImageView{buffers.pixels.data(), reached, src.height, channels, work_stride};
+    };
+    ImageView remainder = src;
+
+    switch (report.plan.mode) {
+        case QualityMode::EXACT:
+        case QualityMode::APPROX_ENERGY: {
+            int reached = report.plan.mode == QualityMode::EXACT
+                              ? reduce_width_iteratively(src, dst, buffers, algorithm, guard)
+                              : reduce_width_approximate(src, dst, buffers, algorithm, guard);
+            report.seams_carved = src.width - reached;
+            remainder = partial(reached);
+            break;
+        }
+        case QualityMode::PYRAMID: {
+            int factor = report.plan.pyramid_factor;
+            int low_width = src.width / factor;
+            int low_height = std::max(1, src.height / factor);
+            size_t low_pixels = static_cast<size_t>(low_width) * low_height;
+            if (buffers.staging.size() < low_pixels * channels) {
+                buffers.staging.resize(low_pixels * channels);
+            }
+            if (buffers.order.size() < low_pixels) {
+                buffers.order.resize(low_pixels);
+            }
+            MutableImageView small = MutableImageView::packed(buffers.staging.data(), low_width, low_height, channels);
+            MatrixView<int> low_order{buffers.order.data(), low_width, low_height, low_width};
+            downscale_box(src, factor, small);
+
+            int low_seams = std::min((seams + factor - 1) / factor, low_width - 1);
+            int recorded = compute_seam_order(small, low_width - low_seams, low_order, buffers, algorithm, guard);
+            report.seams_carved = std::min(seams, recorded * factor);
+            if (report.seams_carved == seams) {
+                carve_from_coarse_order(src, low_order, factor, factor, dst);
+            } else if (report.seams_carved > 0) {
+                if (buffers.pixels.size() < image_bytes) {
+                    buffers.pixels.resize(image_bytes);
+                }
+                int reached = src.width - report.seams_carved;
+                carve_from_coarse_order(src, low_order, factor, factor,
+                                        {buffers.pixels.data(), reached, src.height, channels, work_stride});
+                remainder = partial(reached);
+            }
+            break;
+        }
+        case QualityMode::HYBRID: {
+            if (report.plan.exact_seams == 0) {
+                break;
+            }
+            int carve_width = src.width - report.plan.exact_seams;
+            size_t carved_bytes = static_cast<size_t>(carve_width) * src.height * channels;
+            if (buffers.staging.size() < carved_bytes) {
+                buffers.staging.resize(carved_bytes);
+            }
+            MutableImageView carved = MutableImageView::packed(buffers.staging.data(), carve_width, src.height, channels);
+            int reached = reduce_width_iteratively(src, carved, buffers, algorithm, guard);
+            report.seams_carved = src.width - reached;
+            remainder = reached == carve_width ? ImageView(carved) : partial(reached);
+            break;
+        }
+    }
+
+    if (report.seams_carved < seams) {
+        scale_width(remainder, dst);
+    }
+    report.elapsed_ms = elapsed_ms();
+    spdlog::info("Deadline carve {}x{} -> {} px: {} mode, {} of {} columns by seams, {:.1f}ms of {:.1f}ms{}",
+                 src.width, src.height, target_width, quality_mode_name(report.plan.mode),
+                 report.seams_carved, seams, report.elapsed_ms, deadline_ms,
+                 report.degraded ? " (cut short)" : "");
+    return report;
+}
+
+void scale_width(const ImageView& src, const MutableImageView& dst) {
+    int channels = src.channels;
+    float x_ratio = static_cast<float>(src.width) / dst.width;
+
+    // Taps are the same for every row: left pixel offset and 8-bit weight of the right one
+    std::vector<int> offsets(dst.width);
+    std::vector<int> steps(dst.width);
+    std::vector<int> weights(dst.width);
+    for (int x = 0; x < dst.width; x++) {
+        float src_x = x * x_ratio;
+        int x1 = static_cast<int>(src_x);
+        int x2 = std::min(x1 + 1, src.width - 1);
+        offsets[x] = x1 * channels;
+        steps[x] = (x2 - x1) * channels;
+        weights[x] = static_cast<int>((src_x - x1) * 256.0f + 0.5f);
+    }
+
+    for (int y = 0; y < src.height; y++) {
+        const unsigned char* in = src.row(y);
+        unsigned char* out = dst.row(y);
+        for (int x = 0; x < dst.width; x++) {
+            const unsigned char* left = in + offsets[x];
+            const unsigned char* right = left + steps[x];
+            int weight = weights[x];
+            for (int c = 0; c < channels; c++) {
+                *out++ = static_cast<unsigned char>((left[c] * (256 - weight) + right[c] * weight + 128) >> 8);
+            }
+        }
+    }
+}
+
+} // namespace SeamCarving
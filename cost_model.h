@@ -0,0 +1,149 @@
+#pragma once
+
+#include "seam_carving.h"
+
+namespace SeamCarving {
+
+    /**
+     * @brief Ways to reach a target width, best quality first
+     */
+    enum class QualityMode {
+        EXACT,          ///< Energy recomputed after every seam (reduce_width_iteratively)
+        APPROX_ENERGY,  ///< Energy computed once and compacted with the seams; stale along removed seams
+        PYRAMID,        ///< Seams found on a downscaled copy, each removing `factor` columns at full size
+        HYBRID          ///< As many exact seams as fit, then linear scaling for the rest
+    };
+
+    const char* quality_mode_name(QualityMode mode);
+
+    /**
+     * @brief Predicted run time of the carving passes on this host
+     *
+     * Each pass is modelled as a per-element cost in nanoseconds, measured
+     * once by calibrate() on a synthetic image. Seam loops are summed
+     * over the shrinking widths, so the prediction follows the per-seam cost
+     * down instead of assuming it constant.
+     */
+    struct CostModel {
+        double energy_ns = 0.0;    ///< Sobel energy, per pixel
+        double dp_ns = 0.0;        ///< DP seam search, per pixel
+        double greedy_ns = 0.0;    ///< Greedy seam search, per element of row 0 plus one per row
+        double remove_ns = 0.0;    ///< Seam removal, per pixel of the working image
+        double compact_ns = 0.0;   ///< Removing a seam from the float energy map, per pixel
+        double gather_ns = 0.0;    ///< Order map gather, per source pixel
+        double resample_ns = 0.0;  ///< Linear width scaling or box downscaling, per output pixel
+        int cores = 1;             ///< Hardware threads the coefficients are shared between
+
+        /// Measure the coefficients on this host (tens of milliseconds)
+        static CostModel calibrate();
+        /**
+         * Model of this host, calibrated on first use (thread-safe).
+         *
+         * Entry points call this once at startup (the app, the Python module,
+         * the batch supervisor before it forks its workers), so no carve pays
+         * for the calibration.
+         */
+        static const CostModel& host();
+        /// Model of this host if host() ran already, nullptr otherwise; never calibrates
+        static const CostModel* host_if_calibrated();
+
+        /**
+         * Predicted milliseconds to remove seams with one mode.
+         *
+         * @param mode How the width is reduced
+         * @param width Source width
+         * @param height Source height
+         * @param seams Columns to remove
+         * @param algorithm Seam search used by the carving part
+         * @param threads Carving jobs running at once on the host; beyond
+         *                `cores` they share the CPU and each one slows down
+         * @param exact_seams HYBRID only: seams carved before scaling
+         * @param pyramid_factor PYRAMID only: downscale factor
+         */
+        double predict_ms(QualityMode mode, int width, int height, int seams, Algorithm algorithm,
+                          int threads = 1, int exact_seams = 0, int pyramid_factor = 2) const;
+
+        /**
+         * Predicted milliseconds of the seam loop from `width` down to `width - seams`.
+         *
+         * @param recompute_energy false for the APPROX_ENERGY loop (one energy
+         *                         pass, then compaction per seam)
+         */
+        double seam_loop_ms(int width, int height, int seams, Algorithm algorithm,
+                            bool recompute_energy = true) const;
+    };
+
+    /**
+     * @brief Mode chosen for a deadline
+     */
+    struct CarvePlan {
+        QualityMode mode = QualityMode::EXACT;
+        int exact_seams = 0;      ///< HYBRID: seams carved before scaling
+        int pyramid_factor = 2;   ///< PYRAMID: downscale factor
+        double predicted_ms = 0.0;
+    };
+
+    /**
+     * Pick the best quality mode predicted to finish within the deadline.
+     *
+     * Modes are tried from EXACT to HYBRID (PYRAMID with factors 2 then 4);
+     * HYBRID takes as many exact seams as fit, down to plain scaling.
+     *
+     * @param model Cost model of the host
+     * @param width Source width
+     * @param height Source height
+     * @param target_width Width to reach
+     * @param algorithm Seam search algorithm
+     * @param deadline_ms Time budget
+     * @param threads Carving jobs running at once on the host
+     */
+    CarvePlan plan_carve(const CostModel& model, int width, int height, int target_width, Algorithm algorithm,
+                         double deadline_ms, int threads = 1);
+
+    /**
+     * @brief What reduce_width_with_deadline() did
+     */
+    struct DeadlineReport {
+        CarvePlan plan;
+        int seams_carved = 0;     ///< Columns removed by seams; the rest were scaled away
+        double elapsed_ms = 0.0;
+        bool degraded = false;    ///< Carving was cut short to meet the deadline
+    };
+
+    /**
+     * Reduce the width within a deadline, degrading quality as needed.
+     *
+     * The mode comes from plan_carve() on the host cost model. Before each
+     * seam a guard checks that the seam plus scaling the remaining width
+     * still fit; otherwise the partial result is scaled to the target. A wrong
+     * prediction therefore costs quality, not latency. The run time stays
+     * within the deadline unless even plain scaling does not fit, in which
+     * case it is the scaling time. The deadline clock starts after the host
+     * model is available; call CostModel::host() at startup so the first call
+     * does not wait for the calibration.
+     *
+     * @param src Input image view
+     * @param dst Output view with the target width
+     * @param buffers Reusable scratch memory
+     * @param algorithm Seam search algorithm
+     * @param deadline_ms Time budget from the call
+     * @param threads Carving jobs running at once on the host
+     */
+    DeadlineReport reduce_width_with_deadline(
+        const ImageView& src,
+        const MutableImageView& dst,
+        CarveBuffers& buffers,
+        Algorithm algorithm,
+        double deadline_ms,
+        int threads = 1
+    );
+
+    /**
+     * Resize the width with linear interpolation (8-bit fixed point weights).
+     *
+     * @param src Input image view
+     * @param dst Output view with the same height and channels
+     */
+    void scale_width(const ImageView& src, const MutableImageView& dst);
+
+} // namespace SeamCarving
@@ -0,0 +1,742 @@
+#include "display_texture.h"
+#include "upload_thread.h"
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <spdlog/spdlog.h>
+
+namespace Display {
+
+namespace {
+
+// Preferred tile edge length, clamped to GL_MAX_TEXTURE_SIZE
+constexpr int kTileSize = 512;
+// Uploaded tiles kept per TiledTexture before off-screen ones get evicted
+constexpr size_t kMaxCachedTiles = 64;
+
+GLenum gl_format(int channels) {
+    return channels == 4 ? GL_RGBA : GL_RGB;
+}
+
+int max_texture_size() {
+    static GLint max_size = 0;
+    if (max_size == 0) {
+        glGetIntegerv(GL_MAX_TEXTURE_SIZE, &max_size);
+        if (max_size <= 0) {
+            max_size = 2048; // minimum guaranteed by GL 3.0
+        }
+    }
+    return max_size;
+}
+
+// Warp shader: each output pixel fetches its source column from the lookup
+const char* kWarpVertexShader = R"(
+uniform mat4 ProjMtx;
+in vec2 Position;
+in vec2 UV;
+out vec2 Frag_UV;
+void main() {
+    Frag_UV = UV;
+    gl_Position = ProjMtx * vec4(Position.xy, 0.0, 1.0);
+}
+)";
+
+const char* kWarpFragmentShader = R"(
+uniform sampler2D Source;
+uniform isampler2D Lookup;
+uniform vec2 OutputSize;
+in vec2 Frag_UV;
+out vec4 Out_Color;
+void main() {
+    ivec2 p = ivec2(clamp(Frag_UV * OutputSize, vec2(0.0), OutputSize - 1.0));
+    int source_x = texelFetch(Lookup, p, 0).r;
+    Out_Color = vec4(texelFetch(Source, ivec2(source_x, p.y), 0).rgb, 1.0);
+}
+)";
+
+struct WarpShader {
+    GLuint program = 0;
+    GLint projection = -1;
+    GLint source = -1;
+    GLint lookup = -1;
+    GLint output_size = -1;
+    GLint position = -1;
+    GLint uv = -1;
+};
+
+WarpShader g_warp;
+
+GLuint compile_shader(GLenum type, const std::string& source) {
+    GLuint shader = glCreateShader(type);
+    const char* text = source.c_str();
+    glShaderSource(shader, 1, &text, nullptr);
+    glCompileShader(shader);
+
+    GLint status = GL_FALSE;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
+    if (status != GL_TRUE) {
+        char log[1024] = {};
+        glGetShaderInfoLog(shader, sizeof(log), nullptr, log);
+        spdlog::error("Warp shader compilation failed: {}", log);
+        glDeleteShader(shader);
+        return 0;
+    }
+    return shader;
+}
+
+} // namespace
+
+std::vector<PyramidLevel> build_pyramid(
+    const unsigned char* pixels,
+    int width,
+    int height,
+    int channels,
+    int min_size
+) {
+    std::vector<PyramidLevel> levels;
+
+    const unsigned char* src = pixels;
+    int src_w = width;
+    int src_h = height;
+
+    while (src_w / 2 >= min_size && src_h / 2 >= min_size) {
+        PyramidLevel level;
+        level.width = src_w / 2;
+        level.height = src_h / 2;
+        level.pixels.resize(static_cast<size_t>(level.width) * level.height * channels);
+
+        // 2x2 box filter; an odd trailing row/column is dropped
+        for (int y = 0; y < level.height; y++) {
+            const unsigned char* row0 = src + static_cast<size_t>(2 * y) * src_w * channels;
+            const unsigned char* row1 = row0 + static_cast<size_t>(src_w) * channels;
+            unsigned char* dst = level.pixels.data() + static_cast<size_t>(y) * level.width * channels;
+
+            for (int x = 0; x < level.width; x++) {
+                for (int c = 0; c < channels; c++) {
+                    int sum = row0[(2 * x) * channels + c] + row0[(2 * x + 1) * channels + c] +
+                              row1[(2 * x) * channels + c] + row1[(2 * x + 1) * channels + c];
+                    dst[x * channels + c] = static_cast<unsigned char>((sum + 2) / 4);
+                }
+            }
+        }
+
+        levels.push_back(std::move(level));
+        src = levels.back().pixels.data();
+        src_w = levels.back().width;
+        src_h = levels.back().height;
+    }
+
+    return levels;
+}
+
+bool create_or_update_texture(
+    GLuint& texture_id,
+    const void* data,
+    int width,
+    int height,
+    int channels,
+    const std::string& description,
+    int row_length
+) {
+    if (texture_id == 0) {
+        glGenTextures(1, &texture_id);
+        if (glGetError() != GL_NO_ERROR) {
+            spdlog::error("Failed to generate texture for {}", description);
+            return false;
+        }
+    }
+
+    glBindTexture(GL_TEXTURE_2D, texture_id);
+    if (glGetError() != GL_NO_ERROR) {
+        spdlog::error("Failed to bind texture for {}", description);
+        return false;
+    }
+
+    // Set pixel alignment; row_length lets us upload a sub-rectangle in place
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, row_length);
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    glTexImage2D(GL_TEXTURE_2D, 0, gl_format(channels), width, height, 0,
+                 gl_format(channels), GL_UNSIGNED_BYTE, data);
+
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+
+    GLenum error = glGetError();
+    if (error != GL_NO_ERROR) {
+        spdlog::error("Failed to upload texture data for {}: OpenGL error {}", description, error);
+        return false;
+    }
+
+    spdlog::debug("Uploaded OpenGL texture for {}: {}x{}", description, width, height);
+    return true;
+}
+
+int first_changed_column(
+    const unsigned char* before,
+    int before_width,
+    const unsigned char* after,
+    int after_width,
+    int height,
+    int channels
+) {
+    if (before == nullptr) {
+        return 0;
+    }
+
+    int common_width = std::min(before_width, after_width);
+    int first_changed = (before_width == after_width) ? after_width : common_width;
+
+    for (int y = 0; y < height && first_changed > 0; y++) {
+        const unsigned char* row_before = before + static_cast<size_t>(y) * before_width * channels;
+        const unsigned char* row_after = after + static_cast<size_t>(y) * after_width * channels;
+
+        // Only the prefix left of the best result so far needs checking
+        int limit = std::min(first_changed, common_width);
+        for (int x = 0; x < limit; x++) {
+            if (std::memcmp(row_before + x * channels, row_after + x * channels, channels) != 0) {
+                first_changed = x;
+                break;
+            }
+        }
+    }
+
+    return first_changed;
+}
+
+void TiledTexture::set_image(
+    const unsigned char* pixels,
+    int width,
+    int height,
+    int channels,
+    int dirty_x0,
+    std::shared_ptr<const void> owner
+) {
+    if (height != height_ || channels != channels_ || tile_size_ == 0) {
+        clear();
+        tile_size_ = std::min(kTileSize, max_texture_size());
+        dirty_x0 = 0;
+    }
+
+    int tiles_x = (width + tile_size_ - 1) / tile_size_;
+    int tiles_y = (height + tile_size_ - 1) / tile_size_;
+
+    // Re-grid: keep the textures of columns that still exist, drop the rest
+    std::vector<Tile> tiles(static_cast<size_t>(tiles_x) * tiles_y);
+    for (int ty = 0; ty < tiles_y_; ty++) {
+        for (int tx = 0; tx < tiles_x_; tx++) {
+            Tile& old_tile = tiles_[static_cast<size_t>(ty) * tiles_x_ + tx];
+            if (tx < tiles_x && ty < tiles_y) {
+                tiles[static_cast<size_t>(ty) * tiles_x + tx] = old_tile;
+            } else {
+                release_tile(old_tile);
+            }
+        }
+    }
+
+    for (int ty = 0; ty < tiles_y; ty++) {
+        for (int tx = 0; tx < tiles_x; tx++) {
+            Tile& tile = tiles[static_cast<size_t>(ty) * tiles_x + tx];
+            int tile_x1 = std::min((tx + 1) * tile_size_, width);
+            // Seam removal shifts everything right of the first seam
+            if (tile_x1 > dirty_x0 || tile.width != tile_x1 - tx * tile_size_) {
+                tile.dirty = true;
+                drop_staged(tile);
+            }
+        }
+    }
+
+    tiles_ = std::move(tiles);
+    tiles_x_ = tiles_x;
+    tiles_y_ = tiles_y;
+    pixels_ = pixels;
+    owner_ = std::move(owner);
+    width_ = width;
+    height_ = height;
+    channels_ = channels;
+    uploaded_bytes_ = 0;
+}
+
+void TiledTexture::clear() {
+    for (Tile& tile : tiles_) {
+        release_tile(tile);
+    }
+    tiles_.clear();
+    tiles_x_ = tiles_y_ = 0;
+    pixels_ = nullptr;
+    owner_.reset();
+    width_ = height_ = channels_ = 0;
+    uploaded_bytes_ = 0;
+}
+
+bool TiledTexture::upload_tile(Tile& tile, int tile_x, int tile_y) {
+    int x0 = tile_x * tile_size_;
+    int y0 = tile_y * tile_size_;
+    int tile_w = std::min(tile_size_, width_ - x0);
+    int tile_h = std::min(tile_size_, height_ - y0);
+    const unsigned char* first_pixel = pixels_ + (static_cast<size_t>(y0) * width_ + x0) * channels_;
+
+    if (tile.texture != 0 && tile.width == tile_w && tile.height == tile_h) {
+        // Same footprint: update in place instead of reallocating storage
+        glBindTexture(GL_TEXTURE_2D, tile.texture);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, width_);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, tile_w, tile_h, gl_format(channels_),
+                        GL_UNSIGNED_BYTE, first_pixel);
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+
+        GLenum error = glGetError();
+        if (error != GL_NO_ERROR) {
+            spdlog::error("Failed to update tile {},{}: OpenGL error {}", tile_x, tile_y, error);
+            return false;
+        }
+    } else if (!create_or_update_texture(tile.texture, first_pixel, tile_w, tile_h, channels_,
+                                         fmt::format("tile {},{}", tile_x, tile_y), width_)) {
+        return false;
+    }
+
+    tile.width = tile_w;
+    tile.height = tile_h;
+    tile.dirty = false;
+    uploaded_bytes_ += static_cast<size_t>(tile_w) * tile_h * channels_;
+    return true;
+}
+
+void TiledTexture::submit_tile(Tile& tile, int tile_x, int tile_y) {
+    int x0 = tile_x * tile_size_;
+    int y0 = tile_y * tile_size_;
+    int tile_w = std::min(tile_size_, width_ - x0);
+    int tile_h = std::min(tile_size_, height_ - y0);
+    const unsigned char* first_pixel = pixels_ + (static_cast<size_t>(y0) * width_ + x0) * channels_;
+
+    drop_staged(tile);
+    tile.ticket = upload_thread()->submit(first_pixel, tile_w, tile_h, channels_, width_, owner_);
+    tile.dirty = false;
+}
+
+void TiledTexture::collect_uploads(int first_tx, int first_ty, int last_tx, int last_ty) {
+    UploadThread* uploader = upload_thread();
+    if (uploader == nullptr) {
+        return;
+    }
+
+    bool visible_pending = false;
+    for (int ty = 0; ty < tiles_y_; ty++) {
+        for (int tx = 0; tx < tiles_x_; tx++) {
+            Tile& tile = tiles_[static_cast<size_t>(ty) * tiles_x_ + tx];
+            if (tile.ticket == 0) {
+                continue;
+            }
+            UploadedTexture uploaded;
+            if (uploader->take(tile.ticket, uploaded)) {
+                tile.ticket = 0;
+                if (uploaded.texture == 0) {
+                    tile.dirty = true; // failed, retried on the next draw like a synchronous upload
+                    continue;
+                }
+                tile.staged = uploaded.texture;
+                tile.staged_width = uploaded.width;
+                tile.staged_height = uploaded.height;
+            } else if (tx >= first_tx && tx <= last_tx && ty >= first_ty && ty <= last_ty) {
+                visible_pending = true;
+            }
+        }
+    }
+
+    // Swap only once the whole visible region is ready, so a new image never
+    // shows up half old, half new
+    if (visible_pending) {
+        return;
+    }
+    for (Tile& tile : tiles_) {
+        if (tile.staged == 0) {
+            continue;
+        }
+        if (tile.texture != 0) {
+            glDeleteTextures(1, &tile.texture);
+        }
+        tile.texture = tile.staged;
+        tile.width = tile.staged_width;
+        tile.height = tile.staged_height;
+        tile.staged = 0;
+        uploaded_bytes_ += static_cast<size_t>(tile.width) * tile.height * channels_;
+    }
+}
+
+void TiledTexture::drop_staged(Tile& tile) {
+    if (tile.ticket != 0 && upload_thread() != nullptr) {
+        upload_thread()->discard(tile.ticket);
+    }
+    tile.ticket = 0;
+    if (tile.staged != 0) {
+        glDeleteTextures(1, &tile.staged);
+        tile.staged = 0;
+    }
+}
+
+void TiledTexture::release_tile(Tile& tile) {
+    drop_staged(tile);
+    if (tile.texture != 0) {
+        glDeleteTextures(1, &tile.texture);
+    }
+    tile = Tile();
+}
+
+void TiledTexture::draw(const ImVec2& origin, float scale,
+                        float visible_x0, float visible_y0,
+                        float visible_x1, float visible_y1) {
+    if (!valid()) {
+        return;
+    }
+    frame_++;
+
+    int first_tx = std::max(0, static_cast<int>(visible_x0) / tile_size_);
+    int first_ty = std::max(0, static_cast<int>(visible_y0) / tile_size_);
+    int last_tx = std::min(tiles_x_ - 1, static_cast<int>(std::ceil(visible_x1)) / tile_size_);
+    int last_ty = std::min(tiles_y_ - 1, static_cast<int>(std::ceil(visible_y1)) / tile_size_);
+
+    // Pixels with an owner are uploaded on the upload thread, others right here
+    bool async = owner_ != nullptr && upload_thread() != nullptr;
+    for (int ty = first_ty; ty <= last_ty; ty++) {
+        for (int tx = first_tx; tx <= last_tx; tx++) {
+            Tile& tile = tiles_[static_cast<size_t>(ty) * tiles_x_ + tx];
+            if (tile.dirty) {
+                if (async) {
+                    submit_tile(tile, tx, ty);
+                } else {
+                    upload_tile(tile, tx, ty);
+                }
+            }
+            tile.last_used_frame = frame_;
+        }
+    }
+    collect_uploads(first_tx, first_ty, last_tx, last_ty);
+
+    ImDrawList* draw_list = ImGui::GetWindowDrawList();
+    for (int ty = first_ty; ty <= last_ty; ty++) {
+        for (int tx = first_tx; tx <= last_tx; tx++) {
+            const Tile& tile = tiles_[static_cast<size_t>(ty) * tiles_x_ + tx];
+            if (tile.texture == 0) {
+                continue;
+            }
+
+            float x0 = static_cast<float>(tx * tile_size_);
+            float y0 = static_cast<float>(ty * tile_size_);
+            draw_list->AddImage(
+                (ImTextureID)(intptr_t)tile.texture,
+                ImVec2(origin.x + x0 * scale, origin.y + y0 * scale),
+                ImVec2(origin.x + (x0 + tile.width) * scale, origin.y + (y0 + tile.height) * scale));
+        }
+    }
+
+    evict_tiles();
+}
+
+void TiledTexture::evict_tiles() {
+    auto resident = [](const Tile& tile) { return tile.texture != 0 || tile.staged != 0 || tile.ticket != 0; };
+    size_t count = 0;
+    for (const Tile& tile : tiles_) {
+        count += resident(tile) ? 1 : 0;
+    }
+
+    while (count > kMaxCachedTiles) {
+        Tile* oldest = nullptr;
+        for (Tile& tile : tiles_) {
+            if (resident(tile) && (oldest == nullptr || tile.last_used_frame < oldest->last_used_frame)) {
+                oldest = &tile;
+            }
+        }
+        // Never evict what is on screen right now
+        if (oldest == nullptr || oldest->last_used_frame == frame_) {
+            break;
+        }
+        release_tile(*oldest);
+        count--;
+    }
+}
+
+void LodTexture::set_image(
+    const unsigned char* pixels,
+    int width,
+    int height,
+    int channels,
+    std::vector<PyramidLevel> levels,
+    int dirty_x0,
+    std::shared_ptr<const void> owner
+) {
+    if (height != height_ || channels != channels_) {
+        dirty_x0 = 0;
+    }
+    base_ = pixels;
+    width_ = width;
+    height_ = height;
+    channels_ = channels;
+    levels_ = std::make_shared<const std::vector<PyramidLevel>>(std::move(levels));
+    uploaded_bytes_ = 0;
+
+    full_res_.set_image(pixels, width, height, channels, dirty_x0, std::move(owner));
+
+    // Level L pixel x averages source columns [x * 2^L, (x + 1) * 2^L)
+    if (preview_level_ > 0 && preview_level_ <= level_count()) {
+        const PyramidLevel& lod = (*levels_)[preview_level_ - 1];
+        preview_.set_image(lod.pixels.data(), lod.width, lod.height, channels,
+                           dirty_x0 >> preview_level_, levels_);
+    } else {
+        preview_.clear();
+        preview_level_ = -1;
+    }
+}
+
+void LodTexture::clear() {
+    full_res_.clear();
+    preview_.clear();
+    preview_level_ = -1;
+
+    base_ = nullptr;
+    width_ = height_ = channels_ = 0;
+    levels_.reset();
+    current_level_ = 0;
+    uploaded_bytes_ = 0;
+}
+
+void LodTexture::draw(const char* id, float scale, float max_view_height, ImVec2* hovered_pixel) {
+    if (hovered_pixel) {
+        *hovered_pixel = ImVec2(-1.0f, -1.0f);
+    }
+    if (!valid() || scale <= 0.0f) {
+        return;
+    }
+
+    // Pick the coarsest level that still has at least one texel per screen pixel
+    float texels_per_pixel = 1.0f / scale;
+    int level = 0;
+    while (level < level_count() &&
+           static_cast<float>(2 << level) <= texels_per_pixel) {
+        level++;
+    }
+    current_level_ = level;
+
+    ImVec2 content(width_ * scale, height_ * scale);
+    ImVec2 view(std::min(ImGui::GetContentRegionAvail().x, content.x),
+                std::min(max_view_height, content.y));
+    view.x = std::max(view.x, 1.0f);
+    view.y = std::max(view.y, 1.0f);
+
+    ImGui::BeginChild(id, view, ImGuiChildFlags_None, ImGuiWindowFlags_HorizontalScrollbar);
+    ImVec2 inner = ImGui::GetContentRegionAvail();
+    ImVec2 origin = ImGui::GetCursorScreenPos();
+    float scroll_x = ImGui::GetScrollX();
+    float scroll_y = ImGui::GetScrollY();
+    ImGui::Dummy(content);
+    if (hovered_pixel && ImGui::IsItemHovered()) {
+        ImVec2 mouse = ImGui::GetIO().MousePos;
+        *hovered_pixel = ImVec2((mouse.x - origin.x) / scale, (mouse.y - origin.y) / scale);
+    }
+
+    if (level == 0) {
+        full_res_.draw(origin, scale,
+                       scroll_x / scale, scroll_y / scale,
+                       (scroll_x + inner.x) / scale, (scroll_y + inner.y) / scale);
+    } else {
+        const PyramidLevel& lod = (*levels_)[level - 1];
+        if (preview_level_ != level) {
+            uploaded_bytes_ += preview_.uploaded_bytes();
+            preview_.clear();
+            // No owner: a level change has nothing to keep on screen meanwhile, and
+            // levels are about screen sized, so this one uploads on the render thread
+            preview_.set_image(lod.pixels.data(), lod.width, lod.height, channels_);
+            preview_level_ = level;
+        }
+
+        // Screen pixels per level pixel; the level covers the same area
+        float level_scale = scale * static_cast<float>(width_) / lod.width;
+        preview_.draw(origin, level_scale,
+                      scroll_x / level_scale, scroll_y / level_scale,
+                      (scroll_x + inner.x) / level_scale, (scroll_y + inner.y) / level_scale);
+    }
+
+    ImGui::EndChild();
+}
+
+bool init_warp_shader(const char* glsl_version) {
+    // texelFetch and integer samplers need GLSL 1.30 (desktop) or 3.00 ES
+    int version = 0;
+    if (glsl_version == nullptr || std::sscanf(glsl_version, "#version %d", &version) != 1 || version < 130) {
+        spdlog::info("Warp shader needs GLSL 1.30 or newer, carved views use CPU results");
+        return false;
+    }
+    std::string header = std::string(glsl_version) + "\n";
+    if (std::strstr(glsl_version, "es") != nullptr) {
+        header += "precision highp float;\nprecision highp int;\nprecision highp isampler2D;\n";
+    }
+
+    GLuint vertex = compile_shader(GL_VERTEX_SHADER, header + kWarpVertexShader);
+    GLuint fragment = compile_shader(GL_FRAGMENT_SHADER, header + kWarpFragmentShader);
+    if (vertex == 0 || fragment == 0) {
+        glDeleteShader(vertex);
+        glDeleteShader(fragment);
+        return false;
+    }
+
+    GLuint program = glCreateProgram();
+    glAttachShader(program, vertex);
+    glAttachShader(program, fragment);
+    glLinkProgram(program);
+    glDeleteShader(vertex);
+    glDeleteShader(fragment);
+
+    GLint status = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &status);
+    if (status != GL_TRUE) {
+        char log[1024] = {};
+        glGetProgramInfoLog(program, sizeof(log), nullptr, log);
+        spdlog::error("Warp shader link failed: {}", log);
+        glDeleteProgram(program);
+        return false;
+    }
+
+    g_warp.program = program;
+    g_warp.projection = glGetUniformLocation(program, "ProjMtx");
+    g_warp.source = glGetUniformLocation(program, "Source");
+    g_warp.lookup = glGetUniformLocation(program, "Lookup");
+    g_warp.output_size = glGetUniformLocation(program, "OutputSize");
+    g_warp.position = glGetAttribLocation(program, "Position");
+    g_warp.uv = glGetAttribLocation(program, "UV");
+    spdlog::info("Warp shader ready, carved views are rendered from the seam order map");
+    return true;
+}
+
+void shutdown_warp_shader() {
+    if (g_warp.program != 0) {
+        glDeleteProgram(g_warp.program);
+    }
+    g_warp = WarpShader();
+}
+
+bool WarpedTexture::supported() {
+    return g_warp.program != 0;
+}
+
+bool WarpedTexture::set_source(const unsigned char* pixels, int width, int height, int channels) {
+    if (!supported() || width > max_texture_size() || height > max_texture_size()) {
+        return false;
+    }
+    if (!create_or_update_texture(source_texture_, pixels, width, height, channels, "warp source")) {
+        clear();
+        return false;
+    }
+    source_width_ = width;
+    height_ = height;
+    lookup_bytes_ = 0;
+    return true;
+}
+
+bool WarpedTexture::set_lookup(const int* lookup, int width, int height) {
+    if (!has_source() || height != height_) {
+        return false;
+    }
+    if (lookup_texture_ == 0) {
+        glGenTextures(1, &lookup_texture_);
+    }
+    glBindTexture(GL_TEXTURE_2D, lookup_texture_);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+
+    // Integer textures must not be filtered
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    if (width == lookup_width_) {
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, GL_RED_INTEGER, GL_INT, lookup);
+    } else {
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_R32I, width, height, 0, GL_RED_INTEGER, GL_INT, lookup);
+    }
+
+    GLenum error = glGetError();
+    if (error != GL_NO_ERROR) {
+        spdlog::error("Failed to upload warp lookup {}x{}: OpenGL error {}", width, height, error);
+        return false;
+    }
+    lookup_width_ = width;
+    lookup_bytes_ += static_cast<size_t>(width) * height * sizeof(int);
+    return true;
+}
+
+void WarpedTexture::clear() {
+    if (source_texture_ != 0) {
+        glDeleteTextures(1, &source_texture_);
+    }
+    if (lookup_texture_ != 0) {
+        glDeleteTextures(1, &lookup_texture_);
+    }
+    source_texture_ = 0;
+    lookup_texture_ = 0;
+    source_width_ = 0;
+    height_ = 0;
+    lookup_width_ = 0;
+    lookup_bytes_ = 0;
+}
+
+// Runs inside ImGui_ImplOpenGL3_RenderDrawData with the backend's vertex
+// buffer bound; switches to the warp program for the following image draw.
+void WarpedTexture::setup_render_state(const ImDrawList*, const ImDrawCmd* cmd) {
+    const auto* self = static_cast<const WarpedTexture*>(cmd->UserCallbackData);
+
+    // Reuse the backend's projection so multi-viewport rendering stays correct
+    GLint backend_program = 0;
+    glGetIntegerv(GL_CURRENT_PROGRAM, &backend_program);
+    GLfloat projection[16] = {};
+    glGetUniformfv(backend_program, glGetUniformLocation(backend_program, "ProjMtx"), projection);
+
+    glUseProgram(g_warp.program);
+    glUniformMatrix4fv(g_warp.projection, 1, GL_FALSE, projection);
+    glUniform1i(g_warp.source, 0);
+    glUniform1i(g_warp.lookup, 1);
+    glUniform2f(g_warp.output_size, static_cast<float>(self->lookup_width_), static_cast<float>(self->height_));
+
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, self->lookup_texture_);
+    glActiveTexture(GL_TEXTURE0);
+
+    glEnableVertexAttribArray(g_warp.position);
+    glVertexAttribPointer(g_warp.position, 2, GL_FLOAT, GL_FALSE, sizeof(ImDrawVert),
+                          reinterpret_cast<void*>(offsetof(ImDrawVert, pos)));
+    glEnableVertexAttribArray(g_warp.uv);
+    glVertexAttribPointer(g_warp.uv, 2, GL_FLOAT, GL_FALSE, sizeof(ImDrawVert),
+                          reinterpret_cast<void*>(offsetof(ImDrawVert, uv)));
+}
+
+void WarpedTexture::draw(const char* id, float scale, float max_view_height) {
+    if (!valid() || scale <= 0.0f) {
+        return;
+    }
+
+    ImVec2 content(lookup_width_ * scale, height_ * scale);
+    ImVec2 view(std::min(ImGui::GetContentRegionAvail().x, content.x),
+                std::min(max_view_height, content.y));
+    view.x = std::max(view.x, 1.0f);
+    view.y = std::max(view.y, 1.0f);
+
+    ImGui::BeginChild(id, view, ImGuiChildFlags_None, ImGuiWindowFlags_HorizontalScrollbar);
+    ImVec2 origin = ImGui::GetCursorScreenPos();
+    ImGui::Dummy(content);
+
+    // The quad is clipped to the child window by the backend's scissor rect
+    ImDrawList* draw_list = ImGui::GetWindowDrawList();
+    draw_list->AddCallback(&WarpedTexture::setup_render_state, this);
+    draw_list->AddImage((ImTextureID)(intptr_t)source_texture_, origin,
+                        ImVec2(origin.x + content.x, origin.y + content.y));
+    draw_list->AddCallback(ImDrawCallback_ResetRenderState, nullptr);
+
+    ImGui::EndChild();
+}
+
+} // namespace Display
@@ -0,0 +1,356 @@
+#pragma once
+
+#include "imgui.h"
+#include <glad/glad.h>
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Level-of-detail image display on top of OpenGL textures and ImGui
+ */
+namespace Display {
+
+    /**
+     * @brief One downsampled level of an image pyramid
+     */
+    struct PyramidLevel {
+        std::vector<unsigned char> pixels;
+        int width = 0;
+        int height = 0;
+    };
+
+    /**
+     * Build a CPU image pyramid by repeated 2x2 box filtering.
+     *
+     * Level 0 (the full resolution image) is not part of the result; element i
+     * holds level i+1, i.e. the image downsampled by 2^(i+1). Levels are generated
+     * until either dimension would drop below min_size.
+     *
+     * Time Complexity: O(width * height) - each level costs a quarter of the previous one
+     *
+     * @param pixels Image pixel data (RGB or RGBA format)
+     * @param width Image width
+     * @param height Image height
+     * @param channels Number of channels (3 or 4)
+     * @param min_size Smallest width/height a generated level may have
+     * @return Downsampled levels, finest first
+     */
+    std::vector<PyramidLevel> build_pyramid(
+        const unsigned char* pixels,
+        int width,
+        int height,
+        int channels,
+        int min_size = 32
+    );
+
+    /**
+     * Create (if needed) and fill an OpenGL texture.
+     *
+     * @param texture_id Texture name, generated when 0
+     * @param data Pixel data of the first row to upload
+     * @param width Width of the uploaded region
+     * @param height Height of the uploaded region
+     * @param channels Number of channels (3 or 4)
+     * @param description Name used in log messages
+     * @param row_length Pixels per source row, 0 when rows are tightly packed
+     * @return True on success
+     */
+    bool create_or_update_texture(
+        GLuint& texture_id,
+        const void* data,
+        int width,
+        int height,
+        int channels,
+        const std::string& description,
+        int row_length = 0
+    );
+
+    /**
+     * Find the leftmost column in which two images differ.
+     *
+     * Used to turn a new carve result into a dirty column range: every column
+     * left of the returned index is identical in both images.
+     *
+     * @param before Previous pixel data (may be nullptr)
+     * @param before_width Previous image width
+     * @param after New pixel data
+     * @param after_width New image width
+     * @param height Image height (shared by both images)
+     * @param channels Number of channels (shared by both images)
+     * @return First differing column, or after_width when nothing changed
+     */
+    int first_changed_column(
+        const unsigned char* before,
+        int before_width,
+        const unsigned char* after,
+        int after_width,
+        int height,
+        int channels
+    );
+
+    /**
+     * @brief Image split into a grid of fixed-size GL textures
+     *
+     * Lifts the GL_MAX_TEXTURE_SIZE limit and keeps updates incremental: after
+     * set_image() only the tiles intersecting the dirty column range are
+     * re-uploaded, and only once they become visible. Tiles that scrolled out of
+     * view are evicted least-recently-used first.
+     *
+     * When set_image() is given an owner and the upload thread runs, dirty tiles
+     * are uploaded there: the previous textures stay on screen until every
+     * visible tile of the new image is ready, then all of them are swapped in
+     * the same frame.
+     *
+     * The pixels passed to set_image() are not copied and must stay alive until
+     * the next set_image() or clear().
+     */
+    class TiledTexture {
+    public:
+        TiledTexture() = default;
+        TiledTexture(const TiledTexture&) = delete;
+        TiledTexture& operator=(const TiledTexture&) = delete;
+
+        /**
+         * Point the texture at new pixels.
+         *
+         * Columns left of dirty_x0 must be identical to the previous image; their
+         * tiles keep their uploaded texture. A change of height or channel count
+         * invalidates every tile.
+         *
+         * @param pixels Pixel data (not copied)
+         * @param width Image width
+         * @param height Image height
+         * @param channels Number of channels (3 or 4)
+         * @param dirty_x0 First column that differs from the previous image
+         * @param owner Keeps pixels alive for the upload thread; without it tiles upload on draw()
+         */
+        void set_image(
+            const unsigned char* pixels,
+            int width,
+            int height,
+            int channels,
+            int dirty_x0 = 0,
+            std::shared_ptr<const void> owner = nullptr
+        );
+
+        /// Release all GL textures and forget the image (needs a current GL context)
+        void clear();
+
+        /**
+         * Upload dirty visible tiles and draw the visible part of the grid.
+         *
+         * @param origin Screen position of the image's top-left corner
+         * @param scale Screen pixels per image pixel
+         * @param visible_x0 Left edge of the visible region in image pixels
+         * @param visible_y0 Top edge of the visible region in image pixels
+         * @param visible_x1 Right edge of the visible region in image pixels
+         * @param visible_y1 Bottom edge of the visible region in image pixels
+         */
+        void draw(const ImVec2& origin, float scale,
+                  float visible_x0, float visible_y0,
+                  float visible_x1, float visible_y1);
+
+        bool valid() const { return pixels_ != nullptr; }
+        /// Bytes uploaded to the GPU since the last set_image()
+        size_t uploaded_bytes() const { return uploaded_bytes_; }
+
+    private:
+        struct Tile {
+            GLuint texture = 0;
+            int width = 0;      ///< Size of the uploaded texture
+            int height = 0;
+            bool dirty = true;
+            unsigned long long last_used_frame = 0;
+            std::uint64_t ticket = 0;  ///< Upload in flight on the upload thread, 0 = none
+            GLuint staged = 0;         ///< Uploaded replacement, swapped in with the other visible tiles
+            int staged_width = 0;
+            int staged_height = 0;
+        };
+
+        bool upload_tile(Tile& tile, int tile_x, int tile_y);
+        void submit_tile(Tile& tile, int tile_x, int tile_y);
+        void collect_uploads(int first_tx, int first_ty, int last_tx, int last_ty);
+        static void drop_staged(Tile& tile);
+        static void release_tile(Tile& tile);
+        void evict_tiles();
+
+        const unsigned char* pixels_ = nullptr;
+        std::shared_ptr<const void> owner_;
+        int width_ = 0;
+        int height_ = 0;
+        int channels_ = 0;
+        int tile_size_ = 0;
+        int tiles_x_ = 0;
+        int tiles_y_ = 0;
+        std::vector<Tile> tiles_;  ///< Row-major tiles_y_ x tiles_x_ grid
+
+        size_t uploaded_bytes_ = 0;
+        unsigned long long frame_ = 0;
+    };
+
+    /**
+     * @brief Viewport-aware texture for one displayed image
+     *
+     * Instead of uploading the full image, only the pyramid level that matches
+     * the on-screen size is uploaded. Once the view is zoomed in far enough that
+     * full resolution is needed, the image is streamed as tiles and only the
+     * tiles intersecting the visible region are uploaded. Both paths go through
+     * TiledTexture, so levels larger than GL_MAX_TEXTURE_SIZE work and updates
+     * only touch the dirty columns.
+     *
+     * The level 0 pixels passed to set_image() are not copied and must stay
+     * alive until the next set_image() or clear(). GL textures are only freed
+     * by clear(), which has to run while the GL context is still current.
+     */
+    class LodTexture {
+    public:
+        LodTexture() = default;
+        LodTexture(const LodTexture&) = delete;
+        LodTexture& operator=(const LodTexture&) = delete;
+
+        /**
+         * Replace the displayed image.
+         *
+         * @param pixels Full resolution pixel data (not copied)
+         * @param width Image width
+         * @param height Image height
+         * @param channels Number of channels (3 or 4)
+         * @param levels Pyramid built by build_pyramid() for the same image
+         * @param dirty_x0 First column that differs from the previous image
+         * @param owner Keeps pixels alive for the upload thread (see TiledTexture::set_image)
+         */
+        void set_image(
+            const unsigned char* pixels,
+            int width,
+            int height,
+            int channels,
+            std::vector<PyramidLevel> levels,
+            int dirty_x0 = 0,
+            std::shared_ptr<const void> owner = nullptr
+        );
+
+        /// Release all GL textures and forget the image (needs a current GL context)
+        void clear();
+
+        /**
+         * Draw the image inside a scrollable child window.
+         *
+         * @param id ImGui id of the child window
+         * @param scale Screen pixels per image pixel
+         * @param max_view_height Height limit of the view; taller content scrolls
+         * @param hovered_pixel Optional; set to the image coordinates under the
+         *                      mouse, or (-1, -1) when the view is not hovered
+         */
+        void draw(const char* id, float scale, float max_view_height, ImVec2* hovered_pixel = nullptr);
+
+        bool valid() const { return base_ != nullptr; }
+        int width() const { return width_; }
+        int height() const { return height_; }
+        /// Pyramid level used by the last draw() (0 = full resolution tiles)
+        int current_level() const { return current_level_; }
+        /// Bytes uploaded to the GPU since the last set_image()
+        size_t uploaded_bytes() const { return uploaded_bytes_ + full_res_.uploaded_bytes() + preview_.uploaded_bytes(); }
+
+    private:
+        int level_count() const { return levels_ ? static_cast<int>(levels_->size()) : 0; }
+
+        const unsigned char* base_ = nullptr;
+        int width_ = 0;
+        int height_ = 0;
+        int channels_ = 0;
+        std::shared_ptr<const std::vector<PyramidLevel>> levels_;  ///< Shared with preview uploads in flight
+
+        TiledTexture full_res_;     ///< Level 0, streamed tile by tile
+        TiledTexture preview_;      ///< Currently displayed pyramid level
+        int preview_level_ = -1;
+        size_t uploaded_bytes_ = 0; ///< Bytes of previews replaced since set_image()
+
+        int current_level_ = 0;
+    };
+
+    /**
+     * Compile the shader used by WarpedTexture.
+     *
+     * Needs GLSL 1.30 or ES 3.00 (texelFetch and integer textures); on older
+     * contexts WarpedTexture::supported() stays false and callers keep carving
+     * on the CPU.
+     *
+     * @param glsl_version Version line also given to ImGui_ImplOpenGL3_Init
+     * @return True when the shader is ready
+     */
+    bool init_warp_shader(const char* glsl_version);
+
+    /// Delete the warp shader (needs a current GL context)
+    void shutdown_warp_shader();
+
+    /**
+     * @brief Carved image drawn by warping the original in a fragment shader
+     *
+     * The original is uploaded once as a single texture. A carved width is
+     * described by an integer lookup texture with the source column of every
+     * output pixel (see SeamCarving::build_carve_lookup), so changing the width
+     * replaces only the lookup and no image pixels are uploaded.
+     */
+    class WarpedTexture {
+    public:
+        WarpedTexture() = default;
+        WarpedTexture(const WarpedTexture&) = delete;
+        WarpedTexture& operator=(const WarpedTexture&) = delete;
+
+        /// True once init_warp_shader() succeeded
+        static bool supported();
+
+        /**
+         * Upload the original image.
+         *
+         * @param pixels Pixel data (copied to the GPU)
+         * @param width Image width, at most GL_MAX_TEXTURE_SIZE
+         * @param height Image height, at most GL_MAX_TEXTURE_SIZE
+         * @param channels Number of channels (3 or 4)
+         * @return False when the shader is unsupported or the image too large
+         */
+        bool set_source(const unsigned char* pixels, int width, int height, int channels);
+
+        /**
+         * Replace the lookup that selects the displayed width.
+         *
+         * @param lookup Row-major width x height source columns
+         * @param width Carved width
+         * @param height Image height (must match the source)
+         * @return True on success
+         */
+        bool set_lookup(const int* lookup, int width, int height);
+
+        /// Release the GL textures (needs a current GL context)
+        void clear();
+
+        /**
+         * Draw the carved image inside a scrollable child window.
+         *
+         * @param id ImGui id of the child window
+         * @param scale Screen pixels per image pixel
+         * @param max_view_height Height limit of the view; taller content scrolls
+         */
+        void draw(const char* id, float scale, float max_view_height);
+
+        bool has_source() const { return source_texture_ != 0; }
+        bool valid() const { return source_texture_ != 0 && lookup_texture_ != 0; }
+        int width() const { return lookup_width_; }
+        /// Bytes of lookup textures uploaded since set_source()
+        size_t lookup_bytes() const { return lookup_bytes_; }
+
+    private:
+        static void setup_render_state(const ImDrawList* draw_list, const ImDrawCmd* cmd);
+
+        GLuint source_texture_ = 0;
+        GLuint lookup_texture_ = 0;
+        int source_width_ = 0;
+        int height_ = 0;
+        int lookup_width_ = 0;
+        size_t lookup_bytes_ = 0;
+    };
+
+} // namespace Display
@@ -0,0 +1,124 @@
+#include "huge_pages.h"
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <spdlog/spdlog.h>
+
+#if defined(__linux__)
+#include <sys/mman.h>
+#endif
+
+namespace Memory {
+
+namespace {
+
+    HugePageMode mode_from_environment() {
+        const char* value = std::getenv("FLINK_HUGE_PAGES");
+        if (value == nullptr) {
+            return HugePageMode::TRANSPARENT;
+        }
+        if (std::strcmp(value, "off") == 0 || std::strcmp(value, "0") == 0) {
+            return HugePageMode::OFF;
+        }
+        if (std::strcmp(value, "explicit") == 0) {
+            return HugePageMode::EXPLICIT;
+        }
+        return HugePageMode::TRANSPARENT;
+    }
+
+    std::atomic<HugePageMode>& current_mode() {
+        static std::atomic<HugePageMode> mode{mode_from_environment()};
+        return mode;
+    }
+
+    std::size_t round_to_huge_pages(std::size_t bytes) {
+        return (bytes + kHugePageSize - 1) / kHugePageSize * kHugePageSize;
+    }
+
+#if defined(__linux__)
+    // Anonymous mapping aligned to kHugePageSize so every 2 MB of it can be a huge page
+    void* map_aligned(std::size_t size) {
+        std::size_t padded = size + kHugePageSize;
+        void* raw = mmap(nullptr, padded, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (raw == MAP_FAILED) {
+            return nullptr;
+        }
+        auto start = reinterpret_cast<std::uintptr_t>(raw);
+        auto aligned = (start + kHugePageSize - 1) & ~(static_cast<std::uintptr_t>(kHugePageSize) - 1);
+        std::size_t head = aligned - start;
+        std::size_t tail = padded - head - size;
+        if (head > 0) {
+            munmap(raw, head);
+        }
+        if (tail > 0) {
+            munmap(reinterpret_cast<void*>(aligned + size), tail);
+        }
+        return reinterpret_cast<void*>(aligned);
+    }
+#endif
+
+} // namespace
+
+void set_huge_page_mode(HugePageMode mode) {
+    current_mode().store(mode);
+}
+
+HugePageMode huge_page_mode() {
+    return current_mode().load();
+}
+
+const char* huge_page_mode_name(HugePageMode mode) {
+    switch (mode) {
+        case HugePageMode::OFF: return "off";
+        case HugePageMode::TRANSPARENT: return "transparent";
+        case HugePageMode::EXPLICIT: return "explicit";
+    }
+    return "unknown";
+}
+
+void* allocate_large(std::size_t bytes) {
+#if defined(__linux__)
+    if (bytes >= kLargeAllocationThreshold) {
+        // Whole huge pages, so the size (and thus free_large) does not depend on the mode
+        std::size_t size = round_to_huge_pages(bytes);
+        HugePageMode mode = huge_page_mode();
+
+        if (mode == HugePageMode::EXPLICIT) {
+            void* ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                             MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+            if (ptr != MAP_FAILED) {
+                return ptr;
+            }
+            spdlog::debug("MAP_HUGETLB failed for {} bytes, using transparent huge pages", size);
+            mode = HugePageMode::TRANSPARENT;
+        }
+
+        void* ptr = map_aligned(size);
+        if (ptr == nullptr) {
+            throw std::bad_alloc();
+        }
+        // Advice failing (e.g. THP compiled out) just leaves regular pages
+        madvise(ptr, size, mode == HugePageMode::OFF ? MADV_NOHUGEPAGE : MADV_HUGEPAGE);
+        return ptr;
+    }
+#endif
+    return ::operator new(bytes);
+}
+
+void free_large(void* ptr, std::size_t bytes) {
+    if (ptr == nullptr) {
+        return;
+    }
+#if defined(__linux__)
+    if (bytes >= kLargeAllocationThreshold) {
+        munmap(ptr, round_to_huge_pages(bytes));
+        return;
+    }
+#endif
+    ::operator delete(ptr);
+}
+
+} // namespace Memory
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+/**
+ * @brief Allocation of large engine buffers backed by 2 MB pages where available
+ *
+ * Energy maps and DP tables of 100+ megapixel images span hundreds of MB and
+ * are streamed row by row; with 4 KB pages nearly every row start misses the
+ * dTLB. Buffers above kLargeAllocationThreshold are therefore mapped directly
+ * and asked to be backed by huge pages.
+ */
+namespace Memory {
+
+    /**
+     * @brief How large buffers are backed
+     */
+    enum class HugePageMode {
+        OFF,          ///< Regular pages; transparent huge pages explicitly disabled
+        TRANSPARENT,  ///< madvise(MADV_HUGEPAGE), the kernel promotes the region to 2 MB pages
+        EXPLICIT      ///< MAP_HUGETLB from the reserved hugetlbfs pool, falls back to TRANSPARENT
+    };
+
+    /// Buffers at least this large bypass operator new
+    constexpr std::size_t kLargeAllocationThreshold = 2 * 1024 * 1024;
+    constexpr std::size_t kHugePageSize = 2 * 1024 * 1024;
+
+    /**
+     * Select the backing of future large allocations (existing buffers keep theirs).
+     *
+     * The initial mode comes from the FLINK_HUGE_PAGES environment variable
+     * ("off", "transparent" or "explicit"), defaulting to TRANSPARENT.
+     */
+    void set_huge_page_mode(HugePageMode mode);
+    HugePageMode huge_page_mode();
+    const char* huge_page_mode_name(HugePageMode mode);
+
+    /**
+     * Allocate a buffer, huge-page backed when it is large enough.
+     *
+     * Falls back to regular pages when huge pages are unavailable and to
+     * operator new on platforms without mmap. Throws std::bad_alloc on failure.
+     *
+     * @param bytes Size of the buffer
+     * @return Pointer aligned to at least alignof(std::max_align_t)
+     */
+    void* allocate_large(std::size_t bytes);
+
+    /**
+     * Release a buffer from allocate_large().
+     *
+     * @param ptr Buffer to release
+     * @param bytes The size passed to allocate_large()
+     */
+    void free_large(void* ptr, std::size_t bytes);
+
+    /**
+     * @brief Standard allocator on top of allocate_large()
+     */
+    template <typename T>
+    struct HugePageAllocator {
+        using value_type = T;
+
+        HugePageAllocator() = default;
+        template <typename U>
+        HugePageAllocator(const HugePageAllocator<U>&) {}
+
+        T* allocate(std::size_t n) { return static_cast<T*>(allocate_large(n * sizeof(T))); }
+        void deallocate(T* ptr, std::size_t n) { free_large(ptr, n * sizeof(T)); }
+
+        template <typename U>
+        bool operator==(const HugePageAllocator<U>&) const { return true; }
+        template <typename U>
+        bool operator!=(const HugePageAllocator<U>&) const { return false; }
+    };
+
+    /// Vector for image-sized engine buffers
+    template <typename T>
+    using LargeBuffer = std::vector<T, HugePageAllocator<T>>;
+
+} // namespace Memory
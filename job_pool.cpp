@@ -0,0 +1,256 @@
+#include "job_pool.h"
+#include <algorithm>
+#include <spdlog/spdlog.h>
+
+namespace Jobs {
+
+struct JobState {
+    JobFunction function;
+    std::atomic<int> priority{0};
+    std::atomic<bool> cancelled{false};
+    std::atomic<bool> done{false};
+};
+
+JobContext::JobContext(JobPool& pool, std::shared_ptr<JobState> state)
+    : pool_(pool), state_(std::move(state)) {}
+
+bool JobContext::cancelled() const {
+    return state_->cancelled.load(std::memory_order_relaxed);
+}
+
+bool JobContext::checkpoint() {
+    if (cancelled()) {
+        return false;
+    }
+    pool_.park(*state_);
+    return !cancelled();
+}
+
+void JobContext::leave_slot() {
+    pool_.leave_slot(*state_);
+}
+
+void JobContext::rejoin_slot() {
+    pool_.rejoin_slot(*state_);
+}
+
+int JobContext::thread_share() const {
+    return pool_.thread_share();
+}
+
+JobHandle::JobHandle(JobPool* pool, std::shared_ptr<JobState> state)
+    : pool_(pool), state_(std::move(state)) {}
+
+void JobHandle::cancel() {
+    if (!state_) {
+        return;
+    }
+    state_->cancelled = true;
+
+    // Queued jobs are dropped right away so they never take a slot
+    std::lock_guard<std::mutex> lock(pool_->mutex_);
+    auto& queue = pool_->queue_;
+    auto it = std::find(queue.begin(), queue.end(), state_);
+    if (it != queue.end()) {
+        queue.erase(it);
+        state_->function = nullptr;
+        state_->done = true;
+    }
+    // Wake a parked job so it can observe the cancellation
+    pool_->cv_.notify_all();
+}
+
+void JobHandle::set_priority(Priority priority) {
+    if (!state_ || state_->priority.load() == static_cast<int>(priority)) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(pool_->mutex_);
+    state_->priority = static_cast<int>(priority);
+    pool_->cv_.notify_all();
+}
+
+bool JobHandle::done() const {
+    return !state_ || state_->done.load();
+}
+
+JobPool::JobPool(int slots)
+    : slots_(slots > 0 ? slots : std::max(1, static_cast<int>(std::thread::hardware_concurrency()))) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (int i = 0; i < slots_; i++) {
+        threads_.emplace_back(&JobPool::worker_loop, this);
+    }
+    spdlog::info("Job pool started with {} slots", slots_);
+}
+
+JobPool::~JobPool() {
+    shutdown();
+}
+
+JobHandle JobPool::submit(Priority priority, JobFunction function) {
+    auto state = std::make_shared<JobState>();
+    state->function = std::move(function);
+    state->priority = static_cast<int>(priority);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (stopping_) {
+        state->cancelled = true;
+        state->done = true;
+        return JobHandle(this, state);
+    }
+    queue_.push_back(state);
+    cv_.notify_all();
+    return JobHandle(this, state);
+}
+
+void JobPool::shutdown() {
+    std::vector<std::thread> threads;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (stopping_) {
+            return;
+        }
+        stopping_ = true;
+        for (auto& state : queue_) {
+            state->cancelled = true;
+            state->done = true;
+        }
+        queue_.clear();
+        // Running jobs stop at their next checkpoint
+        for (auto& state : running_) {
+            state->cancelled = true;
+        }
+        cv_.notify_all();
+    }
+
+    // Parked jobs may still have spawned a thread before observing stopping_,
+    // so join until no thread is left.
+    while (true) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            threads.swap(threads_);
+        }
+        if (threads.empty()) {
+            break;
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        threads.clear();
+    }
+}
+
+bool JobPool::has_waiting_job_above(int priority) const {
+    for (const auto& state : queue_) {
+        if (state->priority.load() > priority) {
+            return true;
+        }
+    }
+    return false;
+}
+
+std::shared_ptr<JobState> JobPool::pop_highest() {
+    auto best = std::max_element(queue_.begin(), queue_.end(),
+        [](const std::shared_ptr<JobState>& a, const std::shared_ptr<JobState>& b) {
+            // Ties keep submission order
+            return a->priority.load() < b->priority.load();
+        });
+    std::shared_ptr<JobState> state = *best;
+    queue_.erase(best);
+    return state;
+}
+
+void JobPool::worker_loop() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        idle_threads_++;
+        // Parked jobs of equal or higher priority resume before new ones start
+        cv_.wait(lock, [this] {
+            return stopping_ ||
+                   (!queue_.empty() && active_ < slots_ && has_waiting_job_above(highest_parked_priority()));
+        });
+        idle_threads_--;
+        if (stopping_) {
+            return;
+        }
+
+        std::shared_ptr<JobState> state = pop_highest();
+        running_.push_back(state);
+        active_++;
+        lock.unlock();
+
+        {
+            JobContext context(*this, state);
+            if (!context.cancelled()) {
+                state->function(context);
+            }
+        }
+        // Release captured buffers before reporting completion
+        state->function = nullptr;
+
+        lock.lock();
+        running_.erase(std::find(running_.begin(), running_.end(), state));
+        active_--;
+        state->done = true;
+        cv_.notify_all();
+    }
+}
+
+void JobPool::park(JobState& state) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (stopping_ || active_ < slots_ || !has_waiting_job_above(state.priority.load())) {
+        return;
+    }
+
+    // Hand the slot to the waiting job; make sure a thread is there to take it
+    parked_.push_back(&state);
+    active_--;
+    if (idle_threads_ == 0) {
+        threads_.emplace_back(&JobPool::worker_loop, this);
+    }
+    cv_.notify_all();
+
+    take_slot(state, lock);
+    parked_.erase(std::find(parked_.begin(), parked_.end(), &state));
+}
+
+void JobPool::leave_slot(JobState&) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    active_--;
+    // The slot needs a thread, also for jobs submitted while this one blocks
+    if (idle_threads_ == 0) {
+        threads_.emplace_back(&JobPool::worker_loop, this);
+    }
+    cv_.notify_all();
+}
+
+void JobPool::rejoin_slot(JobState& state) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    parked_.push_back(&state);
+    take_slot(state, lock);
+    parked_.erase(std::find(parked_.begin(), parked_.end(), &state));
+}
+
+int JobPool::thread_share() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return std::max(1, slots_ / std::max(1, active_));
+}
+
+void JobPool::take_slot(JobState& state, std::unique_lock<std::mutex>& lock) {
+    // A cancelled job skips the priority order but still waits for a free
+    // slot, as it runs until it unwinds; once stopping, nothing is scheduled
+    cv_.wait(lock, [this, &state] {
+        return stopping_ || (active_ < slots_ && (state.cancelled.load() ||
+                                                  !has_waiting_job_above(state.priority.load())));
+    });
+    active_++;
+}
+
+int JobPool::highest_parked_priority() const {
+    int highest = -1;
+    for (const JobState* state : parked_) {
+        highest = std::max(highest, state->priority.load());
+    }
+    return highest;
+}
+
+} // namespace Jobs
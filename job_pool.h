@@ -0,0 +1,156 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief Shared worker pool with priorities, cancellation and cooperative preemption
+ */
+namespace Jobs {
+
+    /**
+     * @brief Scheduling priority of a job, higher runs first
+     */
+    enum class Priority {
+        BACKGROUND = 0,  ///< Image not visible; runs only when nothing else waits
+        VISIBLE = 1,     ///< Image on screen but not focused
+        FOCUSED = 2      ///< Image the user is interacting with
+    };
+
+    class JobPool;
+    struct JobState;
+
+    /**
+     * @brief Handle given to a running job to cooperate with the scheduler
+     */
+    class JobContext {
+    public:
+        /// True once the job was cancelled or superseded
+        bool cancelled() const;
+
+        /**
+         * Cooperative scheduling point, call it regularly (e.g. once per seam).
+         *
+         * While a higher priority job is waiting for a slot, the calling job is
+         * parked here and its slot is handed over. Returns false when the job was
+         * cancelled and should stop as soon as possible.
+         */
+        bool checkpoint();
+
+        /**
+         * Give the slot up before blocking on something other than the pool,
+         * e.g. memory another job has to release, so queued jobs run in the
+         * meantime. Call rejoin_slot() before working again.
+         */
+        void leave_slot();
+
+        /// Take a slot again after leave_slot(), queued like a parked job
+        void rejoin_slot();
+
+        /**
+         * Threads a parallel pass of this job may start: the slots divided
+         * among the jobs holding one now, at least 1. Ask right before the
+         * pass, so jobs running together do not each take the whole machine.
+         */
+        int thread_share() const;
+
+    private:
+        friend class JobPool;
+        JobContext(JobPool& pool, std::shared_ptr<JobState> state);
+
+        JobPool& pool_;
+        std::shared_ptr<JobState> state_;
+    };
+
+    using JobFunction = std::function<void(JobContext&)>;
+
+    /**
+     * @brief Caller side of a submitted job
+     *
+     * Dropping the handle does not cancel the job; call cancel() to supersede it.
+     */
+    class JobHandle {
+    public:
+        JobHandle() = default;
+
+        /// Ask the job to stop; queued jobs are discarded without running
+        void cancel();
+        /// Change the priority; takes effect at the next scheduling decision
+        void set_priority(Priority priority);
+        /// True once the job returned or was discarded
+        bool done() const;
+        bool valid() const { return state_ != nullptr; }
+
+    private:
+        friend class JobPool;
+        JobHandle(JobPool* pool, std::shared_ptr<JobState> state);
+
+        JobPool* pool_ = nullptr;
+        std::shared_ptr<JobState> state_;
+    };
+
+    /**
+     * @brief Fixed number of execution slots shared by all images
+     *
+     * Queued jobs start in priority order. A running job that reaches a
+     * checkpoint while a higher priority job waits is parked, which frees its
+     * slot; an extra thread picks up the waiting job, so the number of jobs
+     * making progress never exceeds the slot count and total throughput is kept.
+     */
+    class JobPool {
+    public:
+        /**
+         * @param slots Number of jobs allowed to run at once (0 = hardware concurrency)
+         */
+        explicit JobPool(int slots = 0);
+        ~JobPool();
+        JobPool(const JobPool&) = delete;
+        JobPool& operator=(const JobPool&) = delete;
+
+        /**
+         * Queue a job.
+         *
+         * @param priority Initial priority
+         * @param function Work to run on a pool thread
+         * @return Handle used to cancel or reprioritise the job
+         */
+        JobHandle submit(Priority priority, JobFunction function);
+
+        /// Cancel everything and join all threads
+        void shutdown();
+
+        int slots() const { return slots_; }
+
+    private:
+        friend class JobContext;
+        friend class JobHandle;
+
+        void worker_loop();
+        bool has_waiting_job_above(int priority) const;
+        int highest_parked_priority() const;
+        std::shared_ptr<JobState> pop_highest();
+        void park(JobState& state);
+        void leave_slot(JobState& state);
+        void rejoin_slot(JobState& state);
+        int thread_share() const;
+        /// Wait until the job may take a slot and take it (mutex_ held through lock)
+        void take_slot(JobState& state, std::unique_lock<std::mutex>& lock);
+
+        int slots_;
+        mutable std::mutex mutex_;
+        std::condition_variable cv_;
+        std::vector<std::shared_ptr<JobState>> queue_;
+        std::vector<std::shared_ptr<JobState>> running_;
+        std::vector<JobState*> parked_;  ///< Running jobs that gave up their slot
+        std::vector<std::thread> threads_;
+        int active_ = 0;        ///< Jobs currently holding a slot
+        int idle_threads_ = 0;  ///< Threads waiting for work
+        bool stopping_ = false;
+    };
+
+} // namespace Jobs
@@ -0,0 +1,343 @@
+#include "jpeg_decoder.h"
+#include "streaming_carve.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <csetjmp>
+#include <optional>
+#include <spdlog/spdlog.h>
+
+// jpeglib.h needs size_t and FILE declared beforehand
+#include <jpeglib.h>
+
+namespace Jpeg {
+
+namespace {
+
+// libjpeg reports fatal errors through error_exit; jump back instead of exit()
+struct ErrorManager {
+    jpeg_error_mgr base;
+    std::jmp_buf jump;
+};
+
+void error_exit(j_common_ptr cinfo) {
+    ErrorManager* errors = reinterpret_cast<ErrorManager*>(cinfo->err);
+    char message[JMSG_LENGTH_MAX];
+    (*cinfo->err->format_message)(cinfo, message);
+    spdlog::error("libjpeg: {}", message);
+    std::longjmp(errors->jump, 1);
+}
+
+} // namespace
+
+bool is_jpeg(const std::string& path) {
+    FILE* file = std::fopen(path.c_str(), "rb");
+    if (!file) {
+        return false;
+    }
+    unsigned char magic[3] = {0, 0, 0};
+    size_t read = std::fread(magic, 1, sizeof(magic), file);
+    std::fclose(file);
+    return read == sizeof(magic) && magic[0] == 0xFF && magic[1] == 0xD8 && magic[2] == 0xFF;
+}
+
+bool decode_scaled(
+    const std::string& path,
+    int min_size,
+    std::vector<unsigned char>& pixels,
+    int& width,
+    int& height,
+    int& full_width,
+    int& full_height
+) {
+    FILE* file = std::fopen(path.c_str(), "rb");
+    if (!file) {
+        spdlog::error("Failed to open JPEG: {}", path);
+        return false;
+    }
+
+    // Everything with a destructor lives outside the setjmp scope
+    jpeg_decompress_struct cinfo;
+    ErrorManager errors;
+    cinfo.err = jpeg_std_error(&errors.base);
+    errors.base.error_exit = error_exit;
+
+    if (setjmp(errors.jump)) {
+        jpeg_destroy_decompress(&cinfo);
+        std::fclose(file);
+        return false;
+    }
+
+    jpeg_create_decompress(&cinfo);
+    jpeg_stdio_src(&cinfo, file);
+    jpeg_read_header(&cinfo, TRUE);
+
+    full_width = static_cast<int>(cinfo.image_width);
+    full_height = static_cast<int>(cinfo.image_height);
+
+    // Largest DCT scale-down that still satisfies min_size
+    unsigned int denom = 8;
+    while (denom > 1 && static_cast<int>(cinfo.image_width / denom) < min_size) {
+        denom /= 2;
+    }
+    cinfo.scale_num = 1;
+    cinfo.scale_denom = denom;
+    cinfo.out_color_space = JCS_RGB;
+    cinfo.dct_method = JDCT_IFAST;
+    cinfo.do_fancy_upsampling = FALSE;
+
+    jpeg_start_decompress(&cinfo);
+    width = static_cast<int>(cinfo.output_width);
+    height = static_cast<int>(cinfo.output_height);
+    const size_t row_bytes = static_cast<size_t>(width) * cinfo.output_components;
+    pixels.resize(row_bytes * height);
+
+    while (cinfo.output_scanline < cinfo.output_height) {
+        JSAMPROW row = pixels.data() + cinfo.output_scanline * row_bytes;
+        jpeg_read_scanlines(&cinfo, &row, 1);
+    }
+
+    jpeg_finish_decompress(&cinfo);
+    jpeg_destroy_decompress(&cinfo);
+    std::fclose(file);
+
+    spdlog::info("Decoded 1/{} scale preview of {}: {}x{} (full {}x{})",
+                 denom, path, width, height, full_width, full_height);
+    return true;
+}
+
+bool decode_into(const std::string& path, unsigned char* pixels, size_t capacity, int& width, int& height) {
+    FILE* file = std::fopen(path.c_str(), "rb");
+    if (!file) {
+        spdlog::error("Failed to open JPEG: {}", path);
+        return false;
+    }
+
+    jpeg_decompress_struct cinfo;
+    ErrorManager errors;
+    cinfo.err = jpeg_std_error(&errors.base);
+    errors.base.error_exit = error_exit;
+
+    if (setjmp(errors.jump)) {
+        jpeg_destroy_decompress(&cinfo);
+        std::fclose(file);
+        return false;
+    }
+
+    jpeg_create_decompress(&cinfo);
+    jpeg_stdio_src(&cinfo, file);
+    jpeg_read_header(&cinfo, TRUE);
+    cinfo.out_color_space = JCS_RGB;
+
+    jpeg_start_decompress(&cinfo);
+    width = static_cast<int>(cinfo.output_width);
+    height = static_cast<int>(cinfo.output_height);
+    const size_t row_bytes = static_cast<size_t>(width) * cinfo.output_components;
+    if (row_bytes * height > capacity) {
+        jpeg_destroy_decompress(&cinfo);
+        std::fclose(file);
+        return false;
+    }
+
+    while (cinfo.output_scanline < cinfo.output_height) {
+        JSAMPROW row = pixels + cinfo.output_scanline * row_bytes;
+        jpeg_read_scanlines(&cinfo, &row, 1);
+    }
+
+    jpeg_finish_decompress(&cinfo);
+    jpeg_destroy_decompress(&cinfo);
+    std::fclose(file);
+    return true;
+}
+
+bool read_block_energy(const std::string& path, BlockEnergy& energy) {
+    FILE* file = std::fopen(path.c_str(), "rb");
+    if (!file) {
+        spdlog::error("Failed to open JPEG: {}", path);
+        return false;
+    }
+    auto start_time = std::chrono::high_resolution_clock::now();
+
+    jpeg_decompress_struct cinfo;
+    ErrorManager errors;
+    cinfo.err = jpeg_std_error(&errors.base);
+    errors.base.error_exit = error_exit;
+
+    if (setjmp(errors.jump)) {
+        jpeg_destroy_decompress(&cinfo);
+        std::fclose(file);
+        return false;
+    }
+
+    jpeg_create_decompress(&cinfo);
+    jpeg_stdio_src(&cinfo, file);
+    jpeg_read_header(&cinfo, TRUE);
+    jvirt_barray_ptr* coefficients = jpeg_read_coefficients(&cinfo);
+
+    // Component 0 is luma (or the only channel of a grayscale JPEG)
+    jpeg_component_info* luma = &cinfo.comp_info[0];
+    energy.image_width = static_cast<int>(cinfo.image_width);
+    energy.image_height = static_cast<int>(cinfo.image_height);
+    energy.blocks_x = static_cast<int>(luma->width_in_blocks);
+    energy.blocks_y = static_cast<int>(luma->height_in_blocks);
+    energy.block_width = DCTSIZE * cinfo.max_h_samp_factor / luma->h_samp_factor;
+    energy.block_height = DCTSIZE * cinfo.max_v_samp_factor / luma->v_samp_factor;
+    energy.values.resize(static_cast<size_t>(energy.blocks_x) * energy.blocks_y);
+
+    // Dequantization and derivative gain of each coefficient (natural order);
+    // frequencies are per image pixel when a block covers more than 8
+    const double pi = 3.14159265358979323846;
+    double weights[DCTSIZE2];
+    for (int k = 0; k < DCTSIZE2; k++) {
+        double u = (k % DCTSIZE) * pi / energy.block_width;
+        double v = (k / DCTSIZE) * pi / energy.block_height;
+        double q = luma->quant_table->quantval[k];
+        weights[k] = q * q * (u * u + v * v);
+    }
+
+    for (int by = 0; by < energy.blocks_y; by++) {
+        JBLOCKARRAY rows = (*cinfo.mem->access_virt_barray)(
+            reinterpret_cast<j_common_ptr>(&cinfo), coefficients[0], static_cast<JDIMENSION>(by), 1, FALSE);
+        float* out = energy.values.data() + static_cast<size_t>(by) * energy.blocks_x;
+        for (int bx = 0; bx < energy.blocks_x; bx++) {
+            const JCOEF* block = rows[0][bx];
+            double sum = 0.0;
+            for (int k = 1; k < DCTSIZE2; k++) {
+                sum += block[k] * block[k] * weights[k];
+            }
+            // Sobel gain 8 times the RMS gradient sqrt(sum / 64)
+            out[bx] = static_cast<float>(std::sqrt(sum));
+        }
+    }
+
+    jpeg_finish_decompress(&cinfo);
+    jpeg_destroy_decompress(&cinfo);
+    std::fclose(file);
+
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::high_resolution_clock::now() - start_time);
+    spdlog::info("Read DCT block energy of {}: {}x{} blocks of {}x{} px in {}ms", path, energy.blocks_x,
+                 energy.blocks_y, energy.block_width, energy.block_height, elapsed.count());
+    return true;
+}
+
+void upsample_block_energy(const BlockEnergy& blocks, const SeamCarving::MatrixView<float>& energy) {
+    // Horizontal taps are shared by all rows
+    std::vector<int> left(energy.width);
+    std::vector<float> weight(energy.width);
+    for (int x = 0; x < energy.width; x++) {
+        float bx = std::max(0.0f, (x + 0.5f) / blocks.block_width - 0.5f);
+        left[x] = std::min(static_cast<int>(bx), blocks.blocks_x - 1);
+        weight[x] = std::min(bx - left[x], 1.0f);
+    }
+
+    for (int y = 0; y < energy.height; y++) {
+        float by = std::max(0.0f, (y + 0.5f) / blocks.block_height - 0.5f);
+        int top = std::min(static_cast<int>(by), blocks.blocks_y - 1);
+        int bottom = std::min(top + 1, blocks.blocks_y - 1);
+        float dy = std::min(by - top, 1.0f);
+        const float* row0 = blocks.values.data() + static_cast<size_t>(top) * blocks.blocks_x;
+        const float* row1 = blocks.values.data() + static_cast<size_t>(bottom) * blocks.blocks_x;
+        float* out = energy.row(y);
+        for (int x = 0; x < energy.width; x++) {
+            int x0 = left[x];
+            int x1 = std::min(x0 + 1, blocks.blocks_x - 1);
+            float dx = weight[x];
+            float upper = row0[x0] * (1 - dx) + row0[x1] * dx;
+            float lower = row1[x0] * (1 - dx) + row1[x1] * dx;
+            out[x] = upper * (1 - dy) + lower * dy;
+        }
+    }
+}
+
+bool carve_streaming(const std::string& input, const std::string& output, float scale_percent, int quality) {
+    FILE* source = std::fopen(input.c_str(), "rb");
+    if (!source) {
+        spdlog::error("Failed to open JPEG: {}", input);
+        return false;
+    }
+    FILE* destination = std::fopen(output.c_str(), "wb");
+    if (!destination) {
+        spdlog::error("Failed to create {}", output);
+        std::fclose(source);
+        return false;
+    }
+    auto start_time = std::chrono::high_resolution_clock::now();
+
+    // Everything with a destructor lives outside the setjmp scope; both
+    // codecs report to the same error manager
+    jpeg_decompress_struct decoder;
+    jpeg_compress_struct encoder;
+    ErrorManager errors;
+    decoder.err = jpeg_std_error(&errors.base);
+    encoder.err = &errors.base;
+    errors.base.error_exit = error_exit;
+    std::vector<unsigned char> row;
+    std::optional<SeamCarving::StreamingCarver> carver;
+    volatile bool encoder_created = false;
+
+    if (setjmp(errors.jump)) {
+        jpeg_destroy_decompress(&decoder);
+        if (encoder_created) {
+            jpeg_destroy_compress(&encoder);
+        }
+        std::fclose(source);
+        std::fclose(destination);
+        std::remove(output.c_str());
+        return false;
+    }
+
+    jpeg_create_decompress(&decoder);
+    jpeg_stdio_src(&decoder, source);
+    jpeg_read_header(&decoder, TRUE);
+    decoder.out_color_space = JCS_RGB;
+    jpeg_start_decompress(&decoder);
+    int width = static_cast<int>(decoder.output_width);
+    int height = static_cast<int>(decoder.output_height);
+    int target_width = std::max(1, static_cast<int>(width * scale_percent / 100.0f));
+
+    jpeg_create_compress(&encoder);
+    encoder_created = true;
+    jpeg_stdio_dest(&encoder, destination);
+    encoder.image_width = static_cast<JDIMENSION>(target_width);
+    encoder.image_height = static_cast<JDIMENSION>(height);
+    encoder.input_components = 3;
+    encoder.in_color_space = JCS_RGB;
+    jpeg_set_defaults(&encoder);
+    jpeg_set_quality(&encoder, std::min(100, std::max(1, quality)), TRUE);
+    jpeg_start_compress(&encoder, TRUE);
+
+    // Each finished row is compressed right away and then forgotten
+    carver.emplace(width, height, 3, width - target_width, [&encoder](int, const unsigned char* carved) {
+        JSAMPROW out = const_cast<JSAMPROW>(carved);
+        jpeg_write_scanlines(&encoder, &out, 1);
+    });
+    row.resize(static_cast<size_t>(width) * 3);
+    while (decoder.output_scanline < decoder.output_height) {
+        JSAMPROW in = row.data();
+        jpeg_read_scanlines(&decoder, &in, 1);
+        carver->push_row(row.data());
+    }
+
+    jpeg_finish_compress(&encoder);
+    jpeg_destroy_compress(&encoder);
+    jpeg_finish_decompress(&decoder);
+    jpeg_destroy_decompress(&decoder);
+    std::fclose(source);
+    bool written = std::fclose(destination) == 0;
+    if (!written) {
+        spdlog::error("Failed to write {}", output);
+        std::remove(output.c_str());
+        return false;
+    }
+
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::high_resolution_clock::now() - start_time);
+    spdlog::info("Stream-carved {}: {}x{} -> {}x{} in {}ms, {:.1f} MB carver memory", input, width, height,
+                 target_width, height, elapsed.count(),
+                 SeamCarving::StreamingCarver::footprint(width, 3, width - target_width) / 1048576.0);
+    return true;
+}
+
+} // namespace Jpeg
@@ -0,0 +1,118 @@
+#pragma once
+
+#include "seam_carving.h"
+
+#include <string>
+#include <vector>
+
+/**
+ * @brief libjpeg(-turbo) helpers that go beyond what stb_image offers
+ */
+namespace Jpeg {
+
+    /**
+     * Check the file signature for a JPEG stream.
+     *
+     * @param path Image file path
+     * @return True if the file starts with a JPEG SOI marker
+     */
+    bool is_jpeg(const std::string& path);
+
+    /**
+     * Decode a reduced-size RGB preview using DCT-domain scaling.
+     *
+     * libjpeg can reconstruct 1/2, 1/4 or 1/8 scale output straight from the
+     * DCT coefficients, skipping most of the IDCT and upsampling work. The
+     * largest reduction that keeps the preview at least min_size pixels wide
+     * (or the smallest available scale) is used.
+     *
+     * @param path JPEG file path
+     * @param min_size Minimum preview width in pixels
+     * @param pixels Output RGB pixels of the preview
+     * @param width Output preview width
+     * @param height Output preview height
+     * @param full_width Output width of the full resolution image
+     * @param full_height Output height of the full resolution image
+     * @return True on success
+     */
+    bool decode_scaled(
+        const std::string& path,
+        int min_size,
+        std::vector<unsigned char>& pixels,
+        int& width,
+        int& height,
+        int& full_width,
+        int& full_height
+    );
+
+    /**
+     * Decode a JPEG at full resolution into caller-owned memory.
+     *
+     * Scanlines go from jpeg_read_scanlines() straight into `pixels` (packed
+     * RGB rows), so the image never passes through an intermediate buffer.
+     * The size is known from the header, before any pixel is decoded.
+     *
+     * @param path JPEG file path
+     * @param pixels Output RGB pixels
+     * @param capacity Bytes available at pixels
+     * @param width Output image width (set even when the image does not fit)
+     * @param height Output image height (set even when the image does not fit)
+     * @return True on success; false when decoding failed or width * height * 3 exceeds capacity
+     */
+    bool decode_into(const std::string& path, unsigned char* pixels, size_t capacity, int& width, int& height);
+
+    /**
+     * @brief Gradient energy of every luma DCT block of a JPEG
+     */
+    struct BlockEnergy {
+        std::vector<float> values;  ///< blocks_x * blocks_y, row-major
+        int blocks_x = 0;
+        int blocks_y = 0;
+        int block_width = 8;        ///< Image pixels covered by one block
+        int block_height = 8;
+        int image_width = 0;
+        int image_height = 0;
+
+        SeamCarving::MatrixView<const float> view() const { return {values.data(), blocks_x, blocks_y, blocks_x}; }
+    };
+
+    /**
+     * Estimate per-block energy from the DCT coefficients, without decoding pixels.
+     *
+     * Only entropy decoding runs (no IDCT, upsampling or colour conversion).
+     * The JPEG DCT is orthonormal, so by Parseval the mean squared gradient of
+     * a luma block is sum F(u,v)^2 * (pi/8)^2 * (u^2 + v^2) / 64 over the
+     * dequantized AC coefficients; its root, times the gain of the Sobel
+     * kernels (8), is on the scale of SeamCarving::calculate_energy().
+     *
+     * @param path JPEG file path
+     * @param energy Output block energy
+     * @return True on success
+     */
+    bool read_block_energy(const std::string& path, BlockEnergy& energy);
+
+    /**
+     * Bilinearly upsample block energy to pixel resolution (block centres as samples).
+     *
+     * @param blocks Block energy from read_block_energy()
+     * @param energy Output matrix of the image size
+     */
+    void upsample_block_energy(const BlockEnergy& blocks, const SeamCarving::MatrixView<float>& energy);
+
+    /**
+     * Carve a JPEG with greedy seams while it decodes, writing a JPEG.
+     *
+     * Scanlines go from jpeg_read_scanlines() through a
+     * SeamCarving::StreamingCarver straight into jpeg_write_scanlines(), so
+     * neither image is ever held in memory: peak memory depends on the width
+     * and the seam count only, and arbitrarily tall images carve in one pass.
+     *
+     * @param input JPEG file path
+     * @param output Path of the carved JPEG (removed again on failure)
+     * @param scale_percent Output width in percent of the input width
+     * @param quality JPEG quality of the output (1-100)
+     * @return True on success
+     */
+    bool carve_streaming(const std::string& input, const std::string& output, float scale_percent, int quality = 90);
+
+} // namespace Jpeg
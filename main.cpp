@@ -8,112 +8,69 @@
 #include <GLFW/glfw3.h> // Will drag system OpenGL headers
 #include <fmt/format.h>
 
-#define STB_IMAGE_IMPLEMENTATION
-#include <stb_image.h>
-
-#include "seam_carving.h"
-
+#include "cost_model.h"
+#include "display_texture.h"
+#include "job_pool.h"
+#include "memory_governor.h"
+#include "metrics.h"
+#include "upload_thread.h"
+#include "workspace.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
 #include <string>
 #include <vector>
-#include <cmath>
 
 static void glfw_error_callback(int error, const char *description) {
   fprintf(stderr, "Glfw Error %d: %s\n", error, description);
 }
 
-// load image
-unsigned char *load_image(const std::string &path, int &width, int &height,
-                          int &channels) {
-  unsigned char *pixels =
-      stbi_load(path.c_str(), &width, &height, &channels, STBI_rgb);
-  if (!pixels) {
-    spdlog::error("Failed to load image: {}", path.c_str());
-  }
-  return pixels;
-}
+// ----- Idle throttling -----
+// The main loop only renders while something changed: GLFW input callbacks and
+// finished background jobs set this flag, everything else sleeps in
+// glfwWaitEventsTimeout.
+static std::atomic<bool> g_needs_redraw{true};
 
-// Helper function to create/update OpenGL texture
-bool create_or_update_texture(GLuint& texture_id, const void* data, int width, int height, const std::string& description) {
-  if (texture_id == 0) {
-    glGenTextures(1, &texture_id);
-    if (glGetError() != GL_NO_ERROR) {
-      spdlog::error("Failed to generate texture for {}", description);
-      return false;
-    }
-  }
-  
-  glBindTexture(GL_TEXTURE_2D, texture_id);
-  if (glGetError() != GL_NO_ERROR) {
-    spdlog::error("Failed to bind texture for {}", description);
-    return false;
-  }
-  
-  // Set pixel alignment
-  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
-  
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-  
-  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, 
-               GL_UNSIGNED_BYTE, data);
-  
-  GLenum error = glGetError();
-  if (error != GL_NO_ERROR) {
-    spdlog::error("Failed to upload texture data for {}: OpenGL error {}", description, error);
-    stbi_image_free(data);
-    return false;
-  }
-  
-  spdlog::info("Successfully created/updated OpenGL texture for {}: {}x{}", description, width, height);
-  return true;
-}
+// ImGui needs a few frames after an event to settle hover/active state.
+static constexpr int kSettleFrames = 3;
+// Upper bound on how long the loop sleeps without any event (safety net).
+static constexpr double kIdleWaitTimeoutSec = 1.0;
 
-// Bilinear interpolation downscaling function
-unsigned char* downscale_image_bilinear(const unsigned char* src_data, 
-                                       int src_width, int src_height, int channels,
-                                       int dst_width, int dst_height) {
-  unsigned char* dst_data = new unsigned char[dst_width * dst_height * channels];
-  
-  float x_ratio = (float)src_width / dst_width;
-  float y_ratio = (float)src_height / dst_height;
-  
-  for (int y = 0; y < dst_height; y++) {
-    for (int x = 0; x < dst_width; x++) {
-      float src_x = x * x_ratio;
-      float src_y = y * y_ratio;
-      
-      int x1 = (int)src_x;
-      int y1 = (int)src_y;
-      int x2 = std::min(x1 + 1, src_width - 1);
-      int y2 = std::min(y1 + 1, src_height - 1);
-      
-      float dx = src_x - x1;
-      float dy = src_y - y1;
-      
-      for (int c = 0; c < channels; c++) {
-        // Get the four surrounding pixels
-        float p11 = src_data[(y1 * src_width + x1) * channels + c];
-        float p12 = src_data[(y1 * src_width + x2) * channels + c];
-        float p21 = src_data[(y2 * src_width + x1) * channels + c];
-        float p22 = src_data[(y2 * src_width + x2) * channels + c];
-        
-        // Bilinear interpolation
-        float interpolated = p11 * (1 - dx) * (1 - dy) +
-                           p12 * dx * (1 - dy) +
-                           p21 * (1 - dx) * dy +
-                           p22 * dx * dy;
-        
-        dst_data[(y * dst_width + x) * channels + c] = (unsigned char)std::round(interpolated);
-      }
-    }
-  }
-  
-  return dst_data;
-}
+// Engine metrics are merged at most this often, for the Settings overlay and,
+// when FLINK_METRICS_FILE is set, for the Prometheus text file written there.
+static constexpr double kMetricsRefreshSec = 1.0;
 
+static void mark_dirty() { g_needs_redraw.store(true, std::memory_order_relaxed); }
 
+// Called from worker threads: flag the UI dirty and wake the main loop.
+static void wake_main_loop() {
+  mark_dirty();
+  glfwPostEmptyEvent();
+}
+
+static void on_mouse_button(GLFWwindow *, int, int, int) { mark_dirty(); }
+static void on_cursor_pos(GLFWwindow *, double, double) { mark_dirty(); }
+static void on_scroll(GLFWwindow *, double, double) { mark_dirty(); }
+static void on_key(GLFWwindow *, int, int, int, int) { mark_dirty(); }
+static void on_char(GLFWwindow *, unsigned int) { mark_dirty(); }
+static void on_window_focus(GLFWwindow *, int) { mark_dirty(); }
+static void on_cursor_enter(GLFWwindow *, int) { mark_dirty(); }
+static void on_window_refresh(GLFWwindow *) { mark_dirty(); }
+static void on_framebuffer_size(GLFWwindow *, int, int) { mark_dirty(); }
+
+// Must run before ImGui_ImplGlfw_InitForOpenGL so the backend chains to these.
+static void install_dirty_callbacks(GLFWwindow *window) {
+  glfwSetMouseButtonCallback(window, on_mouse_button);
+  glfwSetCursorPosCallback(window, on_cursor_pos);
+  glfwSetScrollCallback(window, on_scroll);
+  glfwSetKeyCallback(window, on_key);
+  glfwSetCharCallback(window, on_char);
+  glfwSetWindowFocusCallback(window, on_window_focus);
+  glfwSetCursorEnterCallback(window, on_cursor_enter);
+  glfwSetWindowRefreshCallback(window, on_window_refresh);
+  glfwSetFramebufferSizeCallback(window, on_framebuffer_size);
+}
 
 int main(int, char **) {
   // Setup spdlog for optimized logging
@@ -121,6 +78,9 @@ int main(int, char **) {
   spdlog::set_pattern("[%H:%M:%S] [%l] %v");  // Show timestamp and level
   spdlog::info("Application starting...");
 
+  // Calibrate the carving cost model now rather than inside the first job
+  SeamCarving::CostModel::host();
+
   // Setup window
   glfwSetErrorCallback(glfw_error_callback);
   if (!glfwInit())
@@ -156,6 +116,7 @@ int main(int, char **) {
     return 1;
   glfwMakeContextCurrent(window);
   glfwSwapInterval(1); // Enable vsync
+  install_dirty_callbacks(window);
 
   // Setup Dear ImGui context
   IMGUI_CHECKVERSION();
@@ -183,16 +144,63 @@ int main(int, char **) {
     return -1;
   }
   ImGui_ImplGlfw_InitForOpenGL(window, true);
+  // Viewport windows created by the backend should wake the loop as well
+  ImGui_ImplGlfw_SetCallbacksChainForAllWindows(true);
   ImGui_ImplOpenGL3_Init(glsl_version);
+  // Carved views warp the original on the GPU when the context supports it
+  Display::init_warp_shader(glsl_version);
+  // Result textures upload on a second, shared context so large swaps don't
+  // stall frames; FLINK_UPLOAD_THREAD=0 keeps them on the render thread (to
+  // compare frame p99s, e.g. under llvmpipe with LIBGL_ALWAYS_SOFTWARE=1)
+  const char *upload_thread_env = std::getenv("FLINK_UPLOAD_THREAD");
+  if (!(upload_thread_env && std::string(upload_thread_env) == "0")) {
+    Display::start_upload_thread(window, wake_main_loop);
+  }
 
   // Our state
   static bool show_demo_window = false;
 
+  // Open images; all carving shares one priority-aware worker pool
+  Jobs::JobPool job_pool;
+  Workspace workspace(job_pool, wake_main_loop);
+  workspace.open(ASSET_PATH "/schmetterling_mid.jpg");
+  static char open_path[512] = ASSET_PATH "/schmetterling_huge.jpg";
+
   ImVec4 clear_color = ImVec4(0.168f, 0.394f, 0.534f, 1.00f);
 
+  // Frames left to render before the loop may go back to sleep
+  int frames_to_render = kSettleFrames;
+
+  static Metrics::Snapshot metrics;
+  double metrics_time = -kMetricsRefreshSec;
+  const char *metrics_file = std::getenv("FLINK_METRICS_FILE");
+
   // Main loop
   while (!glfwWindowShouldClose(window)) {
-    glfwPollEvents();
+    // Sleep until input arrives or a worker posts an empty event; only poll
+    // while ImGui still needs frames to settle.
+    if (frames_to_render > 0) {
+      glfwPollEvents();
+    } else {
+      glfwWaitEventsTimeout(kIdleWaitTimeoutSec);
+    }
+    if (g_needs_redraw.exchange(false)) {
+      frames_to_render = kSettleFrames;
+    }
+    // Also runs on idle wake-ups, so the metrics file stays fresh while nothing is drawn
+    if (glfwGetTime() - metrics_time >= kMetricsRefreshSec) {
+      metrics = Metrics::snapshot();
+      metrics_time = glfwGetTime();
+      if (metrics_file && !Metrics::write_text_file(metrics, metrics_file)) {
+        spdlog::warn("Failed to write metrics to {}", metrics_file);
+        metrics_file = nullptr;
+      }
+    }
+    if (frames_to_render == 0) {
+      continue; // woke up on timeout with nothing to redraw
+    }
+    frames_to_render--;
+    auto frame_start = std::chrono::steady_clock::now();
 
     // Start the Dear ImGui frame
     ImGui_ImplOpenGL3_NewFrame();
@@ -224,144 +232,49 @@ int main(int, char **) {
 
       ImGui::Text("Application average %.3f ms/frame (%.1f FPS)",
                   1000.0f / ImGui::GetIO().Framerate, ImGui::GetIO().Framerate);
-      ImGui::End();
-    }
-
-    // 3. Show image window
-    {
-      ImGui::Begin("Image Window");
-      // ----- START HERE -----
-      const std::string img_path = ASSET_PATH "/schmetterling_mid.jpg";
-
-      // 1. load image
-      static unsigned char* image_data = nullptr;
-      static int img_w = 0, img_h = 0, img_channels = 0;
-      static GLuint original_texture_id = 0;
-      static bool image_loaded = false;
-      static float target_scale_perc = 100.0f;  // Scale percentage (10-100%)
-      static SeamCarving::Algorithm selected_algorithm = SeamCarving::Algorithm::GREEDY;
-
-      // 2. upload image to gpu
-      if (!image_loaded) {
-        image_data = load_image(img_path, img_w, img_h, img_channels);
-        if (image_data) {
-          spdlog::info("Image loaded successfully: {}x{}x{}", img_w, img_h, img_channels);
-          
-          // Create OpenGL texture using helper function
-          if (create_or_update_texture(original_texture_id, image_data, img_w, img_h, "original image")) {
-            image_loaded = true;
-          } else {
-            return 1;
-          }
-        } else {
-          spdlog::error("Failed to load image: {}", img_path);
-          return 1;
-        }
-      }
 
-      // 3. display image
-      // (https://github.com/ocornut/imgui/wiki/Image-Loading-and-Displaying-Examples)
-      ImGui::Text("Original");
-      if (image_loaded && original_texture_id) {
-        ImGui::Image((ImTextureID)(intptr_t)original_texture_id, ImVec2(img_w, img_h));
-      } else {
-        ImGui::Text("Failed to load image");
-      }
-
-      // 4. add a simple imgui slider here to scale image from 0 to 100%
-      bool needs_recompute = false;
-      if (ImGui::SliderFloat("Scale Image By", &target_scale_perc, 10.0f, 100.0f,"%.0f%%")) {
-        needs_recompute = true;
-      }
-      
-      // Algorithm selection radio buttons
-      ImGui::Text("Seam Finding Algorithm:");
-      bool algo_changed = false;
-      if (ImGui::RadioButton("Greedy (Fast)", selected_algorithm == SeamCarving::Algorithm::GREEDY)) {
-        selected_algorithm = SeamCarving::Algorithm::GREEDY;
-        algo_changed = true;
+      // Open more images; each gets its own window, slider and carver
+      ImGui::InputText("Image path", open_path, sizeof(open_path));
+      if (ImGui::Button("Open")) {
+        workspace.open(open_path);
       }
-      ImGui::SameLine();
-      if (ImGui::RadioButton("Dynamic Programming (Optimal)", selected_algorithm == SeamCarving::Algorithm::DYNAMIC)) {
-        selected_algorithm = SeamCarving::Algorithm::DYNAMIC;
-        algo_changed = true;
+      ImGui::Text("%zu image(s) open, %d worker slot(s)", workspace.size(), job_pool.slots());
+      // Dynamic programming in 16-bit levels: twice the SIMD lanes, half the
+      // memory, seams within a fraction of a percent of the optimal cost
+      bool quantized_dp = workspace.quantized_dp();
+      if (ImGui::Checkbox("16-bit DP seam search (faster, near-optimal)", &quantized_dp)) {
+        workspace.set_quantized_dp(quantized_dp);
       }
-      
-      if (algo_changed) {
-        needs_recompute = true;
+      const Memory::MemoryGovernor &governor = Memory::MemoryGovernor::instance();
+      if (governor.budget() > 0) {
+        ImGui::Text("Engine memory %.0f / %.0f MB, %d job(s) waiting", governor.reserved() / 1048576.0,
+                    governor.budget() / 1048576.0, governor.waiting());
       }
-      
-      // Calculate target width based on slider value
-      int target_width = (int)(img_w * target_scale_perc / 100.0f);
-      
-      // Static variables for processed image
-      static std::vector<unsigned char> carved_image_data;
-      static GLuint carved_texture_id = 0;
-      static int carved_width = 0;
-      static bool carved_image_valid = false;
-        
-      // Static variables for primitive resized image
-      static unsigned char* primitive_resized_data = nullptr;
-      static GLuint primitive_texture_id = 0;
-      static bool primitive_image_valid = false;
-      
-      if (needs_recompute && image_loaded) {
-        // Use iterative seam removal to reduce image width
-        const char* algo_name = (selected_algorithm == SeamCarving::Algorithm::GREEDY) ? "Greedy" : "Dynamic Programming";
-        spdlog::info("Starting iterative seam carving: {}x{} -> {}x{} using {} algorithm", 
-                     img_w, img_h, target_width, img_h, algo_name);
-        
-        // Perform iterative seam removal
-        auto result = SeamCarving::reduce_width_iteratively(
-            image_data, img_w, img_h, img_channels, target_width, selected_algorithm);
-        auto result_pixels = result.first;
-        auto final_width = result.second;
-        
-        spdlog::info("Seam carving completed: final size {}x{}", final_width, img_h);
-        
-        // Store the result
-        carved_image_data = std::move(result_pixels);
-        carved_width = final_width;
-        
-        // Create/update OpenGL texture for carved image
-        carved_image_valid = create_or_update_texture(carved_texture_id, carved_image_data.data(), carved_width, img_h, "carved image");
-      
-        // Create primitive resized image using bilinear interpolation
-        spdlog::info("Creating primitive resized image using bilinear interpolation: {}x{} -> {}x{}", 
-                     img_w, img_h, target_width, img_h);
-        
-        // Clean up previous primitive resized data
-        if (primitive_resized_data) {
-          delete[] primitive_resized_data;
+      // Tail latencies of everything carved so far, in ms
+      for (int i = 0; i < Metrics::kLatencyCount; i++) {
+        const Metrics::Histogram &latency = metrics.latency[i];
+        if (latency.count() > 0) {
+          ImGui::Text("%-12s p50 %8.2f  p99 %8.2f  p999 %8.2f ms", Metrics::name(static_cast<Metrics::Latency>(i)),
+                      latency.percentile(50.0) / 1e6, latency.percentile(99.0) / 1e6,
+                      latency.percentile(99.9) / 1e6);
         }
-        
-        // Create resized pixel array using bilinear interpolation (horizontal scaling only)
-        primitive_resized_data = downscale_image_bilinear(
-            image_data, img_w, img_h, img_channels, target_width, img_h);
-        
-        // Create/update OpenGL texture for primitive resized image
-        primitive_image_valid = create_or_update_texture(primitive_texture_id, primitive_resized_data, target_width, img_h, "primitive resized image");
       }
-
-      ImGui::Text("Processed (Seam Carved)");
-      if (carved_image_valid && carved_texture_id) {
-        ImGui::Image((ImTextureID)(intptr_t)carved_texture_id, ImVec2(carved_width, img_h));
-        ImGui::Text("Carved image size: %dx%d (removed %d seams)", carved_width, img_h, img_w - carved_width);
-      } else {
-        ImGui::Text("Move the slider to see seam carved result");
+      if (metrics[Metrics::Counter::JOBS] > 0) {
+        ImGui::Text("%llu job(s), %llu seams removed", static_cast<unsigned long long>(metrics[Metrics::Counter::JOBS]),
+                    static_cast<unsigned long long>(metrics[Metrics::Counter::SEAMS]));
       }
-
-      ImGui::Text("Primitive Resized");
-      if (primitive_image_valid && primitive_texture_id) {
-        ImGui::Image((ImTextureID)(intptr_t)primitive_texture_id, ImVec2(target_width, img_h));
-        ImGui::Text("Primitive resized image size: %dx%d (bilinear interpolation)", target_width, img_h);
+      if (Display::UploadThread *uploader = Display::upload_thread()) {
+        ImGui::Text("Upload thread: %zu tile(s) in flight, %.1f MB uploaded", uploader->in_flight(),
+                    uploader->uploaded_bytes() / 1048576.0);
       } else {
-        ImGui::Text("Move the slider to see primitive resized result");
+        ImGui::Text("Textures upload on the render thread");
       }
-
       ImGui::End();
     }
 
+    // 3. Show one window per open image
+    workspace.draw();
+
     // Rendering
     ImGui::Render();
     int display_w, display_h;
@@ -384,10 +297,15 @@ int main(int, char **) {
       glfwMakeContextCurrent(backup_current_context);
     }
 
+    Metrics::record(Metrics::Latency::FRAME, std::chrono::steady_clock::now() - frame_start);
     glfwSwapBuffers(window);
   }
 
   // Cleanup
+  workspace.clear();
+  job_pool.shutdown();
+  Display::stop_upload_thread();
+  Display::shutdown_warp_shader();
   ImGui_ImplOpenGL3_Shutdown();
   ImGui_ImplGlfw_Shutdown();
   ImGui::DestroyContext();
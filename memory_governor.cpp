@@ -0,0 +1,184 @@
+#include "memory_governor.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <spdlog/spdlog.h>
+
+namespace Memory {
+
+namespace {
+
+    constexpr double kMegabyte = 1024.0 * 1024.0;
+
+    // Queued jobs poll keep_waiting this often
+    constexpr auto kWaitPoll = std::chrono::milliseconds(50);
+
+    std::size_t budget_from_environment() {
+        if (const char* value = std::getenv("FLINK_MEMORY_BUDGET_MB")) {
+            return static_cast<std::size_t>(std::strtoull(value, nullptr, 10)) * 1024 * 1024;
+        }
+        // cgroup v2 limit of this container ("max" when unlimited); the rest
+        // of the process (decoded images, textures) gets the last quarter
+        std::ifstream limit("/sys/fs/cgroup/memory.max");
+        std::string text;
+        if (limit >> text && text != "max") {
+            return static_cast<std::size_t>(std::strtoull(text.c_str(), nullptr, 10)) / 4 * 3;
+        }
+        return 0;
+    }
+
+} // namespace
+
+MemoryGovernor::Reservation::~Reservation() {
+    release();
+}
+
+MemoryGovernor::Reservation::Reservation(Reservation&& other) noexcept
+    : governor_(other.governor_), options_(std::move(other.options_)), level_(other.level_) {
+    other.governor_ = nullptr;
+}
+
+MemoryGovernor::Reservation& MemoryGovernor::Reservation::operator=(Reservation&& other) noexcept {
+    if (this != &other) {
+        release();
+        governor_ = other.governor_;
+        options_ = std::move(other.options_);
+        level_ = other.level_;
+        other.governor_ = nullptr;
+    }
+    return *this;
+}
+
+bool MemoryGovernor::Reservation::pressured() const {
+    if (!governor_ || level_ + 1 >= static_cast<int>(options_.size())) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(governor_->mutex_);
+    return governor_->pressure_;
+}
+
+bool MemoryGovernor::Reservation::degrade() {
+    if (!governor_ || level_ + 1 >= static_cast<int>(options_.size())) {
+        return false;
+    }
+    std::size_t before = options_[level_];
+    level_++;
+    if (options_[level_] < before) {
+        governor_->give_back(before - options_[level_]);
+    }
+    spdlog::info("Memory pressure: job degraded to mode {} ({:.0f} MB)", level_, options_[level_] / kMegabyte);
+    return true;
+}
+
+void MemoryGovernor::Reservation::release() {
+    if (governor_) {
+        governor_->give_back(options_[level_]);
+        governor_ = nullptr;
+    }
+}
+
+MemoryGovernor& MemoryGovernor::instance() {
+    static MemoryGovernor governor(budget_from_environment());
+    return governor;
+}
+
+MemoryGovernor::MemoryGovernor(std::size_t budget) : budget_(budget) {
+    if (budget_ > 0) {
+        spdlog::info("Memory governor budget: {:.0f} MB", budget_ / kMegabyte);
+    }
+}
+
+void MemoryGovernor::set_budget(std::size_t bytes) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    budget_ = bytes;
+    cv_.notify_all();
+}
+
+std::size_t MemoryGovernor::budget() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return budget_;
+}
+
+std::size_t MemoryGovernor::reserved() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return reserved_;
+}
+
+int MemoryGovernor::waiting() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return static_cast<int>(queue_.size());
+}
+
+bool MemoryGovernor::fits(std::size_t bytes) const {
+    return budget_ == 0 || (reserved_ <= budget_ && bytes <= budget_ - reserved_);
+}
+
+void MemoryGovernor::give_back(std::size_t bytes) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    reserved_ -= std::min(bytes, reserved_);
+    cv_.notify_all();
+}
+
+MemoryGovernor::Reservation MemoryGovernor::reserve(std::vector<std::size_t> options,
+                                                    const std::function<bool()>& keep_waiting) {
+    Reservation reservation;
+    if (options.empty()) {
+        return reservation;
+    }
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    std::uint64_t ticket = next_ticket_++;
+    queue_.push_back(ticket);
+    bool logged = false;
+    while (true) {
+        if (queue_.front() == ticket) {
+            auto option = std::find_if(options.begin(), options.end(), [this](std::size_t bytes) { return fits(bytes); });
+            if (option == options.end() && reserved_ == 0) {
+                spdlog::warn("Job needs {:.0f} MB, more than the {:.0f} MB budget; running it alone",
+                             options.back() / kMegabyte, budget_ / kMegabyte);
+                option = options.end() - 1;
+            }
+            if (option != options.end()) {
+                reservation.level_ = static_cast<int>(option - options.begin());
+                reserved_ += *option;
+                queue_.pop_front();
+                pressure_ = false;
+                cv_.notify_all();
+                if (reservation.level_ > 0 || logged) {
+                    spdlog::info("Reserved {:.0f} MB in mode {} ({:.0f}/{:.0f} MB in use)", *option / kMegabyte,
+                                 reservation.level_, reserved_ / kMegabyte, budget_ / kMegabyte);
+                }
+                reservation.governor_ = this;
+                reservation.options_ = std::move(options);
+                return reservation;
+            }
+            // Running jobs can make room by switching to smaller modes
+            pressure_ = true;
+        }
+        if (!logged) {
+            spdlog::info("Queued for {:.0f} MB of memory ({:.0f}/{:.0f} MB in use)", options.back() / kMegabyte,
+                         reserved_ / kMegabyte, budget_ / kMegabyte);
+            logged = true;
+        }
+
+        if (keep_waiting) {
+            lock.unlock();
+            bool keep = keep_waiting();
+            lock.lock();
+            if (!keep) {
+                if (queue_.front() == ticket) {
+                    pressure_ = false;
+                }
+                queue_.erase(std::find(queue_.begin(), queue_.end(), ticket));
+                cv_.notify_all();
+                return reservation;
+            }
+        }
+        cv_.wait_for(lock, kWaitPoll);
+    }
+}
+
+} // namespace Memory
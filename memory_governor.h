@@ -0,0 +1,119 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+namespace Memory {
+
+    /**
+     * @brief Process-wide budget for the working memory of carving jobs
+     *
+     * A job reserves its footprint before allocating. It lists the footprints
+     * of the modes it can run in, fastest first (e.g. the DP storage modes of
+     * SeamCarving::DpMemory), and gets the first one that fits next to the
+     * reservations already granted. When none fits the job queues, first come
+     * first served, until enough memory is released; meanwhile running jobs
+     * see pressured() and can switch to a smaller mode between seams. A job
+     * that does not fit even alone is granted its smallest mode once nothing
+     * else is reserved, so it runs by itself instead of waiting forever.
+     *
+     * The budget only covers what jobs reserve; it is a limit on concurrent
+     * engine scratch memory, not on the whole process.
+     */
+    class MemoryGovernor {
+    public:
+        /**
+         * @brief Granted share of the budget, returned on destruction
+         */
+        class Reservation {
+        public:
+            Reservation() = default;
+            ~Reservation();
+            Reservation(Reservation&& other) noexcept;
+            Reservation& operator=(Reservation&& other) noexcept;
+            Reservation(const Reservation&) = delete;
+            Reservation& operator=(const Reservation&) = delete;
+
+            /// False when the job gave up waiting (or after release())
+            bool valid() const { return governor_ != nullptr; }
+            /// Index of the granted option
+            int level() const { return level_; }
+            const std::vector<std::size_t>& options() const { return options_; }
+            std::size_t bytes() const { return valid() ? options_[level_] : 0; }
+
+            /// True while a queued job waits for memory and this one has a smaller option left
+            bool pressured() const;
+
+            /**
+             * Move to the next (smaller) option and give the difference back.
+             *
+             * Call it after the memory of the larger mode was freed.
+             *
+             * @return False when already at the smallest option
+             */
+            bool degrade();
+
+            /// Return the reserved bytes now
+            void release();
+
+        private:
+            friend class MemoryGovernor;
+
+            MemoryGovernor* governor_ = nullptr;
+            std::vector<std::size_t> options_;
+            int level_ = 0;
+        };
+
+        /**
+         * The governor shared by all jobs.
+         *
+         * Its budget comes from the FLINK_MEMORY_BUDGET_MB environment
+         * variable, or else three quarters of the cgroup memory limit
+         * (memory.max) when the process runs in a limited container; without
+         * either it is unlimited.
+         */
+        static MemoryGovernor& instance();
+
+        /// @param budget Bytes jobs may reserve together, 0 = unlimited
+        explicit MemoryGovernor(std::size_t budget = 0);
+        MemoryGovernor(const MemoryGovernor&) = delete;
+        MemoryGovernor& operator=(const MemoryGovernor&) = delete;
+
+        /// Change the budget; queued jobs are reconsidered, granted ones keep their share
+        void set_budget(std::size_t bytes);
+        std::size_t budget() const;
+        std::size_t reserved() const;
+        /// Jobs queued for memory
+        int waiting() const;
+
+        /**
+         * Reserve memory for a job.
+         *
+         * @param options Footprint of each mode the job can run in, fastest
+         *                (usually largest) first; must not be empty
+         * @param keep_waiting Polled while queued; returning false gives up
+         *                     (e.g. a cancelled job). Called without locks held.
+         * @return Reservation of the first option that fits, invalid when
+         *         keep_waiting gave up
+         */
+        Reservation reserve(std::vector<std::size_t> options, const std::function<bool()>& keep_waiting = nullptr);
+
+    private:
+        bool fits(std::size_t bytes) const;
+        void give_back(std::size_t bytes);
+
+        mutable std::mutex mutex_;
+        std::condition_variable cv_;
+        std::size_t budget_;
+        std::size_t reserved_ = 0;
+        std::deque<std::uint64_t> queue_;  ///< Tickets of queued jobs, oldest first
+        std::uint64_t next_ticket_ = 0;
+        bool pressure_ = false;            ///< The oldest queued job does not fit
+    };
+
+} // namespace Memory
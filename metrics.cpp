@@ -0,0 +1,298 @@
+#include "metrics.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <fmt/format.h>
+
+namespace Metrics {
+
+/**
+ * @brief Metrics written by one thread
+ *
+ * Only the owning thread writes, so an update is a relaxed load and store
+ * instead of a locked read-modify-write; snapshot() reads the same atomics
+ * from other threads.
+ */
+class ThreadRecorder {
+    /// Histogram fields written by the owning thread only
+    struct Counts {
+        std::array<std::atomic<std::uint64_t>, Histogram::kBucketCount> buckets{};
+        std::atomic<std::uint64_t> count{0};
+        std::atomic<std::uint64_t> sum{0};
+        std::atomic<std::uint64_t> max{0};
+    };
+
+public:
+    void record(int which, std::uint64_t value) {
+        Counts& histogram = latency_[which];
+        bump(histogram.buckets[Histogram::index_of(value)], 1);
+        bump(histogram.count, 1);
+        bump(histogram.sum, value);
+        if (value > histogram.max.load(std::memory_order_relaxed)) {
+            histogram.max.store(value, std::memory_order_relaxed);
+        }
+    }
+
+    void add(int which, std::uint64_t amount) {
+        bump(counters_[which], amount);
+    }
+
+    void merge_into(Snapshot& metrics) const {
+        for (int i = 0; i < kLatencyCount; i++) {
+            const Counts& from = latency_[i];
+            Histogram& to = metrics.latency[i];
+            for (int b = 0; b < Histogram::kBucketCount; b++) {
+                to.counts_[b] += from.buckets[b].load(std::memory_order_relaxed);
+            }
+            to.count_ += from.count.load(std::memory_order_relaxed);
+            to.sum_ += from.sum.load(std::memory_order_relaxed);
+            to.max_ = std::max(to.max_, from.max.load(std::memory_order_relaxed));
+        }
+        for (int i = 0; i < kCounterCount; i++) {
+            metrics.counters[i] += counters_[i].load(std::memory_order_relaxed);
+        }
+    }
+
+    void reset() {
+        for (Counts& histogram : latency_) {
+            for (std::atomic<std::uint64_t>& bucket : histogram.buckets) {
+                bucket.store(0, std::memory_order_relaxed);
+            }
+            histogram.count.store(0, std::memory_order_relaxed);
+            histogram.sum.store(0, std::memory_order_relaxed);
+            histogram.max.store(0, std::memory_order_relaxed);
+        }
+        for (std::atomic<std::uint64_t>& counter : counters_) {
+            counter.store(0, std::memory_order_relaxed);
+        }
+    }
+
+private:
+    static void bump(std::atomic<std::uint64_t>& value, std::uint64_t amount) {
+        value.store(value.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+    }
+
+    std::array<Counts, kLatencyCount> latency_;
+    std::array<std::atomic<std::uint64_t>, kCounterCount> counters_{};
+};
+
+namespace {
+
+    /// Recorders of live threads, plus what exited threads left behind
+    struct Registry {
+        std::mutex mutex;
+        std::vector<ThreadRecorder*> threads;
+        Snapshot retired;
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    };
+
+    // Never destroyed: threads may still exit after static destructors ran
+    Registry& registry() {
+        static Registry* instance = new Registry;
+        return *instance;
+    }
+
+    /// Registers this thread's recorder on first use and retires it on thread exit
+    struct ThreadHandle {
+        std::unique_ptr<ThreadRecorder> recorder = std::make_unique<ThreadRecorder>();
+
+        ThreadHandle() {
+            Registry& shared = registry();
+            std::lock_guard<std::mutex> lock(shared.mutex);
+            shared.threads.push_back(recorder.get());
+        }
+
+        ~ThreadHandle() {
+            Registry& shared = registry();
+            std::lock_guard<std::mutex> lock(shared.mutex);
+            recorder->merge_into(shared.retired);
+            shared.threads.erase(std::find(shared.threads.begin(), shared.threads.end(), recorder.get()));
+        }
+    };
+
+    ThreadRecorder& this_thread() {
+        thread_local ThreadHandle handle;
+        return *handle.recorder;
+    }
+
+    constexpr const char* kLatencyNames[kLatencyCount] = {
+        "job", "seam", "energy", "seam_search", "seam_removal", "upload", "frame"};
+    constexpr const char* kCounterNames[kCounterCount] = {"jobs", "seams", "pixels"};
+
+    std::string format_duration(std::uint64_t nanoseconds) {
+        if (nanoseconds >= 1000000000) {
+            return fmt::format("{:.2f}s", nanoseconds / 1e9);
+        }
+        if (nanoseconds >= 1000000) {
+            return fmt::format("{:.2f}ms", nanoseconds / 1e6);
+        }
+        return fmt::format("{:.1f}us", nanoseconds / 1e3);
+    }
+
+} // namespace
+
+int Histogram::index_of(std::uint64_t value) {
+    value = std::min(value, kMaxValue);
+    if (value < (std::uint64_t{1} << kSubBucketBits)) {
+        return static_cast<int>(value);
+    }
+    int magnitude = 63;
+    while (!(value >> magnitude)) {
+        magnitude--;
+    }
+    int shift = magnitude - (kSubBucketBits - 1);
+    return (shift << (kSubBucketBits - 1)) + static_cast<int>(value >> shift);
+}
+
+std::uint64_t Histogram::highest_equivalent(int index) {
+    constexpr int kHalf = 1 << (kSubBucketBits - 1);
+    if (index < 2 * kHalf) {
+        return static_cast<std::uint64_t>(index);
+    }
+    int shift = index / kHalf - 1;
+    std::uint64_t sub_bucket = static_cast<std::uint64_t>(index - shift * kHalf);
+    return ((sub_bucket + 1) << shift) - 1;
+}
+
+void Histogram::record(std::uint64_t value, std::uint64_t times) {
+    counts_[index_of(value)] += times;
+    count_ += times;
+    sum_ += value * times;
+    max_ = std::max(max_, value);
+}
+
+void Histogram::merge(const Histogram& other) {
+    for (int b = 0; b < kBucketCount; b++) {
+        counts_[b] += other.counts_[b];
+    }
+    count_ += other.count_;
+    sum_ += other.sum_;
+    max_ = std::max(max_, other.max_);
+}
+
+void Histogram::reset() {
+    *this = Histogram();
+}
+
+std::uint64_t Histogram::percentile(double percent) const {
+    if (count_ == 0) {
+        return 0;
+    }
+    double clamped = std::min(100.0, std::max(0.0, percent));
+    auto rank = std::max<std::uint64_t>(1, static_cast<std::uint64_t>(std::ceil(clamped / 100.0 * count_)));
+    std::uint64_t seen = 0;
+    for (int b = 0; b < kBucketCount; b++) {
+        seen += counts_[b];
+        if (seen >= rank) {
+            return std::min(highest_equivalent(b), max_);
+        }
+    }
+    return max_;
+}
+
+void Snapshot::merge(const Snapshot& other) {
+    for (int i = 0; i < kLatencyCount; i++) {
+        latency[i].merge(other.latency[i]);
+    }
+    for (int i = 0; i < kCounterCount; i++) {
+        counters[i] += other.counters[i];
+    }
+    seconds = std::max(seconds, other.seconds);
+}
+
+void record(Latency which, std::chrono::nanoseconds elapsed) {
+    this_thread().record(static_cast<int>(which), static_cast<std::uint64_t>(std::max<std::int64_t>(0, elapsed.count())));
+}
+
+void add(Counter which, std::uint64_t amount) {
+    this_thread().add(static_cast<int>(which), amount);
+}
+
+Snapshot snapshot() {
+    Registry& shared = registry();
+    std::lock_guard<std::mutex> lock(shared.mutex);
+    Snapshot metrics = shared.retired;
+    for (const ThreadRecorder* thread : shared.threads) {
+        thread->merge_into(metrics);
+    }
+    metrics.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - shared.start).count();
+    return metrics;
+}
+
+void reset() {
+    Registry& shared = registry();
+    std::lock_guard<std::mutex> lock(shared.mutex);
+    shared.retired = Snapshot();
+    for (ThreadRecorder* thread : shared.threads) {
+        thread->reset();
+    }
+    shared.start = std::chrono::steady_clock::now();
+}
+
+const char* name(Latency which) {
+    return kLatencyNames[static_cast<int>(which)];
+}
+
+const char* name(Counter which) {
+    return kCounterNames[static_cast<int>(which)];
+}
+
+std::string summary(const Snapshot& metrics) {
+    std::string text;
+    for (int i = 0; i < kLatencyCount; i++) {
+        const Histogram& histogram = metrics.latency[i];
+        if (histogram.count() == 0) {
+            continue;
+        }
+        text += fmt::format("{:<13} n={:<9} p50 {:>9}  p99 {:>9}  p999 {:>9}  max {:>9}\n", kLatencyNames[i],
+                            histogram.count(), format_duration(histogram.percentile(50.0)),
+                            format_duration(histogram.percentile(99.0)), format_duration(histogram.percentile(99.9)),
+                            format_duration(histogram.max()));
+    }
+    double seconds = std::max(metrics.seconds, 1e-9);
+    text += fmt::format("{} jobs, {} seams ({:.1f}/s), {:.1f} Mpixels removed ({:.2f} Mpx/s) in {:.1f}s\n",
+                        metrics[Counter::JOBS], metrics[Counter::SEAMS], metrics[Counter::SEAMS] / seconds,
+                        metrics[Counter::PIXELS] / 1e6, metrics[Counter::PIXELS] / 1e6 / seconds, metrics.seconds);
+    return text;
+}
+
+std::string export_text(const Snapshot& metrics) {
+    std::string text;
+    for (int i = 0; i < kLatencyCount; i++) {
+        const Histogram& histogram = metrics.latency[i];
+        std::string metric = fmt::format("flink_{}_seconds", kLatencyNames[i]);
+        text += fmt::format("# TYPE {} summary\n", metric);
+        for (double quantile : {0.5, 0.99, 0.999}) {
+            text += fmt::format("{}{{quantile=\"{}\"}} {:.9f}\n", metric, quantile,
+                                histogram.percentile(quantile * 100.0) / 1e9);
+        }
+        text += fmt::format("{}_sum {:.9f}\n", metric, histogram.mean() * histogram.count() / 1e9);
+        text += fmt::format("{}_count {}\n", metric, histogram.count());
+    }
+    for (int i = 0; i < kCounterCount; i++) {
+        std::string metric = fmt::format("flink_{}_total", kCounterNames[i]);
+        text += fmt::format("# TYPE {} counter\n{} {}\n", metric, metric, metrics.counters[i]);
+    }
+    text += fmt::format("# TYPE flink_metrics_window_seconds gauge\nflink_metrics_window_seconds {:.3f}\n",
+                        metrics.seconds);
+    return text;
+}
+
+bool write_text_file(const Snapshot& metrics, const std::string& path) {
+    std::string text = export_text(metrics);
+    std::string temporary = path + ".tmp";
+    FILE* file = std::fopen(temporary.c_str(), "wb");
+    if (!file) {
+        return false;
+    }
+    bool ok = std::fwrite(text.data(), 1, text.size(), file) == text.size();
+    ok = std::fclose(file) == 0 && ok;
+    return ok && std::rename(temporary.c_str(), path.c_str()) == 0;
+}
+
+} // namespace Metrics
@@ -0,0 +1,158 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace Metrics {
+
+    /// Latencies recorded by the engine and the viewer
+    enum class Latency {
+        JOB,           ///< One carving call, start to finish (reduce_width_*, Carver::carve)
+        SEAM,          ///< One seam of a carving loop, all stages
+        ENERGY,        ///< Stage: energy map of one seam
+        SEAM_SEARCH,   ///< Stage: greedy walk or DP of one seam
+        SEAM_REMOVAL,  ///< Stage: removing one seam from the image and side planes
+        UPLOAD,        ///< Viewer: one batch of texture uploads on the upload thread, up to its fence
+        FRAME,         ///< Viewer: render loop work of one frame, without the wait for vsync
+        COUNT
+    };
+
+    /// Throughput counters, monotonically increasing
+    enum class Counter {
+        JOBS,     ///< Carving calls finished (or aborted)
+        SEAMS,    ///< Seams removed
+        PIXELS,   ///< Pixels removed (seams x image height)
+        COUNT
+    };
+
+    constexpr int kLatencyCount = static_cast<int>(Latency::COUNT);
+    constexpr int kCounterCount = static_cast<int>(Counter::COUNT);
+
+    /**
+     * @brief High dynamic range histogram of nanosecond values
+     *
+     * HdrHistogram layout: values below 256 ns have a bucket each, above
+     * that every power of two is split into 128 buckets, so any value is
+     * known to within 1/128 (< 0.8%) from 1 ns up to kMaxValue (~73 min;
+     * larger values are clamped). Plain data, so it can be copied, merged
+     * and placed in shared memory.
+     */
+    class Histogram {
+    public:
+        static constexpr int kSubBucketBits = 8;
+        static constexpr int kBucketCount = (42 - kSubBucketBits + 2) << (kSubBucketBits - 1);
+        static constexpr std::uint64_t kMaxValue = (std::uint64_t{1} << 42) - 1;
+
+        /// Bucket a value falls into
+        static int index_of(std::uint64_t value);
+        /// Largest value that falls into the same bucket as index
+        static std::uint64_t highest_equivalent(int index);
+
+        void record(std::uint64_t value, std::uint64_t times = 1);
+        void merge(const Histogram& other);
+        void reset();
+
+        std::uint64_t count() const { return count_; }
+        std::uint64_t max() const { return max_; }
+        double mean() const { return count_ ? static_cast<double>(sum_) / count_ : 0.0; }
+
+        /**
+         * Value at a percentile, e.g. 99.9 for p999.
+         *
+         * @return Highest value of the bucket holding that rank (at most max()), 0 when empty
+         */
+        std::uint64_t percentile(double percent) const;
+
+    private:
+        friend class ThreadRecorder;
+
+        std::array<std::uint64_t, kBucketCount> counts_{};
+        std::uint64_t count_ = 0;
+        std::uint64_t sum_ = 0;
+        std::uint64_t max_ = 0;
+    };
+
+    /**
+     * @brief Merged metrics of all threads at one point in time
+     */
+    struct Snapshot {
+        std::array<Histogram, kLatencyCount> latency;
+        std::array<std::uint64_t, kCounterCount> counters{};
+        double seconds = 0.0;  ///< Time covered: since the first record or the last reset()
+
+        const Histogram& operator[](Latency which) const { return latency[static_cast<int>(which)]; }
+        std::uint64_t operator[](Counter which) const { return counters[static_cast<int>(which)]; }
+
+        /// Add another snapshot (e.g. of another process); seconds becomes the longer of both
+        void merge(const Snapshot& other);
+    };
+
+    /**
+     * Record a latency on this thread.
+     *
+     * Every thread writes its own histograms; recording takes no lock and
+     * no atomic read-modify-write, only relaxed stores readers can see.
+     */
+    void record(Latency which, std::chrono::nanoseconds elapsed);
+
+    /// Add to a counter on this thread (lock-free, as record())
+    void add(Counter which, std::uint64_t amount = 1);
+
+    /**
+     * Merge the metrics of all threads, including threads that exited.
+     *
+     * Reading does not stop recording threads; a snapshot taken while they
+     * run may miss their last few records.
+     */
+    Snapshot snapshot();
+
+    /// Zero all metrics; only call when no thread is recording (e.g. in a freshly forked process)
+    void reset();
+
+    /// Name of a latency as used in exports, e.g. "seam_search"
+    const char* name(Latency which);
+    /// Name of a counter as used in exports, e.g. "seams"
+    const char* name(Counter which);
+
+    /**
+     * Human readable summary: counts, rates and p50/p99/p999/max per latency.
+     *
+     * @return One line per recorded latency and one for the counters
+     */
+    std::string summary(const Snapshot& metrics);
+
+    /**
+     * Prometheus text exposition of a snapshot.
+     *
+     * Latencies become `flink_<name>_seconds` summaries with 0.5/0.99/0.999
+     * quantiles, counters `flink_<name>_total`.
+     */
+    std::string export_text(const Snapshot& metrics);
+
+    /**
+     * Write export_text() to a file for a textfile collector (e.g. the
+     * node_exporter one) or a scraper, replacing it atomically.
+     *
+     * @return True on success
+     */
+    bool write_text_file(const Snapshot& metrics, const std::string& path);
+
+    /**
+     * @brief Records the time from construction to destruction
+     */
+    class ScopedTimer {
+    public:
+        explicit ScopedTimer(Latency which) : which_(which), start_(std::chrono::steady_clock::now()) {}
+        ~ScopedTimer() { record(which_, std::chrono::steady_clock::now() - start_); }
+        ScopedTimer(const ScopedTimer&) = delete;
+        ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+    private:
+        Latency which_;
+        std::chrono::steady_clock::time_point start_;
+    };
+
+} // namespace Metrics
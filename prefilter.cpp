@@ -0,0 +1,354 @@
+#include "prefilter.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <thread>
+
+namespace SeamCarving {
+
+namespace {
+
+    /**
+     * @brief Young-van Vliet recursive Gaussian, normalized to unit DC gain
+     *
+     * w[n] = B x[n] + a1 w[n-1] + a2 w[n-2] + a3 w[n-3], run forward and then
+     * backward ("Recursive implementation of the Gaussian filter", 1995).
+     * Edges are replicated by running the recursion over `radius` virtual
+     * samples beyond each end, so the result matches a clamped convolution
+     * with the truncated impulse response `kernel`.
+     */
+    struct RecursiveGaussian {
+        float B, a1, a2, a3;
+        int radius = 1;             ///< Impulse response tail beyond it is below 0.2%
+        std::vector<float> kernel;  ///< Normalized impulse response, taps 0..radius
+
+        explicit RecursiveGaussian(float sigma) {
+            double q = sigma >= 2.5f ? 0.98711 * sigma - 0.96330
+                                     : 3.97156 - 4.14554 * std::sqrt(1.0 - 0.26891 * sigma);
+            double q2 = q * q;
+            double q3 = q2 * q;
+            double b0 = 1.57825 + 2.44413 * q + 1.4281 * q2 + 0.422205 * q3;
+            double b1 = 2.44413 * q + 2.85619 * q2 + 1.26661 * q3;
+            double b2 = -(1.4281 * q2 + 1.26661 * q3);
+            double b3 = 0.422205 * q3;
+            a1 = static_cast<float>(b1 / b0);
+            a2 = static_cast<float>(b2 / b0);
+            a3 = static_cast<float>(b3 / b0);
+            B = 1.0f - (a1 + a2 + a3);
+
+            // The recursion has heavier tails than a Gaussian of the same sigma
+            int reach = static_cast<int>(std::ceil(8.0f * sigma)) + 4;
+            std::vector<float> impulse(2 * reach + 1, 0.0f);
+            impulse[reach] = 1.0f;
+            run(impulse.data(), static_cast<int>(impulse.size()));
+            float tail = 0.0f;
+            radius = reach;
+            while (radius > 1 && tail + 2.0f * impulse[reach + radius] < 0.002f) {
+                tail += 2.0f * impulse[reach + radius];
+                radius--;
+            }
+            kernel.assign(impulse.begin() + reach, impulse.begin() + reach + radius + 1);
+            float sum = kernel[0];
+            for (int k = 1; k <= radius; k++) {
+                sum += 2.0f * kernel[k];
+            }
+            for (float& tap : kernel) {
+                tap /= sum;
+            }
+        }
+
+        /// Forward and backward pass over n samples, no padding
+        void run(float* data, int n) const {
+            float w1 = data[0], w2 = data[0], w3 = data[0];
+            for (int i = 0; i < n; i++) {
+                float w = B * data[i] + a1 * w1 + a2 * w2 + a3 * w3;
+                w3 = w2;
+                w2 = w1;
+                w1 = w;
+                data[i] = w;
+            }
+            w1 = w2 = w3 = data[n - 1];
+            for (int i = n - 1; i >= 0; i--) {
+                float w = B * data[i] + a1 * w1 + a2 * w2 + a3 * w3;
+                w3 = w2;
+                w2 = w1;
+                w1 = w;
+                data[i] = w;
+            }
+        }
+
+        /// Filter a contiguous row in place; `padded` is scratch memory
+        void filter_row(float* row, int n, std::vector<float>& padded) const {
+            padded.resize(n + 2 * radius);
+            std::fill(padded.begin(), padded.begin() + radius, row[0]);
+            std::copy(row, row + n, padded.begin() + radius);
+            std::fill(padded.begin() + radius + n, padded.end(), row[n - 1]);
+            run(padded.data(), static_cast<int>(padded.size()));
+            std::copy(padded.begin() + radius, padded.begin() + radius + n, row);
+        }
+
+        /// Filter columns [x0, x1) of a matrix in place, a whole row segment per step
+        void filter_columns(const MatrixView<float>& m, int x0, int x1) const {
+            int height = m.height;
+            size_t n = static_cast<size_t>(x1 - x0);
+            // Virtual rows: 3 of history before the first row, `radius` after the last
+            std::vector<float> before(3 * n);
+            std::vector<float> after((radius + 3) * n);
+            auto before_row = [&](int k) { return before.data() + (k - 1) * n; };  // row -k
+            auto after_row = [&](int k) { return after.data() + k * n; };          // row height + k
+            auto row = [&](int y) -> float* {
+                if (y < 0) {
+                    return before_row(-y);
+                }
+                return y < height ? m.row(y) + x0 : after_row(y - height);
+            };
+
+            // Forward: warm the history up on `radius` copies of the first row
+            const float* first = m.row(0) + x0;
+            std::vector<float> edge(first, first + n);
+            for (int k = 1; k <= 3; k++) {
+                std::copy(edge.begin(), edge.end(), before_row(k));
+            }
+            for (int i = 0; i < radius; i++) {
+                float* h1 = before_row(1);
+                float* h2 = before_row(2);
+                float* h3 = before_row(3);
+                for (size_t x = 0; x < n; x++) {
+                    float w = B * edge[x] + a1 * h1[x] + a2 * h2[x] + a3 * h3[x];
+                    h3[x] = h2[x];
+                    h2[x] = h1[x];
+                    h1[x] = w;
+                }
+            }
+            const float* last = m.row(height - 1) + x0;
+            edge.assign(last, last + n);
+            for (int y = 0; y < height + radius; y++) {
+                const float* p1 = row(y - 1);
+                const float* p2 = row(y - 2);
+                const float* p3 = row(y - 3);
+                float* out = row(y);
+                const float* in = y < height ? out : edge.data();
+                for (size_t x = 0; x < n; x++) {
+                    out[x] = B * in[x] + a1 * p1[x] + a2 * p2[x] + a3 * p3[x];
+                }
+            }
+
+            // Backward: the history starts at the last virtual row
+            for (int k = radius; k < radius + 3; k++) {
+                std::copy(after_row(radius - 1), after_row(radius - 1) + n, after_row(k));
+            }
+            for (int y = height + radius - 1; y >= 0; y--) {
+                const float* n1 = row(y + 1);
+                const float* n2 = row(y + 2);
+                const float* n3 = row(y + 3);
+                float* out = row(y);
+                for (size_t x = 0; x < n; x++) {
+                    out[x] = B * out[x] + a1 * n1[x] + a2 * n2[x] + a3 * n3[x];
+                }
+            }
+        }
+    };
+
+    /// Run fn(begin, end) over [0, count) split into contiguous ranges, one per thread
+    template <typename Fn>
+    void parallel_ranges(int count, int threads, Fn fn) {
+        // Ranges below 64 rows/columns are not worth a thread
+        threads = std::max(1, std::min(threads, count / 64));
+        if (threads == 1) {
+            fn(0, count);
+            return;
+        }
+        std::vector<std::thread> workers;
+        workers.reserve(threads - 1);
+        int chunk = (count + threads - 1) / threads;
+        for (int t = 1; t < threads; t++) {
+            int begin = std::min(count, t * chunk);
+            int end = std::min(count, begin + chunk);
+            workers.emplace_back([=, &fn]() { fn(begin, end); });
+        }
+        fn(0, std::min(count, chunk));
+        for (std::thread& worker : workers) {
+            worker.join();
+        }
+    }
+
+    void luma_row(const unsigned char* pixels, int channels, int width, float* out) {
+        for (int x = 0; x < width; x++, pixels += channels) {
+            out[x] = 0.299f * pixels[0] + 0.587f * pixels[1] + 0.114f * pixels[2];
+        }
+    }
+
+    /// Sobel magnitude of columns [x0, x1) of row y; border pixels get zero
+    void sobel_row(const MatrixView<const float>& luma, int y, int x0, int x1, float* out) {
+        int width = luma.width;
+        if (y == 0 || y == luma.height - 1) {
+            std::fill(out + x0, out + x1, 0.0f);
+            return;
+        }
+        const float* above = luma.row(y - 1);
+        const float* center = luma.row(y);
+        const float* below = luma.row(y + 1);
+        for (int x = x0; x < x1; x++) {
+            if (x == 0 || x == width - 1) {
+                out[x] = 0.0f;
+                continue;
+            }
+            float gx = (above[x + 1] - above[x - 1]) + 2.0f * (center[x + 1] - center[x - 1]) +
+                       (below[x + 1] - below[x - 1]);
+            float gy = (below[x - 1] - above[x - 1]) + 2.0f * (below[x] - above[x]) +
+                       (below[x + 1] - above[x + 1]);
+            out[x] = std::sqrt(gx * gx + gy * gy);
+        }
+    }
+
+    void remove_from_row(float* row, int width, int x) {
+        std::memmove(row + x, row + x + 1, static_cast<size_t>(width - 1 - x) * sizeof(float));
+    }
+
+} // namespace
+
+void SmoothedEnergy::release() {
+    for (Memory::LargeBuffer<float>* buffer : {&luma_, &horizontal_, &blurred_, &energy_}) {
+        Memory::LargeBuffer<float>().swap(*buffer);
+    }
+    std::vector<int>().swap(band_lo_);
+    std::vector<int>().swap(band_hi_);
+    std::vector<int>().swap(wide_lo_);
+    std::vector<int>().swap(wide_hi_);
+    width_ = height_ = 0;
+    stride_ = 0;
+}
+
+void SmoothedEnergy::compute(const ImageView& pixels, float sigma, int threads) {
+    width_ = pixels.width;
+    height_ = pixels.height;
+    stride_ = width_;
+    sigma_ = sigma > 0.0f ? std::max(sigma, 0.5f) : 0.0f;
+    RecursiveGaussian filter(std::max(sigma_, 0.5f));
+    // Band updates use the filter's own truncated impulse response, so
+    // refiltered bands blend into the recursively filtered rest
+    radius_ = sigma_ > 0.0f ? filter.radius : 0;
+    kernel_ = sigma_ > 0.0f ? filter.kernel : std::vector<float>(1, 1.0f);
+
+    size_t cells = static_cast<size_t>(width_) * height_;
+    for (Memory::LargeBuffer<float>* buffer : {&luma_, &horizontal_, &blurred_, &energy_}) {
+        if (buffer->size() < cells) {
+            buffer->resize(cells);
+        }
+    }
+
+    MatrixView<float> horizontal{horizontal_.data(), width_, height_, stride_};
+    MatrixView<float> blurred{blurred_.data(), width_, height_, stride_};
+    parallel_ranges(height_, threads, [&](int begin, int end) {
+        std::vector<float> padded;
+        for (int y = begin; y < end; y++) {
+            float* luma = luma_.data() + y * stride_;
+            luma_row(pixels.row(y), pixels.channels, width_, luma);
+            std::copy(luma, luma + width_, horizontal.row(y));
+            if (sigma_ > 0.0f) {
+                filter.filter_row(horizontal.row(y), width_, padded);
+            }
+            std::copy(horizontal.row(y), horizontal.row(y) + width_, blurred.row(y));
+        }
+    });
+    if (sigma_ > 0.0f) {
+        parallel_ranges(width_, threads, [&](int begin, int end) {
+            filter.filter_columns(blurred, begin, end);
+        });
+    }
+    parallel_ranges(height_, threads, [&](int begin, int end) {
+        for (int y = begin; y < end; y++) {
+            sobel_row(blurred, y, 0, width_, energy_.data() + y * stride_);
+        }
+    });
+}
+
+void SmoothedEnergy::remove_seam(const int* seam) {
+    // Compact every map, then refilter where the seam broke the neighbourhoods
+    for (int y = 0; y < height_; y++) {
+        size_t offset = static_cast<size_t>(y) * stride_;
+        remove_from_row(luma_.data() + offset, width_, seam[y]);
+        remove_from_row(horizontal_.data() + offset, width_, seam[y]);
+        remove_from_row(blurred_.data() + offset, width_, seam[y]);
+        remove_from_row(energy_.data() + offset, width_, seam[y]);
+    }
+    width_--;
+
+    // Horizontal blur of row y changes where its window holds the seam
+    band_lo_.resize(height_);
+    band_hi_.resize(height_);
+    for (int y = 0; y < height_; y++) {
+        band_lo_[y] = std::max(0, seam[y] - radius_);
+        band_hi_[y] = std::min(width_, seam[y] + radius_);
+    }
+    // Vertical blur of row y changes where a row of its window changed, or
+    // where the rows of its window lost different columns
+    wide_lo_.resize(height_);
+    wide_hi_.resize(height_);
+    for (int y = 0; y < height_; y++) {
+        int lo = width_;
+        int hi = 0;
+        for (int k = std::max(0, y - radius_); k <= std::min(height_ - 1, y + radius_); k++) {
+            lo = std::min(lo, band_lo_[k]);
+            hi = std::max(hi, band_hi_[k]);
+        }
+        wide_lo_[y] = lo;
+        wide_hi_[y] = hi;
+    }
+
+    if (radius_ > 0) {
+        refilter_blur();
+    }
+    refilter_energy();
+}
+
+void SmoothedEnergy::refilter_blur() {
+    const float* taps = kernel_.data();
+    for (int y = 0; y < height_; y++) {
+        const float* luma = luma_.data() + y * stride_;
+        float* out = horizontal_.data() + y * stride_;
+        for (int x = band_lo_[y]; x < band_hi_[y]; x++) {
+            float sum = taps[0] * luma[x];
+            for (int k = 1; k <= radius_; k++) {
+                sum += taps[k] * (luma[std::max(x - k, 0)] + luma[std::min(x + k, width_ - 1)]);
+            }
+            out[x] = sum;
+        }
+    }
+
+    const float* rows = horizontal_.data();
+    for (int y = 0; y < height_; y++) {
+        float* out = blurred_.data() + y * stride_;
+        const float* center = rows + y * stride_;
+        for (int x = wide_lo_[y]; x < wide_hi_[y]; x++) {
+            out[x] = taps[0] * center[x];
+        }
+        for (int k = 1; k <= radius_; k++) {
+            const float* above = rows + std::max(y - k, 0) * stride_;
+            const float* below = rows + std::min(y + k, height_ - 1) * stride_;
+            for (int x = wide_lo_[y]; x < wide_hi_[y]; x++) {
+                out[x] += taps[k] * (above[x] + below[x]);
+            }
+        }
+    }
+}
+
+void SmoothedEnergy::refilter_energy() {
+    // Sobel reaches one pixel: widen by one column and take the neighbour rows
+    MatrixView<const float> blurred{blurred_.data(), width_, height_, stride_};
+    for (int y = 0; y < height_; y++) {
+        int x0 = width_;
+        int x1 = 0;
+        for (int k = std::max(0, y - 1); k <= std::min(height_ - 1, y + 1); k++) {
+            x0 = std::min(x0, wide_lo_[k] - 1);
+            x1 = std::max(x1, wide_hi_[k] + 1);
+        }
+        x0 = std::max(x0, 0);
+        x1 = std::min(x1, width_);
+        if (x0 < x1) {
+            sobel_row(blurred, y, x0, x1, energy_.data() + y * stride_);
+        }
+    }
+}
+
+} // namespace SeamCarving
@@ -0,0 +1,79 @@
+#pragma once
+
+#include "seam_carving.h"
+
+#include <vector>
+
+namespace SeamCarving {
+
+    /**
+     * @brief Sobel energy of the Gaussian-blurred luma, updated around removed seams
+     *
+     * JPEG artefacts and sensor noise give the plain Sobel energy a speckle
+     * that makes seams wander; blurring first keeps only structure larger
+     * than sigma. compute() blurs the luma with a recursive Gaussian
+     * (Young-van Vliet): a third order IIR filter runs forward and backward
+     * over every row, then over every column, so the cost per pixel does not
+     * depend on sigma. Rows are split between threads for the horizontal
+     * pass; the vertical pass advances whole rows at a time, so it vectorizes
+     * across columns and is split between threads by column ranges. Edges
+     * are replicated. After
+     * a seam is removed, remove_seam() compacts the maps and refilters only
+     * the band the seam can influence (a truncated kernel of radius()
+     * pixels), so a seam costs O(radius^2) per row instead of a full pass.
+     * Values outside the band keep the recursive filter's result; the two
+     * differ by the Gaussian tail beyond radius() (below 0.1%).
+     *
+     * With sigma 0 the blur is skipped and the energy equals
+     * calculate_energy().
+     */
+    class SmoothedEnergy {
+    public:
+        /**
+         * Compute the maps of an image.
+         *
+         * @param pixels Input image view
+         * @param sigma Blur standard deviation in pixels (0 = no blur)
+         * @param threads Threads to use for the full passes (1 runs on the caller's thread)
+         */
+        void compute(const ImageView& pixels, float sigma, int threads = 1);
+
+        /**
+         * Remove a seam of the current width and update the energy around it.
+         *
+         * @param seam height() x-coordinates in the current width
+         */
+        void remove_seam(const int* seam);
+
+        /// Free the maps; sigma() and radius() stay, and the next compute() allocates again
+        void release();
+
+        /// Energy of the current width (row stride of the computed width)
+        MatrixView<float> energy() { return {energy_.data(), width_, height_, stride_}; }
+
+        int width() const { return width_; }
+        int height() const { return height_; }
+        float sigma() const { return sigma_; }
+        /// Pixels a luma change reaches in the blurred luma
+        int radius() const { return radius_; }
+
+    private:
+        /// Truncated-kernel blur of the bands around the last seam
+        void refilter_blur();
+        void refilter_energy();
+
+        int width_ = 0;
+        int height_ = 0;
+        std::ptrdiff_t stride_ = 0;
+        float sigma_ = 0.0f;
+        int radius_ = 0;
+        std::vector<float> kernel_;              ///< Truncated Gaussian taps 0..radius, normalized
+        Memory::LargeBuffer<float> luma_;
+        Memory::LargeBuffer<float> horizontal_;  ///< Luma blurred along rows
+        Memory::LargeBuffer<float> blurred_;     ///< Luma blurred along rows and columns
+        Memory::LargeBuffer<float> energy_;
+        std::vector<int> band_lo_, band_hi_;     ///< Per row: columns of horizontal_ to refilter
+        std::vector<int> wide_lo_, wide_hi_;     ///< Per row: columns of blurred_ to refilter
+    };
+
+} // namespace SeamCarving
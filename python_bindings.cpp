@@ -0,0 +1,477 @@
+/**
+ * @brief Python module exposing the SeamCarving engine on NumPy arrays
+ *
+ * Images are uint8 arrays of shape (height, width, channels) with 3 or 4
+ * channels. Pixels inside a row must be packed, rows may have any stride, so
+ * crops such as image[y0:y1, x0:x1] are carved without copying them out first.
+ * The GIL is released while the engine runs. Attached planes (alpha, depth,
+ * labels) may have any dtype and shape (height, width) or (height, width, k).
+ *
+ *     import numpy as np, seam_carving
+ *     out = seam_carving.carve(image, target_width=400, algorithm=seam_carving.Algorithm.DYNAMIC)
+ */
+#include "checkpoint.h"
+#include "cost_model.h"
+#include "metrics.h"
+#include "retarget_index.h"
+#include "seam_carving.h"
+#include "transport_map.h"
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <pybind11/numpy.h>
+#include <pybind11/pybind11.h>
+#include <pybind11/stl.h>
+
+namespace py = pybind11;
+
+namespace {
+
+    // No forcecast: arrays of the wrong dtype are rejected instead of silently copied
+    using ImageArray = py::array_t<unsigned char, 0>;
+    using EnergyArray = py::array_t<float, 0>;
+    using SeamArray = py::array_t<int, 0>;
+    using OrderArray = py::array_t<int, 0>;
+
+    SeamCarving::ImageView image_view(const ImageArray& image) {
+        if (image.ndim() != 3 || image.shape(0) < 1 || image.shape(1) < 1 ||
+            (image.shape(2) != 3 && image.shape(2) != 4)) {
+            throw py::value_error("image must have shape (height, width, 3 or 4) and not be empty");
+        }
+        if (image.strides(2) != 1 || image.strides(1) != image.shape(2)) {
+            throw py::value_error("pixels within a row must be packed (rows may be strided)");
+        }
+        return {image.data(), static_cast<int>(image.shape(1)), static_cast<int>(image.shape(0)),
+                static_cast<int>(image.shape(2)), image.strides(0)};
+    }
+
+    SeamCarving::MutableImageView mutable_image_view(ImageArray& image) {
+        SeamCarving::ImageView view = image_view(image);
+        return {image.mutable_data(), view.width, view.height, view.channels, view.stride};
+    }
+
+    SeamCarving::MatrixView<const float> energy_view(const EnergyArray& energy) {
+        const py::ssize_t item = sizeof(float);
+        if (energy.ndim() != 2 || energy.shape(0) < 1 || energy.shape(1) < 1 ||
+            energy.strides(1) != item || energy.strides(0) % item != 0) {
+            throw py::value_error("energy must be a non-empty 2D float32 array with packed rows");
+        }
+        return {energy.data(), static_cast<int>(energy.shape(1)), static_cast<int>(energy.shape(0)),
+                energy.strides(0) / item};
+    }
+
+    SeamCarving::MatrixView<const int> order_view(const OrderArray& order) {
+        const py::ssize_t item = sizeof(int);
+        if (order.ndim() != 2 || order.shape(0) < 1 || order.shape(1) < 1 ||
+            order.strides(1) != item || order.strides(0) % item != 0) {
+            throw py::value_error("order must be a non-empty 2D int32 array with packed rows");
+        }
+        return {order.data(), static_cast<int>(order.shape(1)), static_cast<int>(order.shape(0)),
+                order.strides(0) / item};
+    }
+
+    // Pixels of any dtype, viewed as opaque blocks of itemsize * components bytes
+    SeamCarving::ImageView plane_view(const py::array& plane, int width, int height) {
+        const py::ssize_t item = plane.itemsize();
+        if ((plane.ndim() != 2 && plane.ndim() != 3) || plane.shape(0) != height || plane.shape(1) != width) {
+            throw py::value_error("planes must have shape (height, width) or (height, width, k) of the image");
+        }
+        py::ssize_t pixel_bytes = plane.ndim() == 3 ? item * plane.shape(2) : item;
+        if (pixel_bytes < 1 || plane.strides(1) != pixel_bytes || (plane.ndim() == 3 && plane.strides(2) != item)) {
+            throw py::value_error("plane pixels within a row must be packed (rows may be strided)");
+        }
+        return {static_cast<const unsigned char*>(plane.data()), width, height, static_cast<int>(pixel_bytes),
+                plane.strides(0)};
+    }
+
+    ImageArray new_image(int width, int height, int channels) {
+        return ImageArray({height, width, channels});
+    }
+
+    // Scratch memory per calling thread, reused across calls
+    SeamCarving::CarveBuffers& thread_buffers(SeamCarving::DpMemory dp_memory = SeamCarving::DpMemory::FULL) {
+        thread_local SeamCarving::CarveBuffers buffers;
+        buffers.set_dp_memory(dp_memory);
+        // The blur of a smoothed carve is split between all cores
+        buffers.threads = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+        return buffers;
+    }
+
+    EnergyArray energy(const ImageArray& image) {
+        SeamCarving::ImageView src = image_view(image);
+        EnergyArray result({src.height, src.width});
+        SeamCarving::MatrixView<float> out{result.mutable_data(), src.width, src.height, src.width};
+        {
+            py::gil_scoped_release release;
+            SeamCarving::calculate_energy(src, out);
+        }
+        return result;
+    }
+
+    SeamArray find_seam(const EnergyArray& energy, SeamCarving::Algorithm algorithm, SeamCarving::DpMemory dp_memory) {
+        SeamCarving::MatrixView<const float> view = energy_view(energy);
+        SeamArray seam(view.height);
+        int* seam_data = seam.mutable_data();
+        {
+            py::gil_scoped_release release;
+            SeamCarving::find_low_energy_seam(view, thread_buffers(dp_memory), seam_data, algorithm);
+        }
+        return seam;
+    }
+
+    ImageArray remove_seam(const ImageArray& image, const SeamArray& seam) {
+        SeamCarving::ImageView src = image_view(image);
+        if (seam.ndim() != 1 || seam.shape(0) != src.height || seam.strides(0) != static_cast<py::ssize_t>(sizeof(int))) {
+            throw py::value_error("seam must be a contiguous int32 array with one entry per row");
+        }
+        const int* seam_data = seam.data();
+        for (int y = 0; y < src.height; y++) {
+            if (seam_data[y] < 0 || seam_data[y] >= src.width) {
+                throw py::value_error("seam column out of range");
+            }
+        }
+        ImageArray result = new_image(src.width - 1, src.height, src.channels);
+        SeamCarving::MutableImageView dst = mutable_image_view(result);
+        {
+            py::gil_scoped_release release;
+            SeamCarving::remove_seam(src, seam_data, dst);
+        }
+        return result;
+    }
+
+    ImageArray carve(const ImageArray& image, int target_width, SeamCarving::Algorithm algorithm, py::object out,
+                     float smoothing, SeamCarving::DpMemory dp_memory) {
+        SeamCarving::ImageView src = image_view(image);
+        if (target_width <= 0 || target_width > src.width) {
+            throw py::value_error("target_width must be in [1, image width]");
+        }
+        if (smoothing < 0.0f) {
+            throw py::value_error("smoothing must not be negative");
+        }
+
+        // out is written in place, so it must already be a uint8 array (a converted copy would be lost)
+        if (!out.is_none() && !py::isinstance<ImageArray>(out)) {
+            throw py::type_error("out must be a uint8 numpy array");
+        }
+        ImageArray result = out.is_none() ? new_image(target_width, src.height, src.channels)
+                                          : py::reinterpret_borrow<ImageArray>(out);
+        SeamCarving::MutableImageView dst = mutable_image_view(result);
+        if (dst.width != target_width || dst.height != src.height || dst.channels != src.channels) {
+            throw py::value_error("out must have shape (height, target_width, channels)");
+        }
+        {
+            py::gil_scoped_release release;
+            SeamCarving::reduce_width_smoothed(src, dst, smoothing, thread_buffers(dp_memory), algorithm);
+        }
+        return result;
+    }
+
+    ImageArray carve_resumable(const ImageArray& image, int target_width, const std::string& checkpoint_path,
+                               double interval_seconds, SeamCarving::Algorithm algorithm) {
+        SeamCarving::ImageView src = image_view(image);
+        if (target_width <= 0 || target_width > src.width) {
+            throw py::value_error("target_width must be in [1, image width]");
+        }
+        ImageArray result = new_image(target_width, src.height, src.channels);
+        SeamCarving::MutableImageView dst = mutable_image_view(result);
+        int reached = 0;
+        {
+            py::gil_scoped_release release;
+            // Ctrl-C stops at the next seam; the checkpoint written then resumes the run
+            reached = SeamCarving::reduce_width_resumable(src, dst, checkpoint_path, interval_seconds, algorithm,
+                                                          [](int, int) {
+                                                              py::gil_scoped_acquire acquire;
+                                                              return PyErr_CheckSignals() == 0;
+                                                          });
+        }
+        if (reached != target_width) {
+            throw py::error_already_set();
+        }
+        return result;
+    }
+
+    ImageArray carve_strips(const ImageArray& image, int target_width, int max_strip_width) {
+        SeamCarving::ImageView src = image_view(image);
+        if (target_width <= 0 || target_width > src.width) {
+            throw py::value_error("target_width must be in [1, image width]");
+        }
+        if (max_strip_width < 1 || max_strip_width > 8) {
+            throw py::value_error("max_strip_width must be in [1, 8]");
+        }
+        ImageArray result = new_image(target_width, src.height, src.channels);
+        SeamCarving::MutableImageView dst = mutable_image_view(result);
+        {
+            py::gil_scoped_release release;
+            SeamCarving::reduce_width_strips(src, dst, thread_buffers(), max_strip_width);
+        }
+        return result;
+    }
+
+    py::tuple carve_2d(const ImageArray& image, int target_width, int target_height, double memory_budget_mb,
+                       SeamCarving::Algorithm algorithm) {
+        SeamCarving::ImageView src = image_view(image);
+        if (target_width <= 0 || target_width > src.width || target_height <= 0 || target_height > src.height) {
+            throw py::value_error("target size must be in [1, image size]");
+        }
+        if (memory_budget_mb <= 0.0) {
+            throw py::value_error("memory_budget_mb must be positive");
+        }
+        SeamCarving::TransportOptions options;
+        options.memory_budget = static_cast<std::size_t>(memory_budget_mb * 1024.0 * 1024.0);
+        options.algorithm = algorithm;
+        ImageArray result = new_image(target_width, target_height, src.channels);
+        SeamCarving::MutableImageView dst = mutable_image_view(result);
+        SeamCarving::TransportPlan plan;
+        {
+            py::gil_scoped_release release;
+            SeamCarving::retarget_2d(src, dst, thread_buffers(), options, nullptr, &plan);
+        }
+        std::string order;
+        order.reserve(plan.order.size());
+        for (SeamCarving::SeamDirection direction : plan.order) {
+            order += direction == SeamCarving::SeamDirection::VERTICAL ? 'v' : 'h';
+        }
+        return py::make_tuple(result, order);
+    }
+
+    py::tuple carve_with_planes(const ImageArray& image, const std::vector<py::array>& planes, int target_width,
+                                SeamCarving::Algorithm algorithm, SeamCarving::DpMemory dp_memory) {
+        SeamCarving::ImageView src = image_view(image);
+        if (target_width <= 0 || target_width > src.width) {
+            throw py::value_error("target_width must be in [1, image width]");
+        }
+
+        ImageArray result = new_image(target_width, src.height, src.channels);
+        std::vector<SeamCarving::AttachedPlane> attached;
+        py::list carved_planes;
+        for (const py::array& plane : planes) {
+            SeamCarving::ImageView plane_src = plane_view(plane, src.width, src.height);
+            std::vector<py::ssize_t> shape(plane.shape(), plane.shape() + plane.ndim());
+            shape[1] = target_width;
+            py::array carved(plane.dtype(), shape);
+            attached.push_back({plane_src, SeamCarving::MutableImageView::packed(
+                static_cast<unsigned char*>(carved.mutable_data()), target_width, src.height, plane_src.channels)});
+            carved_planes.append(carved);
+        }
+
+        SeamCarving::MutableImageView dst = mutable_image_view(result);
+        {
+            py::gil_scoped_release release;
+            SeamCarving::reduce_width_iteratively(src, dst, attached.data(), static_cast<int>(attached.size()),
+                                                  thread_buffers(dp_memory), algorithm);
+        }
+        return py::make_tuple(result, carved_planes);
+    }
+
+    py::tuple carve_with_deadline(const ImageArray& image, int target_width, double deadline_ms,
+                                  SeamCarving::Algorithm algorithm, int threads) {
+        SeamCarving::ImageView src = image_view(image);
+        if (target_width <= 0 || target_width > src.width) {
+            throw py::value_error("target_width must be in [1, image width]");
+        }
+        ImageArray result = new_image(target_width, src.height, src.channels);
+        SeamCarving::MutableImageView dst = mutable_image_view(result);
+        SeamCarving::DeadlineReport report;
+        {
+            py::gil_scoped_release release;
+            report = SeamCarving::reduce_width_with_deadline(src, dst, thread_buffers(), algorithm, deadline_ms,
+                                                             std::max(1, threads));
+        }
+        py::dict info;
+        info["mode"] = SeamCarving::quality_mode_name(report.plan.mode);
+        info["predicted_ms"] = report.plan.predicted_ms;
+        info["elapsed_ms"] = report.elapsed_ms;
+        info["seams_carved"] = report.seams_carved;
+        info["degraded"] = report.degraded;
+        return py::make_tuple(result, info);
+    }
+
+    py::tuple seam_order(const ImageArray& image, int min_width, SeamCarving::Algorithm algorithm,
+                         SeamCarving::DpMemory dp_memory) {
+        SeamCarving::ImageView src = image_view(image);
+        OrderArray order({src.height, src.width});
+        SeamCarving::MatrixView<int> out{order.mutable_data(), src.width, src.height, src.width};
+        int seams = 0;
+        {
+            py::gil_scoped_release release;
+            seams = SeamCarving::compute_seam_order(src, min_width, out, thread_buffers(dp_memory), algorithm);
+        }
+        return py::make_tuple(order, src.width - seams);
+    }
+
+    void check_order_entries(const SeamCarving::MatrixView<const int>& order) {
+        for (int y = 0; y < order.height; y++) {
+            const int* row = order.row(y);
+            if (std::any_of(row, row + order.width, [](int entry) { return entry < 0; })) {
+                throw py::value_error("order entries must not be negative");
+            }
+        }
+    }
+
+    void check_width(const SeamCarving::RetargetIndex& index, int width) {
+        if (width < index.min_width() || width > index.width()) {
+            throw py::value_error("width must be in [min_width, original width]");
+        }
+    }
+
+    py::dict metrics() {
+        Metrics::Snapshot snapshot = Metrics::snapshot();
+        py::dict result;
+        for (int i = 0; i < Metrics::kLatencyCount; i++) {
+            auto which = static_cast<Metrics::Latency>(i);
+            const Metrics::Histogram& histogram = snapshot[which];
+            py::dict latency;
+            latency["count"] = histogram.count();
+            latency["mean"] = histogram.mean() / 1e9;
+            latency["p50"] = histogram.percentile(50.0) / 1e9;
+            latency["p99"] = histogram.percentile(99.0) / 1e9;
+            latency["p999"] = histogram.percentile(99.9) / 1e9;
+            latency["max"] = histogram.max() / 1e9;
+            result[Metrics::name(which)] = latency;
+        }
+        for (int i = 0; i < Metrics::kCounterCount; i++) {
+            auto which = static_cast<Metrics::Counter>(i);
+            result[Metrics::name(which)] = snapshot[which];
+        }
+        result["seconds"] = snapshot.seconds;
+        return result;
+    }
+
+    void check_row(const SeamCarving::RetargetIndex& index, int y) {
+        if (y < 0 || y >= index.height()) {
+            throw py::index_error("row out of range");
+        }
+    }
+
+} // namespace
+
+PYBIND11_MODULE(seam_carving, m) {
+    m.doc() = "Content-aware image resizing (seam carving) on NumPy arrays";
+
+    // Calibrate once at import, so no deadline carve pays for it
+    SeamCarving::CostModel::host();
+
+    py::enum_<SeamCarving::Algorithm>(m, "Algorithm")
+        .value("GREEDY", SeamCarving::Algorithm::GREEDY)
+        .value("DYNAMIC", SeamCarving::Algorithm::DYNAMIC);
+
+    py::enum_<SeamCarving::DpMemory>(m, "DpMemory",
+                                     "DP storage of the DYNAMIC search; QUANTIZED runs it in 16-bit levels,\n"
+                                     "faster but only near-optimal")
+        .value("FULL", SeamCarving::DpMemory::FULL)
+        .value("BACKPOINTERS", SeamCarving::DpMemory::BACKPOINTERS)
+        .value("CHECKPOINTED", SeamCarving::DpMemory::CHECKPOINTED)
+        .value("QUANTIZED", SeamCarving::DpMemory::QUANTIZED);
+
+    m.def("energy", &energy, py::arg("image"),
+          "Sobel energy map of an image as a (height, width) float32 array");
+    m.def("find_seam", &find_seam, py::arg("energy"), py::arg("algorithm") = SeamCarving::Algorithm::GREEDY,
+          py::arg("dp_memory") = SeamCarving::DpMemory::FULL,
+          "Column index of the lowest energy vertical seam for every row");
+    m.def("remove_seam", &remove_seam, py::arg("image"), py::arg("seam"),
+          "Copy of the image with the given vertical seam removed");
+    m.def("carve", &carve, py::arg("image"), py::arg("target_width"),
+          py::arg("algorithm") = SeamCarving::Algorithm::GREEDY, py::arg("out") = py::none(),
+          py::arg("smoothing") = 0.0f, py::arg("dp_memory") = SeamCarving::DpMemory::FULL,
+          "Reduce the image width to target_width by removing seams. When out is given it\n"
+          "must be a uint8 array of shape (height, target_width, channels) and is filled in place.\n"
+          "smoothing > 0 blurs the luma by that sigma (pixels) before the energy, so noise and\n"
+          "JPEG artefacts do not steer the seams. dp_memory selects the DP storage of DYNAMIC.");
+    m.def("carve_resumable", &carve_resumable, py::arg("image"), py::arg("target_width"),
+          py::arg("checkpoint_path"), py::arg("interval_seconds") = 60.0,
+          py::arg("algorithm") = SeamCarving::Algorithm::GREEDY,
+          "Carve like carve(), writing a checkpoint to checkpoint_path every interval_seconds\n"
+          "(in the background) and when interrupted. Calling it again with the same image resumes\n"
+          "after the last checkpointed seam; the file is removed once the result is complete.");
+    m.def("carve_strips", &carve_strips, py::arg("image"), py::arg("target_width"), py::arg("max_strip_width") = 8,
+          "Reduce the width removing strips of up to max_strip_width columns per pass: wide\n"
+          "across flat background, single seams near detail. Much faster for large reductions.");
+    m.def("carve_2d", &carve_2d, py::arg("image"), py::arg("target_width"), py::arg("target_height"),
+          py::arg("memory_budget_mb") = 32.0, py::arg("algorithm") = SeamCarving::Algorithm::DYNAMIC,
+          "Reduce width and height, removing columns and rows in the order a beam search over\n"
+          "the transport map of a downscaled proxy found cheapest; memory_budget_mb caps the proxy\n"
+          "images the search caches. Returns (image, order) with order a string of 'v' (column)\n"
+          "and 'h' (row) steps.");
+    m.def("carve_with_planes", &carve_with_planes, py::arg("image"), py::arg("planes"), py::arg("target_width"),
+          py::arg("algorithm") = SeamCarving::Algorithm::GREEDY, py::arg("dp_memory") = SeamCarving::DpMemory::FULL,
+          "Carve the image and remove the same pixels from every plane (seams are found on\n"
+          "the image only). Returns (image, [planes]).");
+    m.def("carve_with_deadline", &carve_with_deadline, py::arg("image"), py::arg("target_width"),
+          py::arg("deadline_ms"), py::arg("algorithm") = SeamCarving::Algorithm::GREEDY, py::arg("threads") = 1,
+          "Reduce the width within deadline_ms, degrading from exact carving to approximate energy,\n"
+          "pyramid and partial carving plus scaling as needed. threads is the number of carving\n"
+          "calls running at once. Returns (image, report dict).");
+    m.def("seam_order", &seam_order, py::arg("image"), py::arg("min_width"),
+          py::arg("algorithm") = SeamCarving::Algorithm::GREEDY, py::arg("dp_memory") = SeamCarving::DpMemory::FULL,
+          "Index of the seam removing every pixel when carving down to min_width.\n"
+          "Returns (order, min_width_reached); order is a (height, width) int32 array.");
+    m.def("metrics", &metrics,
+          "Latencies (seconds: count, mean, p50, p99, p999, max) of jobs, seams and seam stages,\n"
+          "merged over all threads, plus the jobs/seams/pixels counters and the window in seconds.");
+    m.def("metrics_text", [] { return Metrics::export_text(Metrics::snapshot()); },
+          "The same metrics in the Prometheus text exposition format.");
+    m.def("reset_metrics", &Metrics::reset, "Zero all metrics; call while nothing is carving.");
+
+    py::class_<SeamCarving::RetargetIndex>(m, "RetargetIndex",
+                                           "O(log W) random access into the image retargeted to any width")
+        .def(py::init([](const OrderArray& order, int min_width) {
+                 SeamCarving::MatrixView<const int> view = order_view(order);
+                 check_order_entries(view);
+                 auto index = std::make_unique<SeamCarving::RetargetIndex>();
+                 py::gil_scoped_release release;
+                 index->build(view, min_width);
+                 return index;
+             }),
+             py::arg("order"), py::arg("min_width"))
+        .def("source_x", [](const SeamCarving::RetargetIndex& index, int y, int x, int width) {
+                 check_row(index, y);
+                 check_width(index, width);
+                 if (x < 0 || x >= width) {
+                     throw py::index_error("x out of range");
+                 }
+                 return index.source_x(y, x, width);
+             },
+             py::arg("y"), py::arg("x"), py::arg("width"))
+        .def("output_x", [](const SeamCarving::RetargetIndex& index, int y, int source, int width) {
+                 check_row(index, y);
+                 check_width(index, width);
+                 if (source < 0 || source >= index.width()) {
+                     throw py::index_error("source column out of range");
+                 }
+                 return index.output_x(y, source, width);
+             },
+             py::arg("y"), py::arg("source"), py::arg("width"),
+             "Output column of a source pixel, -1 when it is removed at this width")
+        .def("render", [](const SeamCarving::RetargetIndex& index, const ImageArray& image, int width,
+                          int x0, int y0, int tile_width, int tile_height) {
+                 SeamCarving::ImageView src = image_view(image);
+                 check_width(index, width);
+                 if (src.width != index.width() || src.height != index.height()) {
+                     throw py::value_error("image does not match the index");
+                 }
+                 if (tile_width < 1 || tile_height < 1) {
+                     throw py::value_error("tile size must be positive");
+                 }
+                 ImageArray tile = new_image(tile_width, tile_height, src.channels);
+                 SeamCarving::MutableImageView dst = mutable_image_view(tile);
+                 std::memset(dst.data, 0, static_cast<size_t>(tile_width) * tile_height * src.channels);
+                 {
+                     py::gil_scoped_release release;
+                     index.render(src, width, x0, y0, dst);
+                 }
+                 return tile;
+             },
+             py::arg("image"), py::arg("width"), py::arg("x0"), py::arg("y0"),
+             py::arg("tile_width"), py::arg("tile_height"),
+             "Tile [x0, x0 + tile_width) x [y0, y0 + tile_height) of the retargeted image;\n"
+             "pixels outside it are black")
+        .def_property_readonly("width", &SeamCarving::RetargetIndex::width)
+        .def_property_readonly("height", &SeamCarving::RetargetIndex::height)
+        .def_property_readonly("min_width", &SeamCarving::RetargetIndex::min_width)
+        .def_property_readonly("memory_bytes", &SeamCarving::RetargetIndex::memory_bytes);
+}
@@ -0,0 +1,206 @@
+#include "retarget_index.h"
+#include <algorithm>
+#include <cstring>
+#include <spdlog/spdlog.h>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace SeamCarving {
+
+namespace {
+
+    constexpr int kBlockBits = 256;  ///< Bits covered by one rank sample
+    constexpr int kWordsPerBlock = kBlockBits / 64;
+
+    inline int popcount64(std::uint64_t value) {
+#if defined(_MSC_VER)
+        return static_cast<int>(__popcnt64(value));
+#else
+        return __builtin_popcountll(value);
+#endif
+    }
+
+} // namespace
+
+void RetargetIndex::build(const MatrixView<const int>& order, int min_width) {
+    width_ = order.width;
+    height_ = order.height;
+    min_width_ = std::max(1, std::min(min_width, width_));
+    bits_ = 1;
+    while ((1 << bits_) < width_) {
+        bits_++;
+    }
+    words_per_level_ = (width_ + 63) / 64;
+    blocks_per_level_ = width_ / kBlockBits + 1;
+
+    size_t levels = static_cast<size_t>(height_) * bits_;
+    words_.assign(levels * words_per_level_, 0);
+    block_ranks_.assign(levels * blocks_per_level_, 0);
+    zeros_.assign(levels, 0);
+
+    int removed = width_ - min_width_;
+    std::vector<int> by_order(removed);
+    std::vector<int> current(width_);
+    std::vector<int> next(width_);
+
+    for (int y = 0; y < height_; y++) {
+        // Columns from last removed to first removed, never removed ones first
+        const int* row = order.row(y);
+        int n = 0;
+        std::fill(by_order.begin(), by_order.end(), -1);
+        for (int x = 0; x < width_; x++) {
+            if (row[x] >= removed) {
+                current[n++] = x;
+            } else if (row[x] >= 0) {
+                by_order[row[x]] = x;
+            }
+            // Negative entries name no seam; the column goes missing below
+        }
+        for (int i = removed - 1; i >= 0; i--) {
+            if (by_order[i] >= 0) {
+                current[n++] = by_order[i];
+            }
+        }
+        if (n != width_) {
+            spdlog::error("Seam order map row {} is inconsistent ({} of {} columns)", y, n, width_);
+            std::fill(current.begin() + n, current.end(), 0);
+        }
+
+        // One bit plane per level, most significant bit first; each level
+        // stably moves the zeros in front of the ones
+        for (int level = 0; level < bits_; level++) {
+            size_t li = level_index(y, level);
+            std::uint64_t* plane = words_.data() + li * words_per_level_;
+            int shift = bits_ - 1 - level;
+
+            int zeros = 0;
+            for (int i = 0; i < width_; i++) {
+                if ((current[i] >> shift) & 1) {
+                    plane[i >> 6] |= std::uint64_t(1) << (i & 63);
+                } else {
+                    zeros++;
+                }
+            }
+            zeros_[li] = zeros;
+
+            std::uint32_t* ranks = block_ranks_.data() + li * blocks_per_level_;
+            std::uint32_t ones = 0;
+            for (int block = 0; block < blocks_per_level_; block++) {
+                ranks[block] = ones;
+                for (int w = block * kWordsPerBlock; w < std::min((block + 1) * kWordsPerBlock, words_per_level_); w++) {
+                    ones += popcount64(plane[w]);
+                }
+            }
+
+            int zero_pos = 0;
+            int one_pos = zeros;
+            for (int i = 0; i < width_; i++) {
+                if ((current[i] >> shift) & 1) {
+                    next[one_pos++] = current[i];
+                } else {
+                    next[zero_pos++] = current[i];
+                }
+            }
+            current.swap(next);
+        }
+    }
+
+    spdlog::info("Retarget index built for {}x{} (widths {}..{}): {:.1f} MB, {:.2f} bits/pixel",
+                 width_, height_, min_width_, width_, memory_bytes() / (1024.0 * 1024.0),
+                 memory_bytes() * 8.0 / (static_cast<double>(width_) * height_));
+}
+
+size_t RetargetIndex::rank1(size_t li, int position) const {
+    const std::uint64_t* plane = words_.data() + li * words_per_level_;
+    int block = position / kBlockBits;
+    size_t ones = block_ranks_[li * blocks_per_level_ + block];
+    int word = position >> 6;
+    for (int w = block * kWordsPerBlock; w < word; w++) {
+        ones += popcount64(plane[w]);
+    }
+    if (position & 63) {
+        ones += popcount64(plane[word] & ((std::uint64_t(1) << (position & 63)) - 1));
+    }
+    return ones;
+}
+
+int RetargetIndex::count_less(int y, int prefix, int value) const {
+    if (value <= 0) {
+        return 0;
+    }
+    if (value >= (1 << bits_)) {
+        return prefix;
+    }
+
+    size_t start = 0;
+    size_t end = prefix;
+    int count = 0;
+    for (int level = 0; level < bits_; level++) {
+        size_t li = level_index(y, level);
+        size_t zeros_start = rank0(li, static_cast<int>(start));
+        size_t zeros_end = rank0(li, static_cast<int>(end));
+        if ((value >> (bits_ - 1 - level)) & 1) {
+            // Everything going left at this level is smaller than value
+            count += static_cast<int>(zeros_end - zeros_start);
+            start = zeros_[li] + (start - zeros_start);
+            end = zeros_[li] + (end - zeros_end);
+        } else {
+            start = zeros_start;
+            end = zeros_end;
+        }
+    }
+    return count;
+}
+
+int RetargetIndex::source_x(int y, int x, int width) const {
+    // x-th smallest column among the first `width` entries of the row
+    size_t start = 0;
+    size_t end = width;
+    int k = x;
+    int value = 0;
+    for (int level = 0; level < bits_; level++) {
+        size_t li = level_index(y, level);
+        size_t zeros_start = rank0(li, static_cast<int>(start));
+        size_t zeros_end = rank0(li, static_cast<int>(end));
+        int zeros_in_range = static_cast<int>(zeros_end - zeros_start);
+        if (k < zeros_in_range) {
+            start = zeros_start;
+            end = zeros_end;
+        } else {
+            k -= zeros_in_range;
+            start = zeros_[li] + (start - zeros_start);
+            end = zeros_[li] + (end - zeros_end);
+            value |= 1 << (bits_ - 1 - level);
+        }
+    }
+    return value;
+}
+
+int RetargetIndex::output_x(int y, int source, int width) const {
+    int before = count_less(y, width, source);
+    int through = count_less(y, width, source + 1);
+    return through > before ? before : -1;
+}
+
+void RetargetIndex::render(const ImageView& src, int width, int x0, int y0, const MutableImageView& tile) const {
+    int channels = src.channels;
+    int x_end = std::min(x0 + tile.width, width);
+    int y_end = std::min(y0 + tile.height, height_);
+    for (int y = std::max(y0, 0); y < y_end; y++) {
+        const unsigned char* in = src.row(y);
+        unsigned char* out = tile.row(y - y0);
+        for (int x = std::max(x0, 0); x < x_end; x++) {
+            std::memcpy(out + (x - x0) * channels, in + source_x(y, x, width) * channels, channels);
+        }
+    }
+}
+
+size_t RetargetIndex::memory_bytes() const {
+    return words_.capacity() * sizeof(std::uint64_t) +
+           block_ranks_.capacity() * sizeof(std::uint32_t) +
+           zeros_.capacity() * sizeof(std::uint32_t);
+}
+
+} // namespace SeamCarving
@@ -0,0 +1,97 @@
+#pragma once
+
+#include "seam_carving.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace SeamCarving {
+
+    /**
+     * @brief Random access into an image retargeted to any width
+     *
+     * Built once from a seam order map, it maps an output pixel at any width
+     * in [min_width, width] to its source pixel (and back) in O(log W) without
+     * materialising the carved image, so a server can render just the tiles a
+     * client asks for.
+     *
+     * Per row, the columns are listed from last removed to first removed (the
+     * never removed ones first); the columns kept at width w are exactly the
+     * first w entries. A wavelet matrix over that list answers "x-th smallest
+     * column among the first w" (select) and "columns below c among the first
+     * w" (rank). It takes about log2(W) * 1.125 bits per pixel, against 32 for
+     * the order map itself.
+     */
+    class RetargetIndex {
+    public:
+        RetargetIndex() = default;
+
+        /**
+         * Build the index.
+         *
+         * Time Complexity: O(width * height * log(width))
+         *
+         * @param order Seam order map from compute_seam_order()
+         * @param min_width Narrowest width the map describes (width minus the
+         *                  number of seams compute_seam_order() recorded)
+         */
+        void build(const MatrixView<const int>& order, int min_width);
+
+        /**
+         * Source column of an output pixel.
+         *
+         * @param y Row
+         * @param x Output column, in [0, width)
+         * @param width Retargeted width, in [min_width(), this->width()]
+         * @return Column in the original image
+         */
+        int source_x(int y, int x, int width) const;
+
+        /**
+         * Output column of a source pixel.
+         *
+         * @param y Row
+         * @param source Column in the original image
+         * @param width Retargeted width, in [min_width(), this->width()]
+         * @return Output column, or -1 when the pixel is removed at this width
+         */
+        int output_x(int y, int source, int width) const;
+
+        /**
+         * Render one tile of the retargeted image.
+         *
+         * @param src Original image
+         * @param width Retargeted width, in [min_width(), this->width()]
+         * @param x0 Left edge of the tile in output columns
+         * @param y0 Top edge of the tile
+         * @param tile Output view; the part outside the retargeted image is left untouched
+         */
+        void render(const ImageView& src, int width, int x0, int y0, const MutableImageView& tile) const;
+
+        int width() const { return width_; }
+        int height() const { return height_; }
+        int min_width() const { return min_width_; }
+        /// Heap memory held by the index
+        size_t memory_bytes() const;
+
+    private:
+        /// Bit plane of one level of row y
+        size_t level_index(int y, int level) const { return static_cast<size_t>(y) * bits_ + level; }
+        size_t rank1(size_t level_index, int position) const;
+        size_t rank0(size_t level_index, int position) const { return position - rank1(level_index, position); }
+        /// Number of values below `value` among the first `prefix` entries of row y
+        int count_less(int y, int prefix, int value) const;
+
+        int width_ = 0;
+        int height_ = 0;
+        int min_width_ = 0;
+        int bits_ = 0;              ///< Levels of the wavelet matrix, ceil(log2(width))
+        int words_per_level_ = 0;   ///< 64-bit words per bit plane
+        int blocks_per_level_ = 0;  ///< Rank samples per bit plane
+        std::vector<std::uint64_t> words_;
+        std::vector<std::uint32_t> block_ranks_;  ///< Ones before each 256-bit block
+        std::vector<std::uint32_t> zeros_;        ///< Zeros of each bit plane
+    };
+
+} // namespace SeamCarving
@@ -1,123 +1,582 @@
 #include "seam_carving.h"
+#include "cost_model.h"
+#include "metrics.h"
+#include "prefilter.h"
 #include <limits>
 #include <algorithm>
 #include <cmath>
 #include <chrono>
+#include <cstring>
 #include <spdlog/spdlog.h>
 
+// GCC and Clang compile the AVX2 DP row for x86 without -mavx2 and pick it at run time
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SEAM_CARVING_AVX2_DISPATCH 1
+#include <immintrin.h>
+#endif
+
 namespace SeamCarving {
 
-std::vector<int> find_low_energy_seam_greedy(
-    const std::vector<std::vector<float>>& energy, 
-    int width, 
-    int height
-) {
-    std::vector<int> seam(height);
-    
+namespace {
+
+    // Copy a vector-of-rows energy map into a flat buffer for the view-based API
+    std::vector<float> flatten(const std::vector<std::vector<float>>& energy, int width, int height) {
+        std::vector<float> flat(static_cast<size_t>(width) * height);
+        for (int y = 0; y < height; y++) {
+            std::copy(energy[y].begin(), energy[y].begin() + width, flat.begin() + static_cast<size_t>(y) * width);
+        }
+        return flat;
+    }
+
+    MatrixView<const float> packed_view(const std::vector<float>& data, int width, int height) {
+        return {data.data(), width, height, width};
+    }
+
+    template <typename Buffer>
+    void grow(Buffer& buffer, size_t size) {
+        if (buffer.size() < size) {
+            buffer.resize(size);
+        }
+    }
+
+    // Segment length of the checkpointed DP that minimizes the stored rows
+    int checkpoint_interval(int height) {
+        return std::max(1, static_cast<int>(std::ceil(std::sqrt(static_cast<double>(height)))));
+    }
+
+    int checkpointed_rows(int height, int interval) {
+        return (height - 1) / interval + 1 + interval;
+    }
+
+    // Floats of CarveBuffers::dp the DYNAMIC search needs in a given mode
+    size_t dp_elements(int width, int height, DpMemory mode) {
+        switch (mode) {
+            case DpMemory::BACKPOINTERS:
+                return 2 * static_cast<size_t>(width);
+            case DpMemory::CHECKPOINTED:
+                return static_cast<size_t>(width) * checkpointed_rows(height, checkpoint_interval(height));
+            case DpMemory::QUANTIZED:
+                return 0;
+            case DpMemory::FULL:
+            default:
+                return static_cast<size_t>(width) * height;
+        }
+    }
+
+    // One row of the DP recurrence: the cheapest of the (up to) three cells above plus the energy
+    void advance_dp_row(const float* above, const float* e, float* current, int width) {
+        for (int x = 0; x < width; x++) {
+            // Due to connectivity constraint, can only come from: (y-1, x-1), (y-1, x), (y-1, x+1)
+            float best = above[x];
+            if (x > 0) {
+                best = std::min(best, above[x - 1]);
+            }
+            if (x < width - 1) {
+                best = std::min(best, above[x + 1]);
+            }
+            current[x] = best + e[x];
+        }
+    }
+
+    int min_column(const float* row, int width) {
+        int min_x = 0;
+        for (int x = 1; x < width; x++) {
+            if (row[x] < row[min_x]) {
+                min_x = x;
+            }
+        }
+        return min_x;
+    }
+
+    // Column of `row` (the cumulative costs above) a seam at x continues from:
+    // straight up unless a diagonal is strictly cheaper, left before right
+    int backtrack_step(const float* row, int x, int width) {
+        int best_prev_x = x;
+        float best_prev_energy = row[x];
+        if (x > 0 && row[x - 1] < best_prev_energy) {
+            best_prev_energy = row[x - 1];
+            best_prev_x = x - 1;
+        }
+        if (x < width - 1 && row[x + 1] < best_prev_energy) {
+            best_prev_x = x + 1;
+        }
+        return best_prev_x;
+    }
+
+} // namespace
+
+void CarveBuffers::reserve(int width, int height, int channels) {
+    size_t pixel_count = static_cast<size_t>(width) * height;
+    grow(pixels, pixel_count * channels);
+    grow(energy, pixel_count);
+    grow(dp, dp_elements(width, height, dp_memory));
+    if (dp_memory == DpMemory::BACKPOINTERS) {
+        grow(steps, pixel_count);
+    }
+    if (dp_memory == DpMemory::QUANTIZED) {
+        grow(dp16, static_cast<size_t>(width + 2) * height);
+        grow(dp16_offsets, static_cast<size_t>(height));
+    }
+    grow(seam, static_cast<size_t>(height));
+}
+
+void CarveBuffers::set_dp_memory(DpMemory mode) {
+    if (mode == dp_memory) {
+        return;
+    }
+    dp_memory = mode;
+    Memory::LargeBuffer<float>().swap(dp);
+    Memory::LargeBuffer<std::int8_t>().swap(steps);
+    Memory::LargeBuffer<std::uint16_t>().swap(dp16);
+    std::vector<std::uint64_t>().swap(dp16_offsets);
+}
+
+std::size_t CarveBuffers::footprint(int width, int height, int channels, DpMemory dp_memory) {
+    size_t pixel_count = static_cast<size_t>(width) * height;
+    size_t bytes = pixel_count * channels + pixel_count * sizeof(float) +
+                   dp_elements(width, height, dp_memory) * sizeof(float) + static_cast<size_t>(height) * sizeof(int);
+    if (dp_memory == DpMemory::BACKPOINTERS) {
+        bytes += pixel_count * sizeof(std::int8_t);
+    }
+    if (dp_memory == DpMemory::QUANTIZED) {
+        bytes += static_cast<size_t>(width + 2) * height * sizeof(std::uint16_t) +
+                 static_cast<size_t>(height) * sizeof(std::uint64_t);
+    }
+    return bytes;
+}
+
+void find_low_energy_seam_greedy(const MatrixView<const float>& energy, int* seam) {
+    int width = energy.width;
+    int height = energy.height;
+
     // Start from the top row - find pixel with minimum energy
+    const float* top = energy.row(0);
     int min_x = 0;
-    float min_energy = energy[0][0];
+    float min_energy = top[0];
     for (int x = 1; x < width; x++) {
-        if (energy[0][x] < min_energy) {
-            min_energy = energy[0][x];
+        if (top[x] < min_energy) {
+            min_energy = top[x];
             min_x = x;
         }
     }
     seam[0] = min_x;
-    
+
     // For each subsequent row, choose the neighbor with minimum energy
     for (int y = 1; y < height; y++) {
+        const float* row = energy.row(y);
         int current_x = seam[y - 1];
         int best_x = current_x;
-        float best_energy = energy[y][current_x];
-        
+        float best_energy = row[current_x];
+
         // Check left neighbor
-        if (current_x > 0 && energy[y][current_x - 1] < best_energy) {
-            best_energy = energy[y][current_x - 1];
+        if (current_x > 0 && row[current_x - 1] < best_energy) {
+            best_energy = row[current_x - 1];
             best_x = current_x - 1;
         }
-        
+
         // Check right neighbor
-        if (current_x < width - 1 && energy[y][current_x + 1] < best_energy) {
-            best_energy = energy[y][current_x + 1];
+        if (current_x < width - 1 && row[current_x + 1] < best_energy) {
+            best_energy = row[current_x + 1];
             best_x = current_x + 1;
         }
-        
+
         seam[y] = best_x;
     }
-    
-    return seam;
 }
 
-std::vector<int> find_low_energy_seam_dyn(
-    const std::vector<std::vector<float>>& energy, 
-    int width, 
-    int height
+void find_low_energy_seam_dyn(
+    const MatrixView<const float>& energy,
+    const MatrixView<float>& dp,
+    int* seam
 ) {
-    // Step 1: Create DP table to store minimum cumulative energy to reach each pixel
-    std::vector<std::vector<float>> dp(height, std::vector<float>(width, std::numeric_limits<float>::max()));
-    
-    // Step 2: Initialize first row - cumulative energy equals pixel energy
-    for (int x = 0; x < width; x++) {
-        dp[0][x] = energy[0][x];
+    int width = energy.width;
+    int height = energy.height;
+
+    // Step 1: Initialize first row - cumulative energy equals pixel energy
+    std::copy(energy.row(0), energy.row(0) + width, dp.row(0));
+
+    // Step 2: Fill DP table row by row using recurrence relation
+    for (int y = 1; y < height; y++) {
+        advance_dp_row(dp.row(y - 1), energy.row(y), dp.row(y), width);
     }
-    
-    // Step 3: Fill DP table row by row using recurrence relation
+
+    // Step 3: Find the ending position with minimum cumulative energy in bottom row
+    seam[height - 1] = min_column(dp.row(height - 1), width);
+
+    // Step 4: Backtrack to reconstruct the optimal seam path
+    for (int y = height - 2; y >= 0; y--) {
+        seam[y] = backtrack_step(dp.row(y), seam[y + 1], width);
+    }
+}
+
+void find_low_energy_seam_dyn_backpointers(
+    const MatrixView<const float>& energy,
+    float* rows,
+    const MatrixView<std::int8_t>& steps,
+    int* seam
+) {
+    int width = energy.width;
+    int height = energy.height;
+    float* above = rows;
+    float* current = rows + width;
+    std::copy(energy.row(0), energy.row(0) + width, above);
+
+    // The step is chosen with backtrack_step()'s tie rules, so the seam
+    // matches the one read back from a full table
     for (int y = 1; y < height; y++) {
+        const float* e = energy.row(y);
+        std::int8_t* step = steps.row(y);
         for (int x = 0; x < width; x++) {
-            // Consider all possible previous positions that can reach current pixel (x, y)
-            // Due to connectivity constraint, can only come from: (y-1, x-1), (y-1, x), (y-1, x+1)
-            
-            // Can come from directly above: (y-1, x)
-            dp[y][x] = dp[y-1][x] + energy[y][x];
-            
-            // Can come from upper-left diagonal: (y-1, x-1)
-            if (x > 0) {
-                dp[y][x] = std::min(dp[y][x], dp[y-1][x-1] + energy[y][x]);
+            float best = above[x];
+            std::int8_t direction = 0;
+            if (x > 0 && above[x - 1] < best) {
+                best = above[x - 1];
+                direction = -1;
             }
-            
-            // Can come from upper-right diagonal: (y-1, x+1)  
-            if (x < width - 1) {
-                dp[y][x] = std::min(dp[y][x], dp[y-1][x+1] + energy[y][x]);
+            if (x < width - 1 && above[x + 1] < best) {
+                best = above[x + 1];
+                direction = 1;
             }
+            current[x] = best + e[x];
+            step[x] = direction;
         }
+        std::swap(above, current);
     }
-    
-    // Step 4: Find the ending position with minimum cumulative energy in bottom row
-    int min_end_x = 0;
-    float min_cumulative_energy = dp[height-1][0];
-    for (int x = 1; x < width; x++) {
-        if (dp[height-1][x] < min_cumulative_energy) {
-            min_cumulative_energy = dp[height-1][x];
-            min_end_x = x;
+
+    seam[height - 1] = min_column(above, width);
+    for (int y = height - 1; y > 0; y--) {
+        seam[y - 1] = seam[y] + steps.row(y)[seam[y]];
+    }
+}
+
+void find_low_energy_seam_dyn_checkpointed(
+    const MatrixView<const float>& energy,
+    const MatrixView<float>& rows,
+    int interval,
+    int* seam
+) {
+    int width = energy.width;
+    int height = energy.height;
+    int checkpoints = (height - 1) / interval + 1;
+    // Rows [0, checkpoints) hold DP rows 0, interval, 2 * interval, ...; the
+    // following `interval` rows are the segment being recomputed
+    auto checkpoint = [&](int index) { return rows.row(index); };
+    auto segment = [&](int offset) { return rows.row(checkpoints + offset); };
+
+    // Forward pass through two rolling segment rows, saving the checkpoints
+    std::copy(energy.row(0), energy.row(0) + width, checkpoint(0));
+    const float* above = checkpoint(0);
+    for (int y = 1; y < height; y++) {
+        float* current = y % interval == 0 ? checkpoint(y / interval) : segment(y % 2);
+        advance_dp_row(above, energy.row(y), current, width);
+        above = current;
+    }
+    seam[height - 1] = min_column(above, width);
+
+    // Backtrack segment by segment from the bottom; row y of a segment
+    // starting at y0 is at segment(y - y0), recomputed from checkpoint y0
+    for (int index = (height - 2) / interval; index >= 0; index--) {
+        int y0 = index * interval;
+        int y1 = std::min(y0 + interval, height - 1);  // rows [y0, y1) are backtracked through
+        std::copy(checkpoint(index), checkpoint(index) + width, segment(0));
+        for (int y = y0 + 1; y < y1; y++) {
+            advance_dp_row(segment(y - y0 - 1), energy.row(y), segment(y - y0), width);
+        }
+        for (int y = y1 - 1; y >= y0; y--) {
+            seam[y] = backtrack_step(segment(y - y0), seam[y + 1], width);
         }
     }
-    
-    // Step 5: Backtrack to reconstruct the optimal seam path
-    std::vector<int> seam(height);
-    seam[height-1] = min_end_x;  // Start from optimal ending position
-    
-    for (int y = height - 2; y >= 0; y--) {
-        int current_x = seam[y + 1];
-        int best_prev_x = current_x;
-        float best_prev_energy = dp[y][current_x];
-        
-        // Check which previous position led to current optimal path
-        // Left diagonal: (y, current_x - 1)
-        if (current_x > 0 && dp[y][current_x - 1] < best_prev_energy) {
-            best_prev_energy = dp[y][current_x - 1];
-            best_prev_x = current_x - 1;
-        }
-        
-        // Right diagonal: (y, current_x + 1)
-        if (current_x < width - 1 && dp[y][current_x + 1] < best_prev_energy) {
-            best_prev_energy = dp[y][current_x + 1];
-            best_prev_x = current_x + 1;
-        }
-        
-        seam[y] = best_prev_x;
+}
+
+namespace {
+
+    // Levels the cost bound of the 16-bit DP maps to. Rows are stored
+    // relative to the minimum of the row above, and a value saturates at
+    // 65535 levels above it; every path within the bound stays below that.
+    constexpr float kBoundLevels = 65000.0f;
+    // The first attempt quantizes kFinestStep times finer than that; each
+    // saturated attempt coarsens the step kCoarsening times
+    constexpr float kFinestStep = 64.0f;
+    constexpr float kCoarsening = 4.0f;
+
+    // Energies are truncated, so no path costs more levels than its energy
+    // over the quantum; the clamp keeps huge protection weights in range
+    std::uint16_t quantize(float energy, float scale) {
+        return static_cast<std::uint16_t>(std::min(std::max(energy * scale, 0.0f), 65535.0f));
     }
-    
+
+    /**
+     * One row of the 16-bit DP: out[x] = min(above[x-1..x+1]) - offset + q(e[x]),
+     * saturating. above and out point at column 0 with sentinels at -1 and
+     * width. Returns the row minimum.
+     */
+    std::uint16_t dp16_row_scalar(const float* e, const std::uint16_t* above, std::uint16_t* out,
+                                  int begin, int width, float scale, std::uint16_t offset) {
+        std::uint16_t row_min = 0xFFFF;
+        for (int x = begin; x < width; x++) {
+            std::uint16_t best = std::min({above[x - 1], above[x], above[x + 1]});
+            best = best > offset ? best - offset : 0;
+            std::uint32_t sum = static_cast<std::uint32_t>(best) + quantize(e[x], scale);
+            out[x] = static_cast<std::uint16_t>(std::min<std::uint32_t>(sum, 0xFFFF));
+            row_min = std::min(row_min, out[x]);
+        }
+        return row_min;
+    }
+
+    /**
+     * Cost of a cheap seam, an upper bound of the optimal one: the greedy
+     * seam or the cheapest of a few evenly spaced straight columns, whichever
+     * costs less. Sets the quantization step of the 16-bit DP; O(height).
+     *
+     * @param energy Energy matrix
+     * @param seam Output array of energy.height x-coordinates of that seam
+     * @return Its cost
+     */
+    float seam_cost_bound(const MatrixView<const float>& energy, int* seam) {
+        constexpr int kColumns = 16;
+        int width = energy.width;
+        int height = energy.height;
+        find_low_energy_seam_greedy(energy, seam);
+        double best = 0.0;
+        for (int y = 0; y < height; y++) {
+            best += energy.row(y)[seam[y]];
+        }
+        int best_column = -1;
+        for (int i = 0; i < std::min(kColumns, width); i++) {
+            int x = static_cast<int>((2 * i + 1) * static_cast<long long>(width) / (2 * std::min(kColumns, width)));
+            double cost = 0.0;
+            for (int y = 0; y < height && cost < best; y++) {
+                cost += energy.row(y)[x];
+            }
+            if (cost < best) {
+                best = cost;
+                best_column = x;
+            }
+        }
+        if (best_column >= 0) {
+            std::fill(seam, seam + height, best_column);
+        }
+        return static_cast<float>(best);
+    }
+
+#ifdef SEAM_CARVING_AVX2_DISPATCH
+    __attribute__((target("avx2")))
+    std::uint16_t dp16_row_avx2(const float* e, const std::uint16_t* above, std::uint16_t* out,
+                                int width, float scale, std::uint16_t offset) {
+        const __m256 vscale = _mm256_set1_ps(scale);
+        const __m256 vzero = _mm256_setzero_ps();
+        const __m256 vmax = _mm256_set1_ps(65535.0f);
+        const __m256i voffset = _mm256_set1_epi16(static_cast<short>(offset));
+        __m256i vmin = _mm256_set1_epi16(-1);
+        int x = 0;
+        for (; x + 16 <= width; x += 16) {
+            // Quantize 16 energies: clamp first so huge protection weights cannot overflow the conversion
+            __m256 lo = _mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(_mm256_loadu_ps(e + x), vscale), vzero), vmax);
+            __m256 hi = _mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(_mm256_loadu_ps(e + x + 8), vscale), vzero), vmax);
+            __m256i q = _mm256_packus_epi32(_mm256_cvttps_epi32(lo), _mm256_cvttps_epi32(hi));
+            q = _mm256_permute4x64_epi64(q, 0xD8);  // packus interleaves the 128-bit lanes
+
+            __m256i left = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(above + x - 1));
+            __m256i center = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(above + x));
+            __m256i right = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(above + x + 1));
+            __m256i best = _mm256_min_epu16(_mm256_min_epu16(left, center), right);
+            best = _mm256_adds_epu16(_mm256_subs_epu16(best, voffset), q);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + x), best);
+            vmin = _mm256_min_epu16(vmin, best);
+        }
+        __m128i halves = _mm_min_epu16(_mm256_castsi256_si128(vmin), _mm256_extracti128_si256(vmin, 1));
+        std::uint16_t row_min = static_cast<std::uint16_t>(_mm_cvtsi128_si32(_mm_minpos_epu16(halves)));
+        return std::min(row_min, dp16_row_scalar(e, above, out, x, width, scale, offset));
+    }
+
+    bool has_avx2() {
+        static const bool supported = __builtin_cpu_supports("avx2");
+        return supported;
+    }
+#endif
+
+    /**
+     * 16-bit DP seam search at one quantization scale.
+     *
+     * @param energy Energy matrix
+     * @param dp Cost table; see find_low_energy_seam_dyn16()
+     * @param row_offsets Output array of energy.height quantized offsets
+     * @param seam Output array of energy.height x-coordinates
+     * @param scale Levels per unit of energy
+     * @return True when no value along the seam saturated: it is then
+     *         optimal for the quantized energy (saturated values only
+     *         underestimate the paths through them)
+     */
+    bool dp16_search(const MatrixView<const float>& energy, const MatrixView<std::uint16_t>& dp,
+                     std::uint64_t* row_offsets, int* seam, float scale) {
+        int width = energy.width;
+        int height = energy.height;
+        // Logical column x of a DP row lives at x + 1, between two sentinels
+        auto row = [&](int y) { return dp.row(y) + 1; };
+
+        std::uint16_t* first = row(0);
+        first[-1] = first[width] = 0xFFFF;
+        std::uint16_t offset = 0xFFFF;
+        for (int x = 0; x < width; x++) {
+            first[x] = quantize(energy.row(0)[x], scale);
+            offset = std::min(offset, first[x]);
+        }
+
+        // Row y holds its costs minus the minima of rows 0..y-1
+        row_offsets[0] = 0;
+#ifdef SEAM_CARVING_AVX2_DISPATCH
+        bool avx2 = has_avx2();
+#endif
+        for (int y = 1; y < height; y++) {
+            std::uint16_t* out = row(y);
+            out[-1] = out[width] = 0xFFFF;
+            row_offsets[y] = row_offsets[y - 1] + offset;
+#ifdef SEAM_CARVING_AVX2_DISPATCH
+            if (avx2) {
+                offset = dp16_row_avx2(energy.row(y), row(y - 1), out, width, scale, offset);
+                continue;
+            }
+#endif
+            offset = dp16_row_scalar(energy.row(y), row(y - 1), out, 0, width, scale, offset);
+        }
+
+        const std::uint16_t* bottom = row(height - 1);
+        int end_x = static_cast<int>(std::min_element(bottom, bottom + width) - bottom);
+
+        // Backtrack as the float DP does; offsets are per row, so comparisons within a row are exact
+        seam[height - 1] = end_x;
+        for (int y = height - 2; y >= 0; y--) {
+            const std::uint16_t* values = row(y);
+            int x = seam[y + 1];
+            int best_x = x;
+            if (x > 0 && values[x - 1] < values[best_x]) {
+                best_x = x - 1;
+            }
+            if (x < width - 1 && values[x + 1] < values[best_x]) {
+                best_x = x + 1;
+            }
+            seam[y] = best_x;
+        }
+
+        // Without saturation the table holds the seam's quantized sum exactly
+        std::uint64_t levels = 0;
+        for (int y = 0; y < height; y++) {
+            levels += quantize(energy.row(y)[seam[y]], scale);
+        }
+        return levels == bottom[end_x] + row_offsets[height - 1];
+    }
+
+} // namespace
+
+float find_low_energy_seam_dyn16(
+    const MatrixView<const float>& energy,
+    const MatrixView<std::uint16_t>& dp,
+    std::uint64_t* row_offsets,
+    int* seam,
+    float quantum
+) {
+    if (quantum > 0.0f) {
+        dp16_search(energy, dp, row_offsets, seam, 1.0f / quantum);
+    } else {
+        float bound = seam_cost_bound(energy, seam);
+        if (bound <= 0.0f) {
+            return 0.0f;  // A free seam is optimal
+        }
+        // Start finer than the step that can never saturate the seam, and
+        // coarsen while the seam found runs through a saturated value
+        float safe = bound / kBoundLevels;
+        for (quantum = safe / kFinestStep;; quantum = std::min(quantum * kCoarsening, safe)) {
+            if (dp16_search(energy, dp, row_offsets, seam, 1.0f / quantum) || quantum >= safe) {
+                break;
+            }
+        }
+    }
+
+    // The quantized sum is truncated; the exact cost comes from the energies
+    double cost = 0.0;
+    for (int y = 0; y < energy.height; y++) {
+        cost += energy.row(y)[seam[y]];
+    }
+    return static_cast<float>(cost);
+}
+
+void find_low_energy_seam(
+    const MatrixView<const float>& energy,
+    const MatrixView<float>& dp,
+    int* seam,
+    Algorithm algorithm
+) {
+    switch (algorithm) {
+        case Algorithm::DYNAMIC:
+            find_low_energy_seam_dyn(energy, dp, seam);
+            break;
+        case Algorithm::GREEDY:
+        default:
+            find_low_energy_seam_greedy(energy, seam);
+            break;
+    }
+}
+
+void find_low_energy_seam(
+    const MatrixView<const float>& energy,
+    CarveBuffers& buffers,
+    int* seam,
+    Algorithm algorithm
+) {
+    int width = energy.width;
+    int height = energy.height;
+    if (algorithm == Algorithm::GREEDY) {
+        find_low_energy_seam_greedy(energy, seam);
+        return;
+    }
+
+    grow(buffers.dp, dp_elements(width, height, buffers.dp_memory));
+    switch (buffers.dp_memory) {
+        case DpMemory::QUANTIZED:
+            // Rows of width + 2: a sentinel column on either side
+            grow(buffers.dp16, static_cast<size_t>(width + 2) * height);
+            grow(buffers.dp16_offsets, static_cast<size_t>(height));
+            find_low_energy_seam_dyn16(energy, {buffers.dp16.data(), width, height, width + 2},
+                                       buffers.dp16_offsets.data(), seam);
+            break;
+        case DpMemory::BACKPOINTERS:
+            grow(buffers.steps, static_cast<size_t>(width) * height);
+            find_low_energy_seam_dyn_backpointers(energy, buffers.dp.data(),
+                                                  {buffers.steps.data(), width, height, width}, seam);
+            break;
+        case DpMemory::CHECKPOINTED: {
+            int interval = checkpoint_interval(height);
+            find_low_energy_seam_dyn_checkpointed(
+                energy, {buffers.dp.data(), width, checkpointed_rows(height, interval), width}, interval, seam);
+            break;
+        }
+        case DpMemory::FULL:
+        default:
+            find_low_energy_seam_dyn(energy, {buffers.dp.data(), width, height, width}, seam);
+            break;
+    }
+}
+
+std::vector<int> find_low_energy_seam_greedy(
+    const std::vector<std::vector<float>>& energy, 
+    int width, 
+    int height
+) {
+    std::vector<float> flat = flatten(energy, width, height);
+    std::vector<int> seam(height);
+    find_low_energy_seam_greedy(packed_view(flat, width, height), seam.data());
+    return seam;
+}
+
+std::vector<int> find_low_energy_seam_dyn(
+    const std::vector<std::vector<float>>& energy, 
+    int width, 
+    int height
+) {
+    std::vector<float> flat = flatten(energy, width, height);
+    std::vector<float> dp(flat.size());
+    std::vector<int> seam(height);
+    find_low_energy_seam_dyn(packed_view(flat, width, height), {dp.data(), width, height, width}, seam.data());
     return seam;
 }
 
@@ -137,37 +596,136 @@ std::vector<int> find_low_energy_seam(
     }
 }
 
+void calculate_energy(const ImageView& pixels, const MatrixView<float>& energy) {
+    int width = pixels.width;
+    int height = pixels.height;
+    int channels = pixels.channels;
+
+    // Sobel kernels
+    static const int sobel_x[3][3] = {{-1, 0, 1}, {-2, 0, 2}, {-1, 0, 1}};
+    static const int sobel_y[3][3] = {{-1, -2, -1}, {0, 0, 0}, {1, 2, 1}};
+
+    // Border rows and columns have no full neighbourhood
+    for (int y = 0; y < height; y++) {
+        float* row = energy.row(y);
+        if (y == 0 || y == height - 1) {
+            std::fill(row, row + width, 0.0f);
+        } else {
+            row[0] = 0.0f;
+            row[width - 1] = 0.0f;
+        }
+    }
+
+    for (int y = 1; y < height - 1; y++) {
+        float* out = energy.row(y);
+        for (int x = 1; x < width - 1; x++) {
+            float gx = 0, gy = 0;
+
+            // Apply Sobel kernels with proper convolution
+            for (int ky = -1; ky <= 1; ky++) {
+                const unsigned char* src = pixels.row(y + ky);
+                for (int kx = -1; kx <= 1; kx++) {
+                    const unsigned char* p = src + (x + kx) * channels;
+
+                    // Convert to grayscale
+                    float gray = 0.299f * p[0] + 0.587f * p[1] + 0.114f * p[2];
+
+                    gx += gray * sobel_x[ky + 1][kx + 1];
+                    gy += gray * sobel_y[ky + 1][kx + 1];
+                }
+            }
+
+            out[x] = std::sqrt(gx * gx + gy * gy);
+        }
+    }
+}
+
 std::vector<std::vector<float>> calculate_energy(
     const unsigned char* pixels, int width, int height, int channels) {
-  
-  std::vector<std::vector<float>> energy(height, std::vector<float>(width, 0.0f));
-  
-  // Sobel kernels
-  int sobel_x[3][3] = {{-1, 0, 1}, {-2, 0, 2}, {-1, 0, 1}};
-  int sobel_y[3][3] = {{-1, -2, -1}, {0, 0, 0}, {1, 2, 1}};
-  
-  for (int y = 1; y < height - 1; y++) {
-    for (int x = 1; x < width - 1; x++) {
-      float gx = 0, gy = 0;
-      
-      // Apply Sobel kernels with proper convolution
-      for (int ky = -1; ky <= 1; ky++) {
-        for (int kx = -1; kx <= 1; kx++) {
-          int idx = ((y + ky) * width + (x + kx)) * channels;
-          
-          // Convert to grayscale
-          float gray = 0.299f * pixels[idx] + 0.587f * pixels[idx + 1] + 0.114f * pixels[idx + 2];
-          
-          gx += gray * sobel_x[ky + 1][kx + 1];
-          gy += gray * sobel_y[ky + 1][kx + 1];
-        }
-      }
-      
-      energy[y][x] = sqrt(gx * gx + gy * gy);
-    }
-  }
-  
-  return energy;
+    std::vector<float> flat(static_cast<size_t>(width) * height);
+    calculate_energy(ImageView::packed(pixels, width, height, channels), {flat.data(), width, height, width});
+
+    std::vector<std::vector<float>> energy(height);
+    for (int y = 0; y < height; y++) {
+        energy[y].assign(flat.begin() + static_cast<size_t>(y) * width, flat.begin() + static_cast<size_t>(y + 1) * width);
+    }
+    return energy;
+}
+float find_low_energy_strip(
+    const MatrixView<const float>& energy,
+    int strip_width,
+    const MatrixView<float>& dp,
+    int* strip
+) {
+    int width = energy.width - strip_width + 1;
+    int height = energy.height;
+
+    // Row y of the DP holds the energy under each strip position plus the
+    // cheapest of the three positions above it
+    for (int y = 0; y < height; y++) {
+        const float* e = energy.row(y);
+        float* current = dp.row(y);
+        float sum = 0.0f;
+        for (int x = 0; x < strip_width - 1; x++) {
+            sum += e[x];
+        }
+        for (int x = 0; x < width; x++) {
+            sum += e[x + strip_width - 1];
+            current[x] = sum;
+            sum -= e[x];
+        }
+        if (y == 0) {
+            continue;
+        }
+        const float* above = dp.row(y - 1);
+        for (int x = 0; x < width; x++) {
+            float best = above[x];
+            if (x > 0) {
+                best = std::min(best, above[x - 1]);
+            }
+            if (x < width - 1) {
+                best = std::min(best, above[x + 1]);
+            }
+            current[x] += best;
+        }
+    }
+
+    const float* bottom = dp.row(height - 1);
+    int end_x = static_cast<int>(std::min_element(bottom, bottom + width) - bottom);
+    float cost = bottom[end_x];
+
+    strip[height - 1] = end_x;
+    for (int y = height - 2; y >= 0; y--) {
+        const float* row = dp.row(y);
+        int x = strip[y + 1];
+        int best_x = x;
+        if (x > 0 && row[x - 1] < row[best_x]) {
+            best_x = x - 1;
+        }
+        if (x < width - 1 && row[x + 1] < row[best_x]) {
+            best_x = x + 1;
+        }
+        strip[y] = best_x;
+    }
+    return cost;
+}
+
+void remove_seam(const ImageView& src, const int* seam, const MutableImageView& dst) {
+    int channels = src.channels;
+    size_t row_bytes = static_cast<size_t>(src.width) * channels;
+
+    for (int y = 0; y < src.height; y++) {
+        const unsigned char* in = src.row(y);
+        unsigned char* out = dst.row(y);
+        size_t seam_offset = static_cast<size_t>(seam[y]) * channels;
+
+        // Pixels left of the seam stay put; when compacting in place they already are
+        if (in != out) {
+            std::memcpy(out, in, seam_offset);
+        }
+        // Pixels right of the seam shift left by one (memmove handles the overlap)
+        std::memmove(out + seam_offset, in + seam_offset + channels, row_bytes - seam_offset - channels);
+    }
 }
 
 std::vector<unsigned char> remove_seam(
@@ -179,28 +737,611 @@ std::vector<unsigned char> remove_seam(
 ) {
     // Calculate new width and allocate memory for result
     int new_width = width - 1;
-    std::vector<unsigned char> result(new_width * height * channels);
-    
-    // For each row, copy pixels excluding the seam pixel
+    std::vector<unsigned char> result(static_cast<size_t>(new_width) * height * channels);
+    remove_seam(ImageView::packed(pixels, width, height, channels), seam.data(),
+                MutableImageView::packed(result.data(), new_width, height, channels));
+    return result;
+}
+
+namespace {
+
+    // Drop the seam element of every row of a plane, shifting the rest left in place
+    void remove_seam_in_place(unsigned char* data, std::ptrdiff_t stride, int width, int height,
+                              size_t element_size, const int* seam) {
+        size_t row_bytes = static_cast<size_t>(width) * element_size;
+        for (int y = 0; y < height; y++) {
+            unsigned char* row = data + y * stride;
+            size_t seam_offset = static_cast<size_t>(seam[y]) * element_size;
+            std::memmove(row + seam_offset, row + seam_offset + element_size, row_bytes - seam_offset - element_size);
+        }
+    }
+
+    // Drop strip_width elements from strip[y] on in every row of a plane, in place
+    void remove_strip_in_place(unsigned char* data, std::ptrdiff_t stride, int width, int height,
+                               size_t element_size, const int* strip, int strip_width) {
+        size_t row_bytes = static_cast<size_t>(width) * element_size;
+        size_t strip_bytes = static_cast<size_t>(strip_width) * element_size;
+        for (int y = 0; y < height; y++) {
+            unsigned char* row = data + y * stride;
+            size_t offset = static_cast<size_t>(strip[y]) * element_size;
+            std::memmove(row + offset, row + offset + strip_bytes, row_bytes - offset - strip_bytes);
+        }
+    }
+
+    // Attached planes that fit a carve from width x height to target_width, logging the others
+    std::vector<const AttachedPlane*> matching_planes(const AttachedPlane* planes, int plane_count,
+                                                      int width, int height, int target_width) {
+        std::vector<const AttachedPlane*> matching;
+        for (int i = 0; i < plane_count; i++) {
+            const AttachedPlane& plane = planes[i];
+            if (plane.src.width == width && plane.src.height == height && plane.src.channels > 0 &&
+                plane.dst.width == target_width && plane.dst.height == height &&
+                plane.dst.channels == plane.src.channels) {
+                matching.push_back(&plane);
+            } else {
+                spdlog::error("Attached plane {} ({}x{} -> {}x{}) does not match the {}x{} -> {}x{} carve, skipped",
+                              i, plane.src.width, plane.src.height, plane.dst.width, plane.dst.height,
+                              width, height, target_width, height);
+            }
+        }
+        return matching;
+    }
+
+    // Copy the pixels at ascending source columns, one memcpy per run of consecutive columns
+    void gather_columns(const unsigned char* in, const int* columns, int count, size_t pixel_bytes,
+                        unsigned char* out) {
+        int i = 0;
+        while (i < count) {
+            int run_start = i;
+            while (i + 1 < count && columns[i + 1] == columns[i] + 1) {
+                i++;
+            }
+            i++;
+            size_t run_bytes = static_cast<size_t>(i - run_start) * pixel_bytes;
+            std::memcpy(out, in + static_cast<size_t>(columns[run_start]) * pixel_bytes, run_bytes);
+            out += run_bytes;
+        }
+    }
+
+    /**
+     * Seam loop shared by reduce_width_iteratively() and compute_seam_order().
+     *
+     * When dst is given the last removal writes into it, otherwise the result
+     * stays in buffers.pixels. When order is given or planes are attached, the
+     * original column of each working pixel is tracked, so every removed pixel
+     * gets its seam index and the planes can be gathered once at the end.
+     * With stale_energy the energy map is computed once and compacted along
+     * with the pixels instead of being recomputed. With a positive sigma the
+     * energy of the blurred luma is used, updated around each removed seam.
+     *
+     * @return Width reached (target_width unless aborted)
+     */
+    int carve_seams(
+        const ImageView& src,
+        int target_width,
+        const MutableImageView* dst,
+        const MatrixView<int>* order,
+        const std::vector<const AttachedPlane*>& planes,
+        bool stale_energy,
+        float sigma,
+        CarveBuffers& buffers,
+        Algorithm algorithm,
+        const ProgressCallback& progress
+    ) {
+        int original_width = src.width;
+        int height = src.height;
+        int channels = src.channels;
+
+        buffers.reserve(original_width, height, channels);
+
+        // The working image keeps the original stride while it shrinks, so every
+        // removal after the first compacts rows in place.
+        std::ptrdiff_t work_stride = static_cast<std::ptrdiff_t>(original_width) * channels;
+        auto working = [&](int width) {
+            return MutableImageView{buffers.pixels.data(), width, height, channels, work_stride};
+        };
+
+        SmoothedEnergy* smoothed = nullptr;
+        if (sigma > 0.0f) {
+            if (!buffers.smoothed) {
+                buffers.smoothed = std::make_shared<SmoothedEnergy>();
+            }
+            smoothed = buffers.smoothed.get();
+        }
+
+        bool track_columns = order || !planes.empty();
+        if (track_columns) {
+            if (buffers.source_x.size() < static_cast<size_t>(original_width) * height) {
+                buffers.source_x.resize(static_cast<size_t>(original_width) * height);
+            }
+            for (int y = 0; y < height; y++) {
+                int* columns = buffers.source_x.data() + static_cast<size_t>(y) * original_width;
+                for (int x = 0; x < original_width; x++) {
+                    columns[x] = x;
+                }
+            }
+        }
+
+        int seams_to_remove = original_width - target_width;
+        int seams_removed = 0;
+        int current_width = original_width;
+
+        // Progress is logged every 10%; the ETA comes from the host cost model,
+        // corrected by how far off it was for the seams done so far. Logging
+        // never triggers the calibration; without a model the ETA is the
+        // average seam time so far.
+        int progress_update_interval = std::max(1, seams_to_remove / 10);
+        auto batch_start_time = std::chrono::high_resolution_clock::now();
+        const CostModel* model = CostModel::host_if_calibrated();
+        double predicted_total_ms =
+            model ? model->seam_loop_ms(original_width, height, seams_to_remove, algorithm, !stale_energy) : 0.0;
+
+        spdlog::info("Starting seam carving: removing {} seams from {}x{} image (predicted {:.0f}ms)",
+                     seams_to_remove, original_width, height, predicted_total_ms);
+
+        auto job_start = std::chrono::steady_clock::now();
+        auto finish_job = [&]() {
+            Metrics::record(Metrics::Latency::JOB, std::chrono::steady_clock::now() - job_start);
+            Metrics::add(Metrics::Counter::JOBS);
+            Metrics::add(Metrics::Counter::SEAMS, original_width - current_width);
+            Metrics::add(Metrics::Counter::PIXELS, static_cast<std::uint64_t>(original_width - current_width) * height);
+        };
+
+        // Iteratively remove seams until we reach target width
+        while (current_width > target_width) {
+            if (progress && !progress(seams_removed, seams_to_remove)) {
+                spdlog::info("Seam carving aborted after {}/{} seams", seams_removed, seams_to_remove);
+                finish_job();
+                return current_width;
+            }
+            seams_removed++;
+
+            if (seams_removed % progress_update_interval == 0 || seams_removed == seams_to_remove) {
+                auto current_time = std::chrono::high_resolution_clock::now();
+                double elapsed_ms = std::chrono::duration<double, std::milli>(current_time - batch_start_time).count();
+                double predicted_remaining_ms =
+                    model ? model->seam_loop_ms(current_width, height, current_width - target_width, algorithm,
+                                                !stale_energy)
+                          : elapsed_ms / seams_removed * (current_width - target_width);
+                double predicted_done_ms = predicted_total_ms - predicted_remaining_ms;
+                double correction = model && predicted_done_ms > 0.0 ? elapsed_ms / predicted_done_ms : 1.0;
+
+                spdlog::info("Progress: {}/{} seams removed ({}% complete) - {:.1f}ms/seam, ETA: {:.1f}s",
+                             seams_removed, seams_to_remove,
+                             static_cast<int>((seams_removed * 100.0) / seams_to_remove),
+                             elapsed_ms / seams_removed,
+                             predicted_remaining_ms * correction / 1000.0);
+            }
+
+            auto seam_start = std::chrono::steady_clock::now();
+
+            // The first seam reads straight from the source view, the last one
+            // writes straight into the destination; everything else is in place.
+            ImageView current = seams_removed == 1 ? src : ImageView(working(current_width));
+            MutableImageView next = (dst && current_width - 1 == target_width) ? *dst : working(current_width - 1);
+
+            // Stale energy keeps the original row stride so it can be compacted in place
+            MatrixView<float> energy{buffers.energy.data(), current_width, height,
+                                     stale_energy ? original_width : current_width};
+
+            // Calculate energy for current image state
+            if (smoothed) {
+                if (seams_removed == 1) {
+                    smoothed->compute(src, sigma, buffers.threads);
+                }
+                energy = smoothed->energy();
+            } else if (!stale_energy || seams_removed == 1) {
+                calculate_energy(current, energy);
+            }
+            auto energy_done = std::chrono::steady_clock::now();
+
+            // Find optimal seam to remove
+            find_low_energy_seam(energy, buffers, buffers.seam.data(), algorithm);
+            auto search_done = std::chrono::steady_clock::now();
+
+            if (track_columns) {
+                if (order) {
+                    for (int y = 0; y < height; y++) {
+                        int source = buffers.source_x[static_cast<size_t>(y) * original_width + buffers.seam[y]];
+                        order->row(y)[source] = seams_removed - 1;
+                    }
+                }
+                remove_seam_in_place(reinterpret_cast<unsigned char*>(buffers.source_x.data()),
+                                     static_cast<std::ptrdiff_t>(original_width) * sizeof(int),
+                                     current_width, height, sizeof(int), buffers.seam.data());
+            }
+
+            if (smoothed) {
+                smoothed->remove_seam(buffers.seam.data());
+            } else if (stale_energy) {
+                remove_seam_in_place(reinterpret_cast<unsigned char*>(energy.data),
+                                     energy.stride * static_cast<std::ptrdiff_t>(sizeof(float)),
+                                     current_width, height, sizeof(float), buffers.seam.data());
+            }
+
+            // Remove the seam from current image
+            remove_seam(current, buffers.seam.data(), next);
+            current_width--;
+
+            auto seam_done = std::chrono::steady_clock::now();
+            Metrics::record(Metrics::Latency::ENERGY, energy_done - seam_start);
+            Metrics::record(Metrics::Latency::SEAM_SEARCH, search_done - energy_done);
+            Metrics::record(Metrics::Latency::SEAM_REMOVAL, seam_done - search_done);
+            Metrics::record(Metrics::Latency::SEAM, seam_done - seam_start);
+
+            // Log detailed timing only for debug builds or when specifically enabled
+            if (spdlog::get_level() <= spdlog::level::debug) {
+                auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(seam_done - seam_start);
+                if (duration.count() > 50) { // Only log slow iterations
+                    spdlog::debug("Slow iteration {} took {}ms (width: {})", seams_removed, duration.count(), current_width + 1);
+                }
+            }
+        }
+
+        for (const AttachedPlane* plane : planes) {
+            size_t pixel_bytes = static_cast<size_t>(plane->src.channels);
+            for (int y = 0; y < height; y++) {
+                gather_columns(plane->src.row(y), buffers.source_x.data() + static_cast<size_t>(y) * original_width,
+                               current_width, pixel_bytes, plane->dst.row(y));
+            }
+        }
+
+        finish_job();
+        spdlog::info("Seam carving completed: final image size {}x{}", current_width, height);
+
+        return current_width;
+    }
+
+} // namespace
+
+int reduce_width_iteratively(
+    const ImageView& src,
+    const MutableImageView& dst,
+    CarveBuffers& buffers,
+    Algorithm algorithm,
+    const ProgressCallback& progress
+) {
+    if (dst.width <= 0) {
+        // Invalid target width
+        return 0;
+    }
+    if (dst.width >= src.width) {
+        // No reduction needed, copy the original
+        for (int y = 0; y < src.height; y++) {
+            std::memcpy(dst.row(y), src.row(y), static_cast<size_t>(src.width) * src.channels);
+        }
+        return src.width;
+    }
+    return carve_seams(src, dst.width, &dst, nullptr, {}, false, 0.0f, buffers, algorithm, progress);
+}
+
+int reduce_width_iteratively(
+    const ImageView& src,
+    const MutableImageView& dst,
+    const AttachedPlane* planes,
+    int plane_count,
+    CarveBuffers& buffers,
+    Algorithm algorithm,
+    const ProgressCallback& progress
+) {
+    if (dst.width <= 0) {
+        // Invalid target width
+        return 0;
+    }
+    int target_width = std::min(dst.width, src.width);
+    std::vector<const AttachedPlane*> matching = matching_planes(planes, plane_count, src.width, src.height, target_width);
+    if (dst.width >= src.width) {
+        reduce_width_iteratively(src, dst, buffers, algorithm, progress);
+        for (const AttachedPlane* plane : matching) {
+            for (int y = 0; y < src.height; y++) {
+                std::memcpy(plane->dst.row(y), plane->src.row(y), static_cast<size_t>(src.width) * plane->src.channels);
+            }
+        }
+        return src.width;
+    }
+    return carve_seams(src, dst.width, &dst, nullptr, matching, false, 0.0f, buffers, algorithm, progress);
+}
+
+int reduce_width_approximate(
+    const ImageView& src,
+    const MutableImageView& dst,
+    CarveBuffers& buffers,
+    Algorithm algorithm,
+    const ProgressCallback& progress
+) {
+    if (dst.width <= 0) {
+        // Invalid target width
+        return 0;
+    }
+    if (dst.width >= src.width) {
+        return reduce_width_iteratively(src, dst, buffers, algorithm, progress);
+    }
+    return carve_seams(src, dst.width, &dst, nullptr, {}, true, 0.0f, buffers, algorithm, progress);
+}
+
+int reduce_width_smoothed(
+    const ImageView& src,
+    const MutableImageView& dst,
+    float sigma,
+    CarveBuffers& buffers,
+    Algorithm algorithm,
+    const ProgressCallback& progress
+) {
+    if (dst.width <= 0) {
+        // Invalid target width
+        return 0;
+    }
+    if (dst.width >= src.width) {
+        return reduce_width_iteratively(src, dst, buffers, algorithm, progress);
+    }
+    return carve_seams(src, dst.width, &dst, nullptr, {}, false, sigma, buffers, algorithm, progress);
+}
+
+int reduce_width_strips(
+    const ImageView& src,
+    const MutableImageView& dst,
+    CarveBuffers& buffers,
+    int max_strip_width,
+    const ProgressCallback& progress
+) {
+    // A strip may cost this much more per column than the best single seam
+    constexpr float kStripTolerance = 0.25f;
+    // ... plus this much energy per row: a slope of one grey level per pixel
+    // (Sobel 8) counts as flat, so backgrounds are removed in wide strips
+    constexpr float kFlatEnergy = 8.0f;
+
+    if (dst.width <= 0) {
+        // Invalid target width
+        return 0;
+    }
+    if (dst.width >= src.width) {
+        return reduce_width_iteratively(src, dst, buffers, Algorithm::DYNAMIC, progress);
+    }
+    int original_width = src.width;
+    int height = src.height;
+    int channels = src.channels;
+    max_strip_width = std::max(1, std::min(max_strip_width, 8));
+    buffers.reserve(original_width, height, channels);
+    // Strips search a full cost table whatever buffers.dp_memory says
+    grow(buffers.dp, static_cast<size_t>(original_width) * height);
+    std::vector<int> candidate(height);
+
+    std::ptrdiff_t work_stride = static_cast<std::ptrdiff_t>(original_width) * channels;
     for (int y = 0; y < height; y++) {
-        int seam_x = seam[y];
-        int result_idx = 0;
-        
-        for (int x = 0; x < width; x++) {
-            if (x != seam_x) {
-                // Copy pixel to new image
-                int src_idx = (y * width + x) * channels;
-                int dst_idx = (y * new_width + result_idx) * channels;
-                
-                for (int c = 0; c < channels; c++) {
-                    result[dst_idx + c] = pixels[src_idx + c];
+        std::memcpy(buffers.pixels.data() + y * work_stride, src.row(y), static_cast<size_t>(original_width) * channels);
+    }
+
+    int total = original_width - dst.width;
+    int width = original_width;
+    int passes = 0;
+    int previous_strip = max_strip_width;
+    auto start_time = std::chrono::steady_clock::now();
+    auto finish_job = [&]() {
+        Metrics::record(Metrics::Latency::JOB, std::chrono::steady_clock::now() - start_time);
+        Metrics::add(Metrics::Counter::JOBS);
+        Metrics::add(Metrics::Counter::SEAMS, original_width - width);
+        Metrics::add(Metrics::Counter::PIXELS, static_cast<std::uint64_t>(original_width - width) * height);
+    };
+    while (width > dst.width) {
+        if (progress && !progress(original_width - width, total)) {
+            spdlog::info("Strip carving aborted after {}/{} columns", original_width - width, total);
+            finish_job();
+            return width;
+        }
+
+        // A pass counts as one seam, however wide its strip
+        auto seam_start = std::chrono::steady_clock::now();
+        ImageView working{buffers.pixels.data(), width, height, channels, work_stride};
+        MatrixView<float> energy{buffers.energy.data(), width, height, width};
+        calculate_energy(working, energy);
+        auto energy_done = std::chrono::steady_clock::now();
+
+        // The single seam sets the bar; wider strips are tried from twice the
+        // last accepted width down, so detailed regions cost few extra passes
+        int* strip = buffers.seam.data();
+        int strip_width = 1;
+        auto dp_for = [&](int s) { return MatrixView<float>{buffers.dp.data(), width - s + 1, height, width - s + 1}; };
+        float seam_cost = find_low_energy_strip(energy, 1, dp_for(1), strip);
+        float bar = seam_cost * (1.0f + kStripTolerance) + kFlatEnergy * height;
+        int widest = std::min({max_strip_width, 2 * previous_strip, width - dst.width});
+        for (int s = widest; s >= 2; s /= 2) {
+            float cost = find_low_energy_strip(energy, s, dp_for(s), candidate.data());
+            if (cost <= bar * s) {
+                std::copy(candidate.begin(), candidate.end(), strip);
+                strip_width = s;
+                break;
+            }
+        }
+        previous_strip = strip_width;
+        auto search_done = std::chrono::steady_clock::now();
+
+        remove_strip_in_place(buffers.pixels.data(), work_stride, width, height, channels, strip, strip_width);
+        width -= strip_width;
+        passes++;
+
+        auto seam_done = std::chrono::steady_clock::now();
+        Metrics::record(Metrics::Latency::ENERGY, energy_done - seam_start);
+        Metrics::record(Metrics::Latency::SEAM_SEARCH, search_done - energy_done);
+        Metrics::record(Metrics::Latency::SEAM_REMOVAL, seam_done - search_done);
+        Metrics::record(Metrics::Latency::SEAM, seam_done - seam_start);
+    }
+
+    for (int y = 0; y < height; y++) {
+        std::memcpy(dst.row(y), buffers.pixels.data() + y * work_stride, static_cast<size_t>(width) * channels);
+    }
+    finish_job();
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - start_time);
+    spdlog::info("Strip carving completed: {} columns in {} passes ({:.1f} per pass), {}ms",
+                 total, passes, static_cast<double>(total) / passes, elapsed.count());
+    return width;
+}
+
+int compute_seam_order(
+    const ImageView& src,
+    int min_width,
+    const MatrixView<int>& order,
+    CarveBuffers& buffers,
+    Algorithm algorithm,
+    const ProgressCallback& progress
+) {
+    for (int y = 0; y < src.height; y++) {
+        std::fill(order.row(y), order.row(y) + src.width, kNeverRemoved);
+    }
+    min_width = std::max(1, min_width);
+    if (min_width >= src.width) {
+        return 0;
+    }
+    int reached = carve_seams(src, min_width, nullptr, &order, {}, false, 0.0f, buffers, algorithm, progress);
+    return src.width - reached;
+}
+
+int compute_seam_order_from_energy(
+    const MatrixView<const float>& energy,
+    int min_width,
+    const MatrixView<int>& order,
+    CarveBuffers& buffers,
+    Algorithm algorithm,
+    const ProgressCallback& progress
+) {
+    int original_width = energy.width;
+    int height = energy.height;
+    for (int y = 0; y < height; y++) {
+        std::fill(order.row(y), order.row(y) + original_width, kNeverRemoved);
+    }
+    min_width = std::max(1, min_width);
+    if (min_width >= original_width) {
+        return 0;
+    }
+
+    // Working copies of the energy and of the original column of each entry,
+    // both compacted in place with the original stride
+    size_t cells = static_cast<size_t>(original_width) * height;
+    buffers.reserve(original_width, height, 1);
+    if (buffers.source_x.size() < cells) {
+        buffers.source_x.resize(cells);
+    }
+    for (int y = 0; y < height; y++) {
+        std::copy(energy.row(y), energy.row(y) + original_width, buffers.energy.data() + y * static_cast<size_t>(original_width));
+        int* columns = buffers.source_x.data() + y * static_cast<size_t>(original_width);
+        for (int x = 0; x < original_width; x++) {
+            columns[x] = x;
+        }
+    }
+
+    int seams = 0;
+    auto job_start = std::chrono::steady_clock::now();
+    for (int width = original_width; width > min_width; width--, seams++) {
+        if (progress && !progress(seams, original_width - min_width)) {
+            break;
+        }
+        auto seam_start = std::chrono::steady_clock::now();
+        MatrixView<float> working{buffers.energy.data(), width, height, original_width};
+        find_low_energy_seam(working, buffers, buffers.seam.data(), algorithm);
+        auto search_done = std::chrono::steady_clock::now();
+        for (int y = 0; y < height; y++) {
+            order.row(y)[buffers.source_x[y * static_cast<size_t>(original_width) + buffers.seam[y]]] = seams;
+        }
+        remove_seam_in_place(reinterpret_cast<unsigned char*>(buffers.energy.data()),
+                             static_cast<std::ptrdiff_t>(original_width) * sizeof(float),
+                             width, height, sizeof(float), buffers.seam.data());
+        remove_seam_in_place(reinterpret_cast<unsigned char*>(buffers.source_x.data()),
+                             static_cast<std::ptrdiff_t>(original_width) * sizeof(int),
+                             width, height, sizeof(int), buffers.seam.data());
+
+        auto seam_done = std::chrono::steady_clock::now();
+        Metrics::record(Metrics::Latency::SEAM_SEARCH, search_done - seam_start);
+        Metrics::record(Metrics::Latency::SEAM_REMOVAL, seam_done - search_done);
+        Metrics::record(Metrics::Latency::SEAM, seam_done - seam_start);
+    }
+    Metrics::record(Metrics::Latency::JOB, std::chrono::steady_clock::now() - job_start);
+    Metrics::add(Metrics::Counter::JOBS);
+    Metrics::add(Metrics::Counter::SEAMS, seams);
+    Metrics::add(Metrics::Counter::PIXELS, static_cast<std::uint64_t>(seams) * height);
+    return seams;
+}
+
+void carve_from_coarse_order(
+    const ImageView& src,
+    const MatrixView<const int>& coarse_order,
+    int factor_x,
+    int factor_y,
+    const MutableImageView& dst
+) {
+    int removed = src.width - dst.width;
+    int channels = src.channels;
+    for (int y = 0; y < src.height; y++) {
+        const int* orders = coarse_order.row(std::min(y / factor_y, coarse_order.height - 1));
+        const unsigned char* in = src.row(y);
+        unsigned char* out = dst.row(y);
+        for (int x = 0; x < src.width; x++) {
+            int cx = x / factor_x;
+            bool keep = cx >= coarse_order.width || orders[cx] == kNeverRemoved ||
+                        orders[cx] * factor_x + x % factor_x >= removed;
+            if (keep) {
+                std::memcpy(out, in + static_cast<size_t>(x) * channels, channels);
+                out += channels;
+            }
+        }
+    }
+}
+
+void build_carve_lookup(const MatrixView<const int>& order, const MatrixView<int>& lookup) {
+    int removed = order.width - lookup.width;
+    for (int y = 0; y < order.height; y++) {
+        const int* row = order.row(y);
+        int* out = lookup.row(y);
+        int n = 0;
+        for (int x = 0; x < order.width && n < lookup.width; x++) {
+            if (row[x] >= removed) {
+                out[n++] = x;
+            }
+        }
+    }
+}
+
+void carve_from_order(const ImageView& src, const MatrixView<const int>& order, const MutableImageView& dst) {
+    carve_from_order(src, order, dst, nullptr, 0);
+}
+
+void carve_from_order(
+    const ImageView& src,
+    const MatrixView<const int>& order,
+    const MutableImageView& dst,
+    const AttachedPlane* planes,
+    int plane_count
+) {
+    int removed = src.width - dst.width;
+    std::vector<const AttachedPlane*> matching = matching_planes(planes, plane_count, src.width, src.height, dst.width);
+    auto copy_run = [](const ImageView& in, const MutableImageView& out, int y, int from, int to, int count) {
+        size_t pixel_bytes = static_cast<size_t>(in.channels);
+        std::memcpy(out.row(y) + to * pixel_bytes, in.row(y) + from * pixel_bytes, count * pixel_bytes);
+    };
+
+    for (int y = 0; y < src.height; y++) {
+        const int* row = order.row(y);
+
+        // Removed pixels are sparse, so copy the kept runs between them
+        int out_x = 0;
+        int x = 0;
+        while (x < src.width) {
+            int run_start = x;
+            while (x < src.width && row[x] >= removed) {
+                x++;
+            }
+            int run = x - run_start;
+            if (run > 0) {
+                copy_run(src, dst, y, run_start, out_x, run);
+                for (const AttachedPlane* plane : matching) {
+                    copy_run(plane->src, plane->dst, y, run_start, out_x, run);
                 }
-                result_idx++;
+                out_x += run;
+            }
+            while (x < src.width && row[x] < removed) {
+                x++;
             }
         }
     }
-    
-    return result;
 }
 
 std::pair<std::vector<unsigned char>, int> reduce_width_iteratively(
@@ -209,7 +1350,8 @@ std::pair<std::vector<unsigned char>, int> reduce_width_iteratively(
     int height,
     int channels,
     int target_width,
-    Algorithm algorithm
+    Algorithm algorithm,
+    const ProgressCallback& progress
 ) {
     if (target_width >= original_width) {
         // No reduction needed, return copy of original
@@ -222,63 +1364,27 @@ std::pair<std::vector<unsigned char>, int> reduce_width_iteratively(
         std::vector<unsigned char> empty;
         return std::make_pair(empty, 0);
     }
-    
-    // Start with copy of original image
-    std::vector<unsigned char> current_pixels(pixels, pixels + (original_width * height * channels));
-    int current_width = original_width;
-    
-    int seams_to_remove = original_width - target_width;
-    int seams_removed = 0;
-      
-    // Progress tracking variables
-    int progress_update_interval = std::max(1, seams_to_remove / 10); // Update every 10% or at least every seam
-    auto batch_start_time = std::chrono::high_resolution_clock::now();
-      
-    spdlog::info("Starting seam carving: removing {} seams from {}x{} image", 
-                 seams_to_remove, original_width, height);
-      
-    // Iteratively remove seams until we reach target width
-    while (current_width > target_width) {
-        seams_removed++;
-        
-        if (seams_removed % progress_update_interval == 0 || seams_removed == seams_to_remove) {
-            auto current_time = std::chrono::high_resolution_clock::now();
-            auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(current_time - batch_start_time);
-            float avg_time_per_seam = static_cast<float>(elapsed.count()) / seams_removed;
-            int estimated_remaining_ms = static_cast<int>((seams_to_remove - seams_removed) * avg_time_per_seam);
-            
-            spdlog::info("Progress: {}/{} seams removed ({}% complete) - Avg: {:.1f}ms/seam, ETA: {}s", 
-                         seams_removed, seams_to_remove,
-                         static_cast<int>((seams_removed * 100.0) / seams_to_remove),
-                         avg_time_per_seam,
-                         estimated_remaining_ms / 1000);
-        }
-        
-        auto start_time = std::chrono::high_resolution_clock::now();
-        
-        // Calculate energy for current image state
-        auto energy = calculate_energy(current_pixels.data(), current_width, height, channels);
-        
-        // Find optimal seam to remove
-        auto seam = find_low_energy_seam(energy, current_width, height, algorithm);
-        
-        // Remove the seam from current image
-        current_pixels = remove_seam(current_pixels.data(), current_width, height, channels, seam);
-        current_width--;
-        
-        // Log detailed timing only for debug builds or when specifically enabled
-        if (spdlog::get_level() <= spdlog::level::debug) {
-            auto end_time = std::chrono::high_resolution_clock::now();
-            auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time);
-            if (duration.count() > 50) { // Only log slow iterations
-                spdlog::debug("Slow iteration {} took {}ms (width: {})", seams_removed, duration.count(), current_width + 1);
-            }
-        }
+
+    ImageView src = ImageView::packed(pixels, original_width, height, channels);
+    std::vector<unsigned char> result(static_cast<size_t>(target_width) * height * channels);
+    CarveBuffers buffers;
+    int reached = reduce_width_iteratively(
+        src, MutableImageView::packed(result.data(), target_width, height, channels),
+        buffers, algorithm, progress);
+    if (reached == target_width) {
+        return std::make_pair(result, target_width);
     }
-    
-    spdlog::info("Seam carving completed: final image size {}x{}", current_width, height);
-    
-    return std::make_pair(current_pixels, current_width);
+
+    // Aborted: hand back the partially carved image
+    ImageView partial = reached == original_width
+        ? src
+        : ImageView{buffers.pixels.data(), reached, height, channels, static_cast<std::ptrdiff_t>(original_width) * channels};
+    result.resize(static_cast<size_t>(reached) * height * channels);
+    for (int y = 0; y < height; y++) {
+        std::memcpy(result.data() + static_cast<size_t>(y) * reached * channels, partial.row(y),
+                    static_cast<size_t>(reached) * channels);
+    }
+    return std::make_pair(result, reached);
 }
 
 } // namespace SeamCarving
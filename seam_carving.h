@@ -1,5 +1,13 @@
 #pragma once
 
+#include "huge_pages.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <type_traits>
 #include <vector>
 
 /**
@@ -7,6 +15,8 @@
  */
 namespace SeamCarving {
 
+    class SmoothedEnergy;
+
     /**
      * @brief Available seam finding algorithms
      */
@@ -15,6 +25,175 @@ namespace SeamCarving {
         DYNAMIC     ///< Optimal dynamic programming approach (global optimum)
     };
 
+    /**
+     * @brief How the DYNAMIC seam search stores its cost table
+     *
+     * The float modes find the same seam; the smaller ones trade time for
+     * memory when several large jobs share a memory budget (see
+     * memory_governor.h). QUANTIZED trades exactness for speed instead.
+     */
+    enum class DpMemory {
+        FULL,          ///< Cumulative cost of every pixel (4 bytes per pixel)
+        BACKPOINTERS,  ///< Two rolling cost rows and a 1-byte step per pixel
+        CHECKPOINTED,  ///< Every k-th cost row, k ~ sqrt(height); rows in between are recomputed (~2x time)
+        QUANTIZED      ///< 16-bit costs of every pixel (2 bytes per pixel); near-optimal seam, see find_low_energy_seam_dyn16()
+    };
+
+    /**
+     * Progress callback for long running operations.
+     *
+     * Receives (seams removed so far, total seams to remove) before each seam;
+     * returning false aborts the operation.
+     */
+    using ProgressCallback = std::function<bool(int, int)>;
+
+    /**
+     * @brief Non-owning view of a 2D matrix with a row stride
+     *
+     * Used for energy maps and DP tables so callers can pass pooled buffers or a
+     * window into a larger matrix.
+     */
+    template <typename T>
+    struct MatrixView {
+        T* data = nullptr;
+        int width = 0;
+        int height = 0;
+        std::ptrdiff_t stride = 0;  ///< Elements from the start of one row to the next
+
+        T* row(int y) const { return data + static_cast<std::ptrdiff_t>(y) * stride; }
+
+        /// Read-only view of the same memory
+        template <typename U = T, typename = typename std::enable_if<!std::is_const<U>::value>::type>
+        operator MatrixView<const U>() const { return {data, width, height, stride}; }
+    };
+
+    /**
+     * @brief Non-owning read-only view of interleaved 8-bit pixels with a row stride
+     *
+     * A sub-rectangle of a larger frame is just a view with an offset data
+     * pointer and the frame's stride, so it can be carved without copying it out.
+     */
+    struct ImageView {
+        const unsigned char* data = nullptr;
+        int width = 0;
+        int height = 0;
+        int channels = 0;
+        std::ptrdiff_t stride = 0;  ///< Bytes from the start of one row to the next
+
+        const unsigned char* row(int y) const { return data + static_cast<std::ptrdiff_t>(y) * stride; }
+
+        /// View of a tightly packed buffer
+        static ImageView packed(const unsigned char* data, int width, int height, int channels) {
+            return {data, width, height, channels, static_cast<std::ptrdiff_t>(width) * channels};
+        }
+
+        /// View of the rectangle [x, x + w) x [y, y + h) inside this view
+        ImageView sub_view(int x, int y, int w, int h) const {
+            return {row(y) + static_cast<std::ptrdiff_t>(x) * channels, w, h, channels, stride};
+        }
+    };
+
+    /**
+     * @brief Non-owning writable view of interleaved 8-bit pixels with a row stride
+     */
+    struct MutableImageView {
+        unsigned char* data = nullptr;
+        int width = 0;
+        int height = 0;
+        int channels = 0;
+        std::ptrdiff_t stride = 0;  ///< Bytes from the start of one row to the next
+
+        unsigned char* row(int y) const { return data + static_cast<std::ptrdiff_t>(y) * stride; }
+
+        /// View of a tightly packed buffer
+        static MutableImageView packed(unsigned char* data, int width, int height, int channels) {
+            return {data, width, height, channels, static_cast<std::ptrdiff_t>(width) * channels};
+        }
+
+        /// View of the rectangle [x, x + w) x [y, y + h) inside this view
+        MutableImageView sub_view(int x, int y, int w, int h) const {
+            return {row(y) + static_cast<std::ptrdiff_t>(x) * channels, w, h, channels, stride};
+        }
+
+        operator ImageView() const { return {data, width, height, channels, stride}; }
+    };
+
+    /**
+     * @brief Scratch memory for the allocation-free API
+     *
+     * Buffers grow to the largest image seen and are reused afterwards, so a
+     * server keeping one CarveBuffers per worker allocates nothing per request.
+     * Image-sized buffers are backed by huge pages (see Memory::HugePageMode).
+     */
+    struct CarveBuffers {
+        Memory::LargeBuffer<unsigned char> pixels;  ///< Working copy of the image being carved
+        Memory::LargeBuffer<float> energy;
+        Memory::LargeBuffer<float> dp;
+        Memory::LargeBuffer<int> source_x;          ///< Original column of each working pixel (seam order only)
+        Memory::LargeBuffer<unsigned char> staging; ///< Intermediate image of multi-stage modes (see QualityMode)
+        Memory::LargeBuffer<int> order;             ///< Intermediate seam order map of multi-stage modes
+        std::shared_ptr<SmoothedEnergy> smoothed;   ///< Blurred energy maps (prefilter.h), created on first use
+        Memory::LargeBuffer<std::int8_t> steps;     ///< DP step of every pixel (DpMemory::BACKPOINTERS)
+        Memory::LargeBuffer<std::uint16_t> dp16;    ///< 16-bit cost table with sentinel columns (DpMemory::QUANTIZED)
+        std::vector<std::uint64_t> dp16_offsets;    ///< Per-row offsets of dp16 (DpMemory::QUANTIZED)
+        std::vector<int> seam;
+        DpMemory dp_memory = DpMemory::FULL;        ///< Storage of the DYNAMIC search, see set_dp_memory()
+        int threads = 1;                            ///< Threads of the full-image passes (the blur of reduce_width_smoothed)
+
+        /// Grow the buffers for an image of the given size (never shrinks)
+        void reserve(int width, int height, int channels);
+
+        /**
+         * Switch the DP storage, releasing the tables of the previous mode.
+         *
+         * Safe between seams, e.g. from a progress callback: the next seam
+         * search allocates what the new mode needs.
+         */
+        void set_dp_memory(DpMemory mode);
+
+        /**
+         * Bytes reserve() allocates for an image (pixels, energy and DP storage).
+         *
+         * @param width Image width
+         * @param height Image height
+         * @param channels Bytes per pixel
+         * @param dp_memory DP storage mode
+         */
+        static std::size_t footprint(int width, int height, int channels, DpMemory dp_memory);
+    };
+
+    /**
+     * @brief Auxiliary plane carved along with the primary image
+     *
+     * Alpha masks, depth maps or label maps that must lose the same pixels as
+     * the image. Pixels are opaque: `channels` counts bytes per pixel, so any
+     * trivially copyable pixel type fits (see plane_view()). src has the size
+     * of the primary image, dst its height and the target width.
+     */
+    struct AttachedPlane {
+        ImageView src;
+        MutableImageView dst;
+    };
+
+    /// View of a packed plane with `components` values of type T per pixel
+    template <typename T>
+    ImageView plane_view(const T* data, int width, int height, int components = 1) {
+        static_assert(std::is_trivially_copyable<T>::value, "plane pixels are copied bytewise");
+        return ImageView::packed(reinterpret_cast<const unsigned char*>(data), width, height,
+                                 static_cast<int>(sizeof(T)) * components);
+    }
+
+    /// Writable view of a packed plane with `components` values of type T per pixel
+    template <typename T>
+    MutableImageView mutable_plane_view(T* data, int width, int height, int components = 1) {
+        static_assert(std::is_trivially_copyable<T>::value, "plane pixels are copied bytewise");
+        return MutableImageView::packed(reinterpret_cast<unsigned char*>(data), width, height,
+                                        static_cast<int>(sizeof(T)) * components);
+    }
+
+    /// Seam order of pixels that no computed seam removes
+    constexpr int kNeverRemoved = std::numeric_limits<int>::max();
+
     /**
      * Find low energy vertical seam using greedy approach.
      * 
@@ -104,6 +283,8 @@ namespace SeamCarving {
      * @param channels Number of channels (should be 3 for RGB)
      * @param target_width Desired final width
      * @param algorithm Algorithm to use for seam finding
+     * @param progress Optional callback; when it returns false the partially
+     *                 carved image is returned
      * @return Pair of (new pixel array, final width)
      */
     std::pair<std::vector<unsigned char>, int> reduce_width_iteratively(
@@ -112,7 +293,8 @@ namespace SeamCarving {
         int height,
         int channels,
         int target_width,
-        Algorithm algorithm = Algorithm::GREEDY
+        Algorithm algorithm = Algorithm::GREEDY,
+        const ProgressCallback& progress = nullptr
     );
 
     /**
@@ -134,4 +316,428 @@ namespace SeamCarving {
         int channels
     );
 
+    /**
+     * Calculate the Sobel energy map into a caller-provided matrix.
+     *
+     * Same result as the vector-based overload; border pixels get zero energy.
+     *
+     * @param pixels Input image view (RGB or RGBA, any row stride)
+     * @param energy Output matrix of the same width and height
+     */
+    void calculate_energy(const ImageView& pixels, const MatrixView<float>& energy);
+
+    /**
+     * Greedy seam search on an energy matrix view.
+     *
+     * @param energy Energy matrix
+     * @param seam Output array of energy.height x-coordinates
+     */
+    void find_low_energy_seam_greedy(const MatrixView<const float>& energy, int* seam);
+
+    /**
+     * Dynamic programming seam search on an energy matrix view.
+     *
+     * @param energy Energy matrix
+     * @param dp Scratch matrix of at least the energy's size for cumulative energies
+     * @param seam Output array of energy.height x-coordinates
+     */
+    void find_low_energy_seam_dyn(
+        const MatrixView<const float>& energy,
+        const MatrixView<float>& dp,
+        int* seam
+    );
+
+    /**
+     * Dynamic programming seam search keeping two cost rows.
+     *
+     * The forward pass records which of the three cells above each pixel
+     * continues its cheapest path, so backtracking needs no cost table: one
+     * byte per pixel instead of four. Same seam as find_low_energy_seam_dyn().
+     *
+     * @param energy Energy matrix
+     * @param rows Scratch for 2 * energy.width cumulative costs
+     * @param steps Scratch matrix of at least the energy's size for the steps (-1, 0, 1)
+     * @param seam Output array of energy.height x-coordinates
+     */
+    void find_low_energy_seam_dyn_backpointers(
+        const MatrixView<const float>& energy,
+        float* rows,
+        const MatrixView<std::int8_t>& steps,
+        int* seam
+    );
+
+    /**
+     * Dynamic programming seam search keeping every interval-th cost row.
+     *
+     * Backtracking walks the segments between checkpoints bottom-up and
+     * recomputes each one from its checkpoint, so the DP runs twice but only
+     * (height - 1) / interval + 1 + interval rows are stored; an interval of
+     * sqrt(height) minimizes that. Same seam as find_low_energy_seam_dyn().
+     *
+     * @param energy Energy matrix
+     * @param rows Scratch matrix of energy.width columns and at least
+     *             (energy.height - 1) / interval + 1 + interval rows
+     * @param interval Rows per segment, at least 1
+     * @param seam Output array of energy.height x-coordinates
+     */
+    void find_low_energy_seam_dyn_checkpointed(
+        const MatrixView<const float>& energy,
+        const MatrixView<float>& rows,
+        int interval,
+        int* seam
+    );
+
+    /**
+     * Dynamic programming seam search in 16-bit integers.
+     *
+     * Energies are truncated to levels of `quantum` and accumulated with
+     * saturating 16-bit adds. Each row is stored relative to the minimum of
+     * the row above, and those minima are kept as per-row offsets: the
+     * quantized cumulative cost of pixel (x, y) is dp(x, y) + row_offsets[y].
+     * A value saturates once its path costs 65535 levels more than the
+     * cheapest one; saturated values only underestimate, so the seam found is
+     * optimal for the quantized energy whenever none of its own values
+     * saturated. Its exact cost is then within energy.height * quantum of the
+     * float optimum. With AVX2 (detected at run time) a row advances 16
+     * columns per instruction, twice the lanes of the float DP and half its
+     * memory traffic.
+     *
+     * With quantum 0 the step is derived from the cost of a cheap seam (the
+     * greedy one or the cheapest of 16 straight columns): the search starts 64 times
+     * finer than the step at which no seam within that cost can saturate, and
+     * redoes the pass 4 times coarser while its seam ran through a saturated
+     * value. Protection weights larger than that cost saturate and keep seams
+     * out as in the float DP. On the benchmark images the seam
+     * costs at most 0.012% more than the float DP's, in one to three passes.
+     *
+     * @param energy Energy matrix
+     * @param dp Scratch matrix of energy.width x energy.height whose rows hold
+     *           at least energy.width + 2 values (the stride); columns -1 and
+     *           energy.width hold out-of-range sentinels
+     * @param row_offsets Output array of energy.height quantized offsets
+     * @param seam Output array of energy.height x-coordinates
+     * @param quantum Energy per quantization level, 0 = choose as above
+     * @return Exact cost of the seam: the sum of its energies
+     */
+    float find_low_energy_seam_dyn16(
+        const MatrixView<const float>& energy,
+        const MatrixView<std::uint16_t>& dp,
+        std::uint64_t* row_offsets,
+        int* seam,
+        float quantum = 0.0f
+    );
+
+    /**
+     * Seam search on an energy matrix view using the specified algorithm.
+     *
+     * @param energy Energy matrix
+     * @param dp Scratch matrix for the DYNAMIC algorithm (unused by GREEDY)
+     * @param seam Output array of energy.height x-coordinates
+     * @param algorithm Algorithm to use (GREEDY or DYNAMIC)
+     */
+    void find_low_energy_seam(
+        const MatrixView<const float>& energy,
+        const MatrixView<float>& dp,
+        int* seam,
+        Algorithm algorithm = Algorithm::GREEDY
+    );
+
+    /**
+     * Seam search with the DP storage selected by buffers.dp_memory.
+     *
+     * Grows the DP scratch of buffers as the mode needs; buffers.energy is
+     * not touched, so energy may point into it.
+     *
+     * @param energy Energy matrix
+     * @param buffers Scratch memory
+     * @param seam Output array of energy.height x-coordinates
+     * @param algorithm Algorithm to use (GREEDY or DYNAMIC)
+     */
+    void find_low_energy_seam(
+        const MatrixView<const float>& energy,
+        CarveBuffers& buffers,
+        int* seam,
+        Algorithm algorithm = Algorithm::GREEDY
+    );
+
+    /**
+     * Find the lowest cost connected strip of adjacent columns (a "fat seam").
+     *
+     * Row y of the strip covers columns [strip[y], strip[y] + strip_width);
+     * consecutive rows shift by at most one column. Dynamic programming runs
+     * over the energy summed across strip_width columns, so a strip costs
+     * one DP pass however wide it is. A width of 1 is an ordinary DP seam.
+     *
+     * @param energy Energy matrix
+     * @param strip_width Columns per row, at most energy.width
+     * @param dp Scratch matrix of at least (energy.width - strip_width + 1) x energy.height
+     * @param strip Output array of energy.height left columns
+     * @return Total energy under the strip
+     */
+    float find_low_energy_strip(
+        const MatrixView<const float>& energy,
+        int strip_width,
+        const MatrixView<float>& dp,
+        int* strip
+    );
+
+    /**
+     * Remove a vertical seam, writing into a caller-provided image.
+     *
+     * dst must be one pixel narrower than src. In-place removal is supported
+     * when dst and src share data pointer and stride.
+     *
+     * @param src Input image view
+     * @param seam Array of src.height x-coordinates defining the seam to remove
+     * @param dst Output image view of width src.width - 1
+     */
+    void remove_seam(const ImageView& src, const int* seam, const MutableImageView& dst);
+
+    /**
+     * Iteratively remove seams from a strided view into a caller-owned buffer.
+     *
+     * The target width is dst.width. The source is never copied as a whole: the
+     * first seam removal reads straight from src into the scratch buffer, later
+     * ones compact in place, and the last one writes directly into dst. After
+     * buffers have grown once, no memory is allocated.
+     *
+     * @param src Input image view (may be a sub-rectangle of a larger frame)
+     * @param dst Output view with the same height/channels and the target width
+     * @param buffers Reusable scratch memory
+     * @param algorithm Algorithm to use for seam finding
+     * @param progress Optional callback; returning false aborts
+     * @return Width reached: dst.width on success. When aborted, the partially
+     *         carved image (if any seam was removed) is left in buffers.pixels
+     *         with a row stride of src.width * channels and dst is untouched.
+     *         0 when dst.width <= 0 (invalid target; dst is untouched).
+     */
+    int reduce_width_iteratively(
+        const ImageView& src,
+        const MutableImageView& dst,
+        CarveBuffers& buffers,
+        Algorithm algorithm = Algorithm::GREEDY,
+        const ProgressCallback& progress = nullptr
+    );
+
+    /**
+     * Remove seams with an energy map computed only once.
+     *
+     * The energy of the source is compacted along with the pixels instead of
+     * being recomputed, which skips the Sobel pass per seam. Pixels next to a
+     * removed seam keep their old energy, so later seams can be slightly off.
+     *
+     * @param src Input image view
+     * @param dst Output view with the target width
+     * @param buffers Reusable scratch memory
+     * @param algorithm Algorithm to use for seam finding
+     * @param progress Optional callback; returning false aborts
+     * @return Width reached, as reduce_width_iteratively()
+     */
+    int reduce_width_approximate(
+        const ImageView& src,
+        const MutableImageView& dst,
+        CarveBuffers& buffers,
+        Algorithm algorithm = Algorithm::GREEDY,
+        const ProgressCallback& progress = nullptr
+    );
+
+    /**
+     * Remove seams using the energy of the Gaussian-blurred luma.
+     *
+     * Noise and compression artefacts no longer pull seams around: only
+     * structure larger than sigma counts. The blur is recursive, so its cost
+     * does not depend on sigma, and after each seam only the band around it
+     * is refiltered (see SmoothedEnergy in prefilter.h).
+     *
+     * @param src Input image view
+     * @param dst Output view with the target width
+     * @param sigma Blur standard deviation in pixels; 0 behaves as reduce_width_iteratively()
+     * @param buffers Reusable scratch memory
+     * @param algorithm Algorithm to use for seam finding
+     * @param progress Optional callback; returning false aborts
+     * @return Width reached, as reduce_width_iteratively()
+     */
+    int reduce_width_smoothed(
+        const ImageView& src,
+        const MutableImageView& dst,
+        float sigma,
+        CarveBuffers& buffers,
+        Algorithm algorithm = Algorithm::GREEDY,
+        const ProgressCallback& progress = nullptr
+    );
+
+    /**
+     * Remove strips of up to max_strip_width columns per pass.
+     *
+     * Each pass recomputes the energy once and removes a whole strip (see
+     * find_low_energy_strip()), so large reductions take up to
+     * max_strip_width times fewer passes. The width adapts to the content:
+     * a pass takes the widest strip (1, 2, 4, ... columns) whose cost per
+     * removed column stays close to that of the best single seam, so strips
+     * are wide across flat background and fall back to single seams near
+     * detail. Seams are always found by dynamic programming.
+     *
+     * @param src Input image view
+     * @param dst Output view with the target width
+     * @param buffers Reusable scratch memory
+     * @param max_strip_width Widest strip, 1-8 (1 = one DP seam per pass)
+     * @param progress Optional callback receiving (columns removed, total); returning false aborts
+     * @return Width reached, as reduce_width_iteratively()
+     */
+    int reduce_width_strips(
+        const ImageView& src,
+        const MutableImageView& dst,
+        CarveBuffers& buffers,
+        int max_strip_width = 8,
+        const ProgressCallback& progress = nullptr
+    );
+
+    /**
+     * Iteratively remove seams, applying the same seams to attached planes.
+     *
+     * Seams are found on the primary image only. Instead of compacting every
+     * plane once per seam, the original column of each working pixel is
+     * tracked (one int plane, whatever the number of attached planes) and
+     * each plane is gathered into its dst in a single pass at the end, so
+     * planes add no per-seam work and need no scratch memory.
+     *
+     * @param src Primary image view
+     * @param dst Output view of the primary image with the target width
+     * @param planes Attached planes; a plane whose size does not match is skipped
+     * @param plane_count Number of attached planes
+     * @param buffers Reusable scratch memory
+     * @param algorithm Algorithm to use for seam finding
+     * @param progress Optional callback; returning false aborts
+     * @return Width reached; when aborted the planes' dst are untouched
+     */
+    int reduce_width_iteratively(
+        const ImageView& src,
+        const MutableImageView& dst,
+        const AttachedPlane* planes,
+        int plane_count,
+        CarveBuffers& buffers,
+        Algorithm algorithm = Algorithm::GREEDY,
+        const ProgressCallback& progress = nullptr
+    );
+
+    /**
+     * Record the order in which seams remove the pixels of an image.
+     *
+     * Seams are removed one at a time, so the image carved to any width w is
+     * the original minus the pixels with order < src.width - w. One pass down
+     * to min_width therefore describes every width in [min_width, src.width].
+     *
+     * Time Complexity: same as reduce_width_iteratively() to min_width
+     *
+     * @param src Input image view
+     * @param min_width Narrowest width the map has to describe
+     * @param order Output src.width x src.height matrix: index of the seam that
+     *              removes each pixel, kNeverRemoved for pixels that survive
+     * @param buffers Reusable scratch memory
+     * @param algorithm Algorithm to use for seam finding
+     * @param progress Optional callback; returning false aborts
+     * @return Number of seams recorded; the map is valid for widths down to
+     *         src.width minus this value
+     */
+    int compute_seam_order(
+        const ImageView& src,
+        int min_width,
+        const MatrixView<int>& order,
+        CarveBuffers& buffers,
+        Algorithm algorithm = Algorithm::GREEDY,
+        const ProgressCallback& progress = nullptr
+    );
+
+    /**
+     * Record a seam order on a fixed energy map, without pixels.
+     *
+     * Energy is not recomputed between seams: each seam is removed from the
+     * map like from an image. Meant for coarse maps such as per-block JPEG
+     * energy (see carve_from_coarse_order()).
+     *
+     * @param energy Energy map; it is copied, not modified
+     * @param min_width Narrowest width the map has to describe
+     * @param order Output matrix of the energy's size, as compute_seam_order()
+     * @param buffers Reusable scratch memory
+     * @param algorithm Algorithm to use for seam finding
+     * @param progress Optional callback; returning false aborts
+     * @return Number of seams recorded
+     */
+    int compute_seam_order_from_energy(
+        const MatrixView<const float>& energy,
+        int min_width,
+        const MatrixView<int>& order,
+        CarveBuffers& buffers,
+        Algorithm algorithm = Algorithm::GREEDY,
+        const ProgressCallback& progress = nullptr
+    );
+
+    /**
+     * Carve an image with the seam order of a coarser grid.
+     *
+     * Coarse cell (cx, cy) covers pixels [cx * factor_x, (cx + 1) * factor_x)
+     * of rows [cy * factor_y, (cy + 1) * factor_y); pixel rows past the grid
+     * use its last row and pixel columns past it are never removed. Coarse
+     * seam k removes the factor_x pixels under it in every row, in order
+     * k * factor_x + (x % factor_x), so any count up to factor_x times the
+     * recorded seams can be removed.
+     *
+     * @param src Full resolution image view
+     * @param coarse_order Seam order map of the coarse grid
+     * @param factor_x Pixel columns per coarse cell
+     * @param factor_y Pixel rows per coarse cell
+     * @param dst Output view of the target width
+     */
+    void carve_from_coarse_order(
+        const ImageView& src,
+        const MatrixView<const int>& coarse_order,
+        int factor_x,
+        int factor_y,
+        const MutableImageView& dst
+    );
+
+    /**
+     * Build the per-row source column lookup of one carved width.
+     *
+     * lookup(x, y) is the original column shown at output column x of row y.
+     *
+     * Time Complexity: O(width * height) of the original image
+     *
+     * @param order Seam order map from compute_seam_order()
+     * @param lookup Output matrix of the target width and the image height
+     */
+    void build_carve_lookup(const MatrixView<const int>& order, const MatrixView<int>& lookup);
+
+    /**
+     * Carve an image to dst.width by gathering the pixels a seam order map keeps.
+     *
+     * Same result as reduce_width_iteratively() with the algorithm the map was
+     * computed with, in O(width * height).
+     *
+     * @param src Original image view
+     * @param order Seam order map of src from compute_seam_order()
+     * @param dst Output view of the target width
+     */
+    void carve_from_order(const ImageView& src, const MatrixView<const int>& order, const MutableImageView& dst);
+
+    /**
+     * Carve an image and its attached planes with a seam order map.
+     *
+     * The kept runs of each row are found once and copied from every plane
+     * while the row's order entries are still in cache.
+     *
+     * @param src Original image view
+     * @param order Seam order map of src from compute_seam_order()
+     * @param dst Output view of the target width
+     * @param planes Attached planes; a plane whose size does not match is skipped
+     * @param plane_count Number of attached planes
+     */
+    void carve_from_order(
+        const ImageView& src,
+        const MatrixView<const int>& order,
+        const MutableImageView& dst,
+        const AttachedPlane* planes,
+        int plane_count
+    );
+
 } // namespace SeamCarving
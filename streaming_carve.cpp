@@ -0,0 +1,186 @@
+#include "streaming_carve.h"
+#include "metrics.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <utility>
+
+namespace SeamCarving {
+
+StreamingCarver::StreamingCarver(int width, int height, int channels, int seams, RowCallback output)
+    : width_(width), height_(height), channels_(channels), output_(std::move(output)) {
+    seams = std::max(0, std::min(seams, width - 1));
+    stages_.resize(seams);
+    for (int i = 0; i < seams; i++) {
+        Stage& stage = stages_[i];
+        stage.width = width - i;
+        stage.pixels.resize(static_cast<size_t>(kWindowRows) * stage.width * channels);
+        stage.luma.resize(static_cast<size_t>(kWindowRows) * stage.width);
+        stage.energy.resize(stage.width);
+    }
+    output_row_.resize(static_cast<size_t>(output_width()) * channels);
+}
+
+std::size_t StreamingCarver::footprint(int width, int channels, int seams) {
+    std::size_t bytes = static_cast<size_t>(width) * channels;
+    for (int i = 0; i < seams; i++) {
+        size_t stage_width = static_cast<size_t>(width - i);
+        bytes += kWindowRows * stage_width * (channels + sizeof(float)) + stage_width * sizeof(float);
+    }
+    return bytes;
+}
+
+void StreamingCarver::push_row(const unsigned char* row) {
+    if (rows_in_ >= height_) {
+        return;
+    }
+    int y = rows_in_++;
+    if (y == 0) {
+        start_ = std::chrono::steady_clock::now();
+    }
+
+    if (stages_.empty()) {
+        output_(y, row);
+    } else {
+        // The first stage converts to luma; later ones inherit it with the seam pixel removed
+        Stage& first = stages_.front();
+        int slot = y % kWindowRows;
+        std::memcpy(first.pixels.data() + static_cast<size_t>(slot) * width_ * channels_, row,
+                    static_cast<size_t>(width_) * channels_);
+        float* luma = first.luma.data() + static_cast<size_t>(slot) * width_;
+        for (int x = 0; x < width_; x++) {
+            const unsigned char* p = row + x * channels_;
+            luma[x] = 0.299f * p[0] + 0.587f * p[1] + 0.114f * p[2];
+        }
+
+        // Depth-first: a row goes down the cascade as far as it can before
+        // its stage passes on the next one
+        process(0, y);
+        int last = static_cast<int>(stages_.size()) - 1;
+        int s = 0;
+        while (s >= 0) {
+            Stage& stage = stages_[s];
+            if (stage.ready_next == stage.ready_count) {
+                stage.ready_next = stage.ready_count = 0;
+                s--;
+                continue;
+            }
+            int ready = stage.ready_next++;
+            emit(s, stage.ready_y[ready], stage.ready_x[ready]);
+            if (s < last) {
+                process(s + 1, stage.ready_y[ready]);
+                s++;
+            }
+        }
+    }
+
+    if (rows_in_ == height_) {
+        int seams = static_cast<int>(stages_.size());
+        Metrics::record(Metrics::Latency::JOB, std::chrono::steady_clock::now() - start_);
+        Metrics::add(Metrics::Counter::JOBS);
+        Metrics::add(Metrics::Counter::SEAMS, static_cast<std::uint64_t>(seams));
+        Metrics::add(Metrics::Counter::PIXELS, static_cast<std::uint64_t>(seams) * height_);
+    }
+}
+
+void StreamingCarver::process(int s, int y) {
+    Stage& stage = stages_[s];
+    auto decide = [&stage](int row, int seam_x) {
+        stage.ready_y[stage.ready_count] = row;
+        stage.ready_x[stage.ready_count] = seam_x;
+        stage.ready_count++;
+    };
+
+    // calculate_energy() has no interior below 3x3: the energy is zero and
+    // the greedy seam keeps to column 0
+    if (height_ < 3 || stage.width < 3) {
+        decide(y, 0);
+        return;
+    }
+    if (y < 2) {
+        return;
+    }
+
+    // Rows y - 2, y - 1, y are in the window: energy of row y - 1. The
+    // greedy step only looks at the three columns around the seam.
+    auto step = [&](int current_x) {
+        // Same choice and tie-breaking as find_low_energy_seam_greedy()
+        int best_x = current_x;
+        float best_energy = energy_at(stage, y - 1, current_x);
+        if (current_x > 0) {
+            float left = energy_at(stage, y - 1, current_x - 1);
+            if (left < best_energy) {
+                best_energy = left;
+                best_x = current_x - 1;
+            }
+        }
+        if (current_x < stage.width - 1 && energy_at(stage, y - 1, current_x + 1) < best_energy) {
+            best_x = current_x + 1;
+        }
+        return best_x;
+    };
+
+    if (y == 2) {
+        // Row 0 has the energy of row 1; the seam starts at its minimum
+        float* energy = stage.energy.data();
+        for (int x = 0; x < stage.width; x++) {
+            energy[x] = energy_at(stage, 1, x);
+        }
+        stage.seam_x = static_cast<int>(std::min_element(energy, energy + stage.width) - energy);
+        decide(0, stage.seam_x);
+    }
+    stage.seam_x = step(stage.seam_x);
+    decide(y - 1, stage.seam_x);
+
+    if (y == height_ - 1) {
+        // The last row has the energy of the row above it
+        stage.seam_x = step(stage.seam_x);
+        decide(y, stage.seam_x);
+    }
+}
+
+float StreamingCarver::energy_at(const Stage& stage, int y, int x) const {
+    static const int sobel_x[3][3] = {{-1, 0, 1}, {-2, 0, 2}, {-1, 0, 1}};
+    static const int sobel_y[3][3] = {{-1, -2, -1}, {0, 0, 0}, {1, 2, 1}};
+
+    // Border columns take the energy of their inner neighbour
+    int width = stage.width;
+    x = std::max(1, std::min(x, width - 2));
+
+    // Same operations in the same order as calculate_energy(), so the seams match bit for bit
+    float gx = 0, gy = 0;
+    for (int ky = -1; ky <= 1; ky++) {
+        const float* row = stage.luma.data() + static_cast<size_t>((y + ky) % kWindowRows) * width;
+        for (int kx = -1; kx <= 1; kx++) {
+            float gray = row[x + kx];
+            gx += gray * sobel_x[ky + 1][kx + 1];
+            gy += gray * sobel_y[ky + 1][kx + 1];
+        }
+    }
+    return std::sqrt(gx * gx + gy * gy);
+}
+
+void StreamingCarver::emit(int s, int y, int seam_x) {
+    const Stage& stage = stages_[s];
+    int slot = y % kWindowRows;
+    size_t row_bytes = static_cast<size_t>(stage.width) * channels_;
+    const unsigned char* pixels = stage.pixels.data() + slot * row_bytes;
+
+    bool last = s + 1 == static_cast<int>(stages_.size());
+    unsigned char* out = last ? output_row_.data() : stages_[s + 1].pixels.data() + slot * (row_bytes - channels_);
+    std::memcpy(out, pixels, static_cast<size_t>(seam_x) * channels_);
+    std::memcpy(out + static_cast<size_t>(seam_x) * channels_, pixels + static_cast<size_t>(seam_x + 1) * channels_,
+                static_cast<size_t>(stage.width - seam_x - 1) * channels_);
+
+    if (last) {
+        output_(y, output_row_.data());
+        return;
+    }
+    const float* luma = stage.luma.data() + static_cast<size_t>(slot) * stage.width;
+    float* next_luma = stages_[s + 1].luma.data() + static_cast<size_t>(slot) * (stage.width - 1);
+    std::copy(luma, luma + seam_x, next_luma);
+    std::copy(luma + seam_x + 1, luma + stage.width, next_luma + seam_x);
+}
+
+} // namespace SeamCarving
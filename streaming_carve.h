@@ -0,0 +1,93 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <vector>
+
+namespace SeamCarving {
+
+    /**
+     * @brief Greedy seam removal on an image that arrives one row at a time
+     *
+     * find_low_energy_seam_greedy() picks the seam pixel of a row from the
+     * row above, so seams can follow the rows as a decoder produces them. The
+     * carver is a cascade of one stage per seam: stage i sees the image with
+     * i seams removed, keeps a three-row window (pixels and luma) to compute
+     * the energy of the row in the middle, advances its seam by one row and
+     * passes that row, minus the seam pixel, on to stage i + 1. Rows run
+     * depth-first: a stage hands on its next row only after every later stage
+     * took the previous one, so no window ever holds more than three rows.
+     * The last stage hands finished rows to the output callback right away.
+     *
+     * The result is the same as removing the seams one after the other with
+     * the greedy search on the energy of calculate_energy(), with border rows
+     * and columns taking the energy of their inner neighbour (as the 2D
+     * retargeting does), instead of zero, which would pin every greedy seam to
+     * column 0. Memory is a few rows per seam and never depends on the image
+     * height; output row y is emitted as soon as input row y + seams arrived.
+     *
+     * Time Complexity: O(width * height * seams) for moving the pixels; the
+     * energy is only computed next to the seams, O(width * seams + height * seams)
+     * Space Complexity: O(width * seams)
+     */
+    class StreamingCarver {
+    public:
+        /// Receives output rows in order: y and (width - seams) * channels bytes
+        using RowCallback = std::function<void(int y, const unsigned char* row)>;
+
+        /**
+         * @param width Input width
+         * @param height Input height
+         * @param channels Number of channels (3 or 4)
+         * @param seams Vertical seams to remove, in [0, width - 1]
+         * @param output Called for every finished output row
+         */
+        StreamingCarver(int width, int height, int channels, int seams, RowCallback output);
+
+        /**
+         * Feed the next input row; the last row flushes the remaining output.
+         *
+         * @param row width * channels bytes of input row rows_in()
+         */
+        void push_row(const unsigned char* row);
+
+        int output_width() const { return width_ - static_cast<int>(stages_.size()); }
+        int rows_in() const { return rows_in_; }
+        /// True once every output row was emitted
+        bool finished() const { return rows_in_ == height_; }
+
+        /// Bytes held by a carver of the given size, independent of the height
+        static std::size_t footprint(int width, int channels, int seams);
+
+    private:
+        /// Rows kept per stage: the energy of a row needs the rows above and below
+        static constexpr int kWindowRows = 3;
+
+        struct Stage {
+            int width = 0;                      ///< Width of the image this stage carves
+            int seam_x = 0;                     ///< Seam column of the last row decided
+            std::vector<unsigned char> pixels;  ///< kWindowRows rows, row y in slot y % kWindowRows
+            std::vector<float> luma;            ///< Same rows as grayscale
+            std::vector<float> energy;          ///< Energy of row 0, where the seam starts
+            int ready_y[kWindowRows] = {};      ///< Rows whose seam column is decided, oldest first
+            int ready_x[kWindowRows] = {};
+            int ready_count = 0;
+            int ready_next = 0;                 ///< Next ready row to pass on
+        };
+
+        void process(int stage, int y);
+        float energy_at(const Stage& stage, int y, int x) const;
+        void emit(int stage, int y, int seam_x);
+
+        int width_;
+        int height_;
+        int channels_;
+        RowCallback output_;
+        std::vector<Stage> stages_;
+        std::vector<unsigned char> output_row_;
+        int rows_in_ = 0;
+        std::chrono::steady_clock::time_point start_;
+    };
+
+} // namespace SeamCarving
@@ -0,0 +1,412 @@
+#include "transport_map.h"
+#include "metrics.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <numeric>
+#include <spdlog/spdlog.h>
+
+namespace SeamCarving {
+
+namespace {
+
+    // Average factor x factor blocks; the last block row and column also take
+    // the pixels left over when the size is not a multiple of the factor
+    void downscale_area(const ImageView& src, int factor, const MutableImageView& dst) {
+        int channels = src.channels;
+        for (int ly = 0; ly < dst.height; ly++) {
+            int y0 = ly * factor;
+            int y1 = (ly == dst.height - 1) ? src.height : y0 + factor;
+            unsigned char* out = dst.row(ly);
+            for (int lx = 0; lx < dst.width; lx++) {
+                int x0 = lx * factor;
+                int x1 = (lx == dst.width - 1) ? src.width : x0 + factor;
+                int count = (y1 - y0) * (x1 - x0);
+                for (int c = 0; c < channels; c++) {
+                    int sum = 0;
+                    for (int y = y0; y < y1; y++) {
+                        const unsigned char* in = src.row(y) + c;
+                        for (int x = x0; x < x1; x++) {
+                            sum += in[static_cast<size_t>(x) * channels];
+                        }
+                    }
+                    out[lx * channels + c] = static_cast<unsigned char>((sum + count / 2) / count);
+                }
+            }
+        }
+    }
+
+    // calculate_energy() leaves the border at zero, which makes the edge rows
+    // and columns free seams and every order cost the same; here the border
+    // repeats its interior neighbour instead
+    void calculate_energy_2d(const ImageView& image, const MatrixView<float>& energy) {
+        calculate_energy(image, energy);
+        int width = energy.width;
+        int height = energy.height;
+        if (width >= 3) {
+            for (int y = 0; y < height; y++) {
+                float* row = energy.row(y);
+                row[0] = row[1];
+                row[width - 1] = row[width - 2];
+            }
+        }
+        if (height >= 3) {
+            std::copy(energy.row(1), energy.row(1) + width, energy.row(0));
+            std::copy(energy.row(height - 2), energy.row(height - 2) + width, energy.row(height - 1));
+        }
+    }
+
+    // dst(y, x) = src(x, y) in 32 x 32 tiles, so both sides stay in cache
+    void transpose(const MatrixView<const float>& src, const MatrixView<float>& dst) {
+        constexpr int kTile = 32;
+        for (int y0 = 0; y0 < src.height; y0 += kTile) {
+            int y1 = std::min(y0 + kTile, src.height);
+            for (int x0 = 0; x0 < src.width; x0 += kTile) {
+                int x1 = std::min(x0 + kTile, src.width);
+                for (int y = y0; y < y1; y++) {
+                    const float* in = src.row(y);
+                    for (int x = x0; x < x1; x++) {
+                        dst.row(x)[y] = in[x];
+                    }
+                }
+            }
+        }
+    }
+
+    /**
+     * Best seam of one direction on the energy map of the current image.
+     *
+     * @param transposed Scratch of energy.width * energy.height floats (HORIZONTAL only)
+     * @param seam Output: energy.height columns (VERTICAL) or energy.width rows (HORIZONTAL)
+     * @return Energy along the seam
+     */
+    double find_seam(const MatrixView<const float>& energy, SeamDirection direction, float* transposed,
+                     CarveBuffers& buffers, int* seam, Algorithm algorithm) {
+        double cost = 0.0;
+        if (direction == SeamDirection::VERTICAL) {
+            find_low_energy_seam(energy, buffers, seam, algorithm);
+            for (int y = 0; y < energy.height; y++) {
+                cost += energy.row(y)[seam[y]];
+            }
+            return cost;
+        }
+        MatrixView<float> flipped{transposed, energy.height, energy.width, energy.height};
+        transpose(energy, flipped);
+        find_low_energy_seam(flipped, buffers, seam, algorithm);
+        for (int x = 0; x < energy.width; x++) {
+            cost += energy.row(seam[x])[x];
+        }
+        return cost;
+    }
+
+    /// Order with every column before the first row (the only one when either count is 0)
+    std::vector<SeamDirection> columns_first(int columns, int rows) {
+        std::vector<SeamDirection> order(static_cast<size_t>(columns), SeamDirection::VERTICAL);
+        order.insert(order.end(), static_cast<size_t>(rows), SeamDirection::HORIZONTAL);
+        return order;
+    }
+
+} // namespace
+
+void remove_horizontal_seam(const ImageView& src, const int* seam, const MutableImageView& dst) {
+    // Rows are written top to bottom and only read from the same or the next
+    // row, so removal in place never reads a pixel it already overwrote
+    size_t pixel_bytes = static_cast<size_t>(src.channels);
+    for (int y = 0; y < dst.height; y++) {
+        const unsigned char* same = src.row(y);
+        const unsigned char* below = src.row(y + 1);
+        unsigned char* out = dst.row(y);
+        for (int x = 0; x < src.width; x++) {
+            const unsigned char* in = (y < seam[x] ? same : below) + x * pixel_bytes;
+            unsigned char* to = out + x * pixel_bytes;
+            if (to != in) {
+                std::memcpy(to, in, pixel_bytes);
+            }
+        }
+    }
+}
+
+TransportPlan plan_transport_order(
+    const ImageView& src,
+    int target_width,
+    int target_height,
+    const TransportOptions& options
+) {
+    TransportPlan plan;
+    int columns = src.width - std::max(1, std::min(target_width, src.width));
+    int rows = src.height - std::max(1, std::min(target_height, src.height));
+    plan.proxy_width = src.width;
+    plan.proxy_height = src.height;
+    if (columns == 0 || rows == 0) {
+        plan.order = columns_first(columns, rows);
+        plan.exact = true;
+        return plan;
+    }
+
+    auto start_time = std::chrono::steady_clock::now();
+    int channels = src.channels;
+    double area = static_cast<double>(src.width) * src.height;
+    int factor = static_cast<int>(std::ceil(std::sqrt(area / std::max(1, options.proxy_pixels))));
+    factor = std::max(1, std::min(factor, std::min(src.width, src.height)));
+    int proxy_width = src.width / factor;
+    int proxy_height = src.height / factor;
+    // Proxy seam counts; a proxy step stands for about factor seams
+    int proxy_columns = std::min(proxy_width - 1, std::max(1, static_cast<int>(std::lround(static_cast<double>(columns) / factor))));
+    int proxy_rows = std::min(proxy_height - 1, std::max(1, static_cast<int>(std::lround(static_cast<double>(rows) / factor))));
+    plan.proxy_width = proxy_width;
+    plan.proxy_height = proxy_height;
+    plan.proxy_factor = factor;
+    if (proxy_columns < 1 || proxy_rows < 1) {
+        // A proxy line thin enough to leave nothing to choose
+        plan.order = columns_first(columns, rows);
+        return plan;
+    }
+
+    // Memory: the proxy, the step grid and the search scratch (energy, its
+    // transpose, DP) are fixed; each beam state costs a carved proxy for this
+    // step and one for the next, plus the seams of its candidates
+    size_t image_bytes = static_cast<size_t>(proxy_width) * proxy_height * channels;
+    size_t seam_length = static_cast<size_t>(std::max(proxy_width, proxy_height));
+    size_t cells = static_cast<size_t>(proxy_rows + 1) * (proxy_columns + 1);
+    size_t fixed_bytes = image_bytes + cells +
+                         3 * static_cast<size_t>(proxy_width) * proxy_height * sizeof(float);
+    size_t state_bytes = 2 * image_bytes + 2 * seam_length * sizeof(int);
+    size_t affordable = options.memory_budget > fixed_bytes ? (options.memory_budget - fixed_bytes) / state_bytes : 0;
+    int reachable = std::min(proxy_rows, proxy_columns) + 1;  // most states one step can have
+    int beam = static_cast<int>(std::min<size_t>(affordable, static_cast<size_t>(std::max(1, options.max_beam))));
+    if (beam < 1) {
+        spdlog::warn("Transport order: {:.1f} MB budget is too small for a {}x{} proxy, searching a single path",
+                     options.memory_budget / 1048576.0, proxy_width, proxy_height);
+        beam = 1;
+    }
+    beam = std::min(beam, reachable);
+    plan.beam_width = beam;
+    plan.exact = beam == reachable;
+
+    // Carved proxies live in 2 x beam slots of the proxy's size: states of the
+    // current step in one half, of the next step in the other
+    std::ptrdiff_t stride = static_cast<std::ptrdiff_t>(proxy_width) * channels;
+    Memory::LargeBuffer<unsigned char> pool(2 * static_cast<size_t>(beam) * image_bytes);
+    auto slot_view = [&](int slot, int width, int height) {
+        return MutableImageView{pool.data() + static_cast<size_t>(slot) * image_bytes, width, height, channels, stride};
+    };
+    downscale_area(src, factor, slot_view(0, proxy_width, proxy_height));
+
+    Memory::LargeBuffer<float> energy(static_cast<size_t>(proxy_width) * proxy_height);
+    Memory::LargeBuffer<float> transposed(energy.size());
+    CarveBuffers scratch;
+    // Direction of the step into each (rows, columns) cell, for the backtrack
+    std::vector<std::uint8_t> step_into(cells, 0);
+
+    struct State {
+        int rows;      ///< Proxy rows removed; columns removed = step - rows
+        double cost;   ///< Seam energy summed along the best path found to this cell
+        int slot;
+    };
+    struct Candidate {
+        int rows;
+        double cost;
+        int from;      ///< Index of the predecessor in the current states
+        SeamDirection direction;
+    };
+    std::vector<State> states = {{0, 0.0, 0}};
+    std::vector<State> next_states;
+    std::vector<Candidate> candidates;
+    std::vector<int> candidate_seams(2 * static_cast<size_t>(beam) * seam_length);
+    std::vector<int> seam(seam_length);
+    std::vector<int> cell_of(static_cast<size_t>(proxy_rows) + 2, -1);
+    std::vector<int> kept;
+
+    int steps = proxy_rows + proxy_columns;
+    for (int step = 0; step < steps; step++) {
+        // Both successors of every state; a cell reached twice keeps the cheaper path
+        candidates.clear();
+        for (int s = 0; s < static_cast<int>(states.size()); s++) {
+            const State& state = states[s];
+            int removed_columns = step - state.rows;
+            ImageView image = slot_view(state.slot, proxy_width - removed_columns, proxy_height - state.rows);
+            MatrixView<float> map{energy.data(), image.width, image.height, image.width};
+            calculate_energy_2d(image, map);
+            for (SeamDirection direction : {SeamDirection::VERTICAL, SeamDirection::HORIZONTAL}) {
+                bool horizontal = direction == SeamDirection::HORIZONTAL;
+                if (horizontal ? state.rows == proxy_rows : removed_columns == proxy_columns) {
+                    continue;
+                }
+                double cost = state.cost + find_seam(map, direction, transposed.data(), scratch, seam.data(),
+                                                     options.algorithm);
+                int rows_after = state.rows + (horizontal ? 1 : 0);
+                int& cell = cell_of[rows_after];
+                if (cell < 0) {
+                    cell = static_cast<int>(candidates.size());
+                    candidates.push_back({rows_after, std::numeric_limits<double>::infinity(), -1, direction});
+                }
+                Candidate& candidate = candidates[cell];
+                if (cost < candidate.cost) {
+                    candidate = {rows_after, cost, s, direction};
+                    std::copy(seam.begin(), seam.begin() + (horizontal ? image.width : image.height),
+                              candidate_seams.begin() + static_cast<size_t>(cell) * seam_length);
+                }
+            }
+        }
+
+        // The beam: the cheapest cells of this step
+        kept.resize(candidates.size());
+        std::iota(kept.begin(), kept.end(), 0);
+        if (static_cast<int>(kept.size()) > beam) {
+            std::nth_element(kept.begin(), kept.begin() + beam, kept.end(),
+                             [&](int a, int b) { return candidates[a].cost < candidates[b].cost; });
+            kept.resize(beam);
+        }
+
+        int next_half = ((step + 1) % 2) * beam;
+        next_states.clear();
+        for (int k = 0; k < static_cast<int>(kept.size()); k++) {
+            const Candidate& candidate = candidates[kept[k]];
+            const State& from = states[candidate.from];
+            ImageView image = slot_view(from.slot, proxy_width - (step - from.rows), proxy_height - from.rows);
+            const int* cut = candidate_seams.data() + static_cast<size_t>(kept[k]) * seam_length;
+            int slot = next_half + k;
+            if (candidate.direction == SeamDirection::VERTICAL) {
+                remove_seam(image, cut, slot_view(slot, image.width - 1, image.height));
+            } else {
+                remove_horizontal_seam(image, cut, slot_view(slot, image.width, image.height - 1));
+            }
+            step_into[static_cast<size_t>(candidate.rows) * (proxy_columns + 1) + (step + 1 - candidate.rows)] =
+                static_cast<std::uint8_t>(candidate.direction);
+            next_states.push_back({candidate.rows, candidate.cost, slot});
+        }
+        for (const Candidate& candidate : candidates) {
+            cell_of[candidate.rows] = -1;
+        }
+        states.swap(next_states);
+    }
+    plan.proxy_cost = states.front().cost;
+
+    // Walk back from the corner, then stretch every proxy step to the full
+    // resolution seams it stands for
+    std::vector<SeamDirection> proxy_order;
+    for (int r = proxy_rows, c = proxy_columns; r + c > 0;) {
+        auto direction = static_cast<SeamDirection>(step_into[static_cast<size_t>(r) * (proxy_columns + 1) + c]);
+        proxy_order.push_back(direction);
+        (direction == SeamDirection::HORIZONTAL ? r : c)--;
+    }
+    std::reverse(proxy_order.begin(), proxy_order.end());
+
+    plan.order.reserve(static_cast<size_t>(columns) + rows);
+    int proxy_done_rows = 0, proxy_done_columns = 0, done_rows = 0, done_columns = 0;
+    for (SeamDirection direction : proxy_order) {
+        if (direction == SeamDirection::HORIZONTAL) {
+            proxy_done_rows++;
+            int target = static_cast<int>((static_cast<long long>(rows) * proxy_done_rows + proxy_rows / 2) / proxy_rows);
+            plan.order.insert(plan.order.end(), static_cast<size_t>(target - done_rows), direction);
+            done_rows = target;
+        } else {
+            proxy_done_columns++;
+            int target = static_cast<int>((static_cast<long long>(columns) * proxy_done_columns + proxy_columns / 2) /
+                                          proxy_columns);
+            plan.order.insert(plan.order.end(), static_cast<size_t>(target - done_columns), direction);
+            done_columns = target;
+        }
+    }
+
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start_time);
+    spdlog::info("Transport order on a {}x{} proxy (1/{}): beam {} of {} states{}, cost {:.0f}, {}ms",
+                 proxy_width, proxy_height, factor, beam, reachable, plan.exact ? " (exact)" : "", plan.proxy_cost,
+                 elapsed.count());
+    return plan;
+}
+
+int carve_with_order(
+    const ImageView& src,
+    const std::vector<SeamDirection>& order,
+    const MutableImageView& dst,
+    CarveBuffers& buffers,
+    Algorithm algorithm,
+    const ProgressCallback& progress
+) {
+    int width = src.width;
+    int height = src.height;
+    int channels = src.channels;
+    int total = static_cast<int>(order.size());
+
+    // Horizontal seams are searched on the transposed energy, so the DP and
+    // the seam must also fit the image turned sideways
+    buffers.reserve(width, height, channels);
+    buffers.reserve(height, width, channels);
+    Memory::LargeBuffer<float> transposed(static_cast<size_t>(width) * height);
+
+    std::ptrdiff_t stride = static_cast<std::ptrdiff_t>(width) * channels;
+    for (int y = 0; y < height; y++) {
+        std::memcpy(buffers.pixels.data() + y * stride, src.row(y), static_cast<size_t>(width) * channels);
+    }
+
+    auto job_start = std::chrono::steady_clock::now();
+    std::uint64_t pixels_removed = 0;
+    auto finish_job = [&](int steps) {
+        Metrics::record(Metrics::Latency::JOB, std::chrono::steady_clock::now() - job_start);
+        Metrics::add(Metrics::Counter::JOBS);
+        Metrics::add(Metrics::Counter::SEAMS, steps);
+        Metrics::add(Metrics::Counter::PIXELS, pixels_removed);
+    };
+
+    spdlog::info("Carving {}x{} down to {}x{} in {} steps", width, height, dst.width, dst.height, total);
+    for (int step = 0; step < total; step++) {
+        if (progress && !progress(step, total)) {
+            spdlog::info("Carving aborted after {}/{} steps", step, total);
+            finish_job(step);
+            return step;
+        }
+
+        auto seam_start = std::chrono::steady_clock::now();
+        MutableImageView working{buffers.pixels.data(), width, height, channels, stride};
+        MatrixView<float> energy{buffers.energy.data(), width, height, width};
+        calculate_energy_2d(working, energy);
+        auto energy_done = std::chrono::steady_clock::now();
+
+        find_seam(energy, order[step], transposed.data(), buffers, buffers.seam.data(), algorithm);
+        auto search_done = std::chrono::steady_clock::now();
+
+        if (order[step] == SeamDirection::VERTICAL) {
+            remove_seam(working, buffers.seam.data(), {working.data, width - 1, height, channels, stride});
+            pixels_removed += height;
+            width--;
+        } else {
+            remove_horizontal_seam(working, buffers.seam.data(), {working.data, width, height - 1, channels, stride});
+            pixels_removed += width;
+            height--;
+        }
+
+        auto seam_done = std::chrono::steady_clock::now();
+        Metrics::record(Metrics::Latency::ENERGY, energy_done - seam_start);
+        Metrics::record(Metrics::Latency::SEAM_SEARCH, search_done - energy_done);
+        Metrics::record(Metrics::Latency::SEAM_REMOVAL, seam_done - search_done);
+        Metrics::record(Metrics::Latency::SEAM, seam_done - seam_start);
+    }
+
+    for (int y = 0; y < std::min(height, dst.height); y++) {
+        std::memcpy(dst.row(y), buffers.pixels.data() + y * stride,
+                    static_cast<size_t>(std::min(width, dst.width)) * channels);
+    }
+    finish_job(total);
+    return total;
+}
+
+int retarget_2d(
+    const ImageView& src,
+    const MutableImageView& dst,
+    CarveBuffers& buffers,
+    const TransportOptions& options,
+    const ProgressCallback& progress,
+    TransportPlan* plan
+) {
+    TransportPlan chosen = plan_transport_order(src, dst.width, dst.height, options);
+    int steps = carve_with_order(src, chosen.order, dst, buffers, options.algorithm, progress);
+    if (plan) {
+        *plan = std::move(chosen);
+    }
+    return steps;
+}
+
+} // namespace SeamCarving
@@ -0,0 +1,123 @@
+#pragma once
+
+#include "seam_carving.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace SeamCarving {
+
+    /// Kind of seam removed by one step of a 2D retargeting order
+    enum class SeamDirection : std::uint8_t {
+        VERTICAL,    ///< Removes a column: width - 1
+        HORIZONTAL   ///< Removes a row: height - 1
+    };
+
+    /**
+     * @brief Settings of plan_transport_order()
+     */
+    struct TransportOptions {
+        std::size_t memory_budget = std::size_t{32} << 20;  ///< Cap on proxy images cached along the beam and the search scratch
+        int proxy_pixels = 128 * 128;                        ///< The proxy is downscaled by an integer factor to at most this area
+        int max_beam = 32;                                   ///< Upper bound on the beam width, whatever the budget allows
+        Algorithm algorithm = Algorithm::DYNAMIC;            ///< Seam search on the proxy and at full resolution
+    };
+
+    /**
+     * @brief Order chosen by plan_transport_order()
+     */
+    struct TransportPlan {
+        std::vector<SeamDirection> order;  ///< One step per full resolution seam (columns + rows removed)
+        int proxy_width = 0;
+        int proxy_height = 0;
+        int proxy_factor = 1;              ///< Full resolution pixels per proxy pixel along each axis
+        int beam_width = 0;                ///< States kept per step; covers every state when the search was exact
+        bool exact = false;                ///< The beam held every reachable state: the proxy transport map is exact
+        double proxy_cost = 0.0;           ///< Energy of the seams removed along the chosen order on the proxy
+    };
+
+    /**
+     * Remove a horizontal seam, writing into a caller-provided image.
+     *
+     * dst may alias src with the same stride (in-place removal).
+     *
+     * @param src Input image view
+     * @param seam Array of src.width y-coordinates, one per column
+     * @param dst Output view of src.width x (src.height - 1)
+     */
+    void remove_horizontal_seam(const ImageView& src, const int* seam, const MutableImageView& dst);
+
+    /**
+     * Choose the order of vertical and horizontal seams for a 2D reduction.
+     *
+     * Approximates the transport map of Avidan and Shamir (the cheapest of
+     * all interleavings of rows and columns) on a downscaled proxy: a beam
+     * search over the steps keeps, after every step, the beam_width lowest
+     * cost (rows removed, columns removed) states together with their
+     * carved proxy images, which is where the memory goes. The beam width is
+     * the largest the memory budget pays for; when it covers every state the
+     * search is the exact transport map of the proxy. The proxy order is
+     * then stretched to the full resolution seam counts.
+     *
+     * Time Complexity: O((r + c) * beam_width * proxy_pixels) on the proxy,
+     * where r, c are the proxy rows and columns removed
+     *
+     * @param src Input image view
+     * @param target_width Width to reach, in [1, src.width]
+     * @param target_height Height to reach, in [1, src.height]
+     * @param options Memory budget, proxy size and algorithm
+     * @return Full resolution order and search statistics
+     */
+    TransportPlan plan_transport_order(
+        const ImageView& src,
+        int target_width,
+        int target_height,
+        const TransportOptions& options = {}
+    );
+
+    /**
+     * Carry out a seam order at full resolution.
+     *
+     * Each step recomputes the energy of the current image and removes its
+     * best vertical or horizontal seam; horizontal seams are searched on the
+     * transposed energy. dst must be the size the order leads to.
+     *
+     * @param src Input image view
+     * @param order Steps, e.g. TransportPlan::order
+     * @param dst Output view of (src.width - vertical steps) x (src.height - horizontal steps)
+     * @param buffers Reusable scratch memory
+     * @param algorithm Algorithm to use for seam finding
+     * @param progress Optional callback (steps done, total); returning false aborts
+     * @return Steps carried out: order.size() on success; when aborted dst is untouched
+     */
+    int carve_with_order(
+        const ImageView& src,
+        const std::vector<SeamDirection>& order,
+        const MutableImageView& dst,
+        CarveBuffers& buffers,
+        Algorithm algorithm = Algorithm::DYNAMIC,
+        const ProgressCallback& progress = nullptr
+    );
+
+    /**
+     * Reduce width and height: plan_transport_order() then carve_with_order().
+     *
+     * @param src Input image view
+     * @param dst Output view with the target width and height
+     * @param buffers Reusable scratch memory
+     * @param options Memory budget, proxy size and algorithm
+     * @param progress Optional callback for the full resolution steps
+     * @param plan Optional output of the plan that was carried out
+     * @return Steps carried out, as carve_with_order()
+     */
+    int retarget_2d(
+        const ImageView& src,
+        const MutableImageView& dst,
+        CarveBuffers& buffers,
+        const TransportOptions& options = {},
+        const ProgressCallback& progress = nullptr,
+        TransportPlan* plan = nullptr
+    );
+
+} // namespace SeamCarving
@@ -0,0 +1,224 @@
+#include "upload_thread.h"
+#include "display_texture.h"
+#include "metrics.h"
+
+#include <GLFW/glfw3.h>
+
+#include <algorithm>
+#include <chrono>
+#include <utility>
+#include <vector>
+#include <spdlog/spdlog.h>
+
+namespace Display {
+
+namespace {
+
+// Bytes uploaded between two fences; smaller batches hand out tiles sooner
+constexpr std::size_t kMaxBatchBytes = std::size_t{16} << 20;
+// glClientWaitSync timeout per attempt; the wait repeats until the fence signals
+constexpr GLuint64 kFenceTimeoutNs = 100000000;
+
+std::unique_ptr<UploadThread> g_upload_thread;
+
+} // namespace
+
+UploadThread::UploadThread(GLFWwindow* share, std::function<void()> wake) : wake_(std::move(wake)) {
+    // A hidden 1x1 window carries the second context; other hints (version,
+    // profile) stay as they were set for the main window
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    context_ = glfwCreateWindow(1, 1, "upload", nullptr, share);
+    glfwWindowHint(GLFW_VISIBLE, GLFW_TRUE);
+    if (context_ == nullptr) {
+        spdlog::warn("Failed to create a shared GL context, textures are uploaded on the render thread");
+        return;
+    }
+    worker_ = std::thread(&UploadThread::run, this);
+}
+
+UploadThread::~UploadThread() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    wake_worker_.notify_one();
+    if (worker_.joinable()) {
+        worker_.join();
+    }
+    if (context_ != nullptr) {
+        glfwDestroyWindow(context_);
+    }
+}
+
+std::uint64_t UploadThread::submit(
+    const unsigned char* pixels,
+    int width,
+    int height,
+    int channels,
+    int row_length,
+    std::shared_ptr<const void> owner
+) {
+    std::uint64_t ticket;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        ticket = next_ticket_++;
+        queue_.push_back(Request{ticket, pixels, width, height, channels, row_length, std::move(owner)});
+        in_flight_++;
+    }
+    wake_worker_.notify_one();
+    return ticket;
+}
+
+bool UploadThread::take(std::uint64_t ticket, UploadedTexture& result) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = ready_.find(ticket);
+    if (it == ready_.end()) {
+        return false;
+    }
+    result = it->second;
+    ready_.erase(it);
+    return true;
+}
+
+void UploadThread::discard(std::uint64_t ticket) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    auto ready = ready_.find(ticket);
+    if (ready != ready_.end()) {
+        GLuint texture = ready->second.texture;
+        ready_.erase(ready);
+        lock.unlock();
+        if (texture != 0) {
+            glDeleteTextures(1, &texture);
+        }
+        return;
+    }
+
+    auto queued = std::find_if(queue_.begin(), queue_.end(),
+                               [ticket](const Request& request) { return request.ticket == ticket; });
+    if (queued != queue_.end()) {
+        queue_.erase(queued);
+        in_flight_--;
+    } else {
+        // Being uploaded right now; the worker deletes the texture when done
+        discarded_.insert(ticket);
+    }
+}
+
+std::size_t UploadThread::in_flight() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return in_flight_;
+}
+
+std::size_t UploadThread::uploaded_bytes() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return uploaded_bytes_;
+}
+
+void UploadThread::run() {
+    glfwMakeContextCurrent(context_);
+    const bool fences = GLAD_GL_VERSION_3_2 || GLAD_GL_ARB_sync;
+    spdlog::info("Texture upload thread started ({})", fences ? "fence sync" : "glFinish, no sync objects");
+
+    std::vector<Request> batch;
+    std::vector<std::pair<std::uint64_t, UploadedTexture>> finished;
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        wake_worker_.wait(lock, [this] { return stop_ || !queue_.empty(); });
+        if (stop_) {
+            break;
+        }
+
+        std::size_t batch_bytes = 0;
+        while (!queue_.empty() && (batch.empty() || batch_bytes < kMaxBatchBytes)) {
+            const Request& next = queue_.front();
+            batch_bytes += static_cast<std::size_t>(next.width) * next.height * next.channels;
+            batch.push_back(std::move(queue_.front()));
+            queue_.pop_front();
+        }
+        lock.unlock();
+
+        auto start = std::chrono::steady_clock::now();
+        for (Request& request : batch) {
+            UploadedTexture texture{0, request.width, request.height};
+            if (!create_or_update_texture(texture.texture, request.pixels, request.width, request.height,
+                                          request.channels, "upload", request.row_length) &&
+                texture.texture != 0) {
+                glDeleteTextures(1, &texture.texture);
+                texture.texture = 0;
+            }
+            // glTexImage2D copied the client memory before returning
+            request.owner.reset();
+            finished.emplace_back(request.ticket, texture);
+        }
+
+        // The textures are handed out only once the GPU has them
+        if (fences) {
+            GLsync fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+            GLenum status = GL_TIMEOUT_EXPIRED;
+            GLbitfield flags = GL_SYNC_FLUSH_COMMANDS_BIT;
+            while (status == GL_TIMEOUT_EXPIRED) {
+                status = glClientWaitSync(fence, flags, kFenceTimeoutNs);
+                flags = 0;
+            }
+            glDeleteSync(fence);
+        } else {
+            glFinish();
+        }
+        Metrics::record(Metrics::Latency::UPLOAD, std::chrono::steady_clock::now() - start);
+
+        lock.lock();
+        for (auto& [ticket, texture] : finished) {
+            if (discarded_.erase(ticket) > 0) {
+                if (texture.texture != 0) {
+                    glDeleteTextures(1, &texture.texture);
+                }
+            } else {
+                ready_.emplace(ticket, texture);
+            }
+        }
+        in_flight_ -= batch.size();
+        uploaded_bytes_ += batch_bytes;
+        batch.clear();
+        finished.clear();
+
+        lock.unlock();
+        if (wake_) {
+            wake_();
+        }
+        lock.lock();
+    }
+
+    // Nobody is going to take these any more
+    for (auto& entry : ready_) {
+        if (entry.second.texture != 0) {
+            glDeleteTextures(1, &entry.second.texture);
+        }
+    }
+    ready_.clear();
+    queue_.clear();
+    in_flight_ = 0;
+    lock.unlock();
+
+    glFinish();
+    glfwMakeContextCurrent(nullptr);
+}
+
+bool start_upload_thread(GLFWwindow* window, std::function<void()> wake) {
+    auto thread = std::make_unique<UploadThread>(window, std::move(wake));
+    if (!thread->running()) {
+        return false;
+    }
+    g_upload_thread = std::move(thread);
+    return true;
+}
+
+void stop_upload_thread() {
+    g_upload_thread.reset();
+}
+
+UploadThread* upload_thread() {
+    return g_upload_thread.get();
+}
+
+} // namespace Display
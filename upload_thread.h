@@ -0,0 +1,145 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+
+struct GLFWwindow;
+
+namespace Display {
+
+    /**
+     * @brief Texture finished by the upload thread
+     */
+    struct UploadedTexture {
+        GLuint texture = 0;  ///< 0 when the upload failed
+        int width = 0;
+        int height = 0;
+    };
+
+    /**
+     * @brief Texture uploads on a second GL context that shares objects with the window's
+     *
+     * Large glTexImage2D calls stall the thread that issues them; here they run
+     * on a worker thread with its own hidden GLFW context, so the render loop
+     * keeps drawing the previous textures meanwhile. Every batch of uploads is
+     * followed by a fence (glFenceSync) that the worker waits on before the
+     * textures are handed out, so the render thread never samples a texture the
+     * driver is still filling. Without sync objects (GL < 3.2 and no ARB_sync)
+     * the worker falls back to glFinish.
+     *
+     * submit() returns a ticket; the render thread polls take() for it and
+     * then owns the texture. Pixels are read by the worker, so the request
+     * keeps an owner (e.g. the PixelBuffer the pixels point into) alive until
+     * the upload call returned.
+     */
+    class UploadThread {
+    public:
+        /**
+         * Create the shared context and start the worker.
+         *
+         * Must be called on the main thread (GLFW creates windows there only).
+         *
+         * @param share Window whose context the uploaded textures are used in
+         * @param wake Called on the worker after textures became ready, to wake the render loop
+         */
+        UploadThread(GLFWwindow* share, std::function<void()> wake);
+        /// Stops the worker and deletes textures nobody took (main thread, window still alive)
+        ~UploadThread();
+        UploadThread(const UploadThread&) = delete;
+        UploadThread& operator=(const UploadThread&) = delete;
+
+        /// False when the shared context could not be created; submit() must not be used then
+        bool running() const { return worker_.joinable(); }
+
+        /**
+         * Queue a texture upload.
+         *
+         * @param pixels First pixel of the region to upload
+         * @param width Width of the region
+         * @param height Height of the region
+         * @param channels Number of channels (3 or 4)
+         * @param row_length Pixels per source row, 0 when rows are tightly packed
+         * @param owner Keeps pixels alive until the upload call returned
+         * @return Ticket for take() / discard(), never 0
+         */
+        std::uint64_t submit(
+            const unsigned char* pixels,
+            int width,
+            int height,
+            int channels,
+            int row_length,
+            std::shared_ptr<const void> owner
+        );
+
+        /**
+         * Collect a finished upload; the caller owns the texture afterwards.
+         *
+         * @return False while the upload is still queued or in flight
+         */
+        bool take(std::uint64_t ticket, UploadedTexture& result);
+
+        /// Forget a ticket: a queued upload is dropped, a finished texture deleted (render thread)
+        void discard(std::uint64_t ticket);
+
+        /// Uploads queued or in flight
+        std::size_t in_flight() const;
+        /// Bytes uploaded by the worker so far
+        std::size_t uploaded_bytes() const;
+
+    private:
+        struct Request {
+            std::uint64_t ticket = 0;
+            const unsigned char* pixels = nullptr;
+            int width = 0;
+            int height = 0;
+            int channels = 0;
+            int row_length = 0;
+            std::shared_ptr<const void> owner;
+        };
+
+        void run();
+
+        GLFWwindow* context_ = nullptr;
+        std::function<void()> wake_;
+        std::thread worker_;
+
+        mutable std::mutex mutex_;
+        std::condition_variable wake_worker_;
+        bool stop_ = false;
+        std::uint64_t next_ticket_ = 1;
+        std::deque<Request> queue_;
+        std::size_t in_flight_ = 0;                       ///< queue_ plus the batch being uploaded
+        std::unordered_set<std::uint64_t> discarded_;     ///< Discarded while in the worker's batch
+        std::unordered_map<std::uint64_t, UploadedTexture> ready_;
+        std::size_t uploaded_bytes_ = 0;
+    };
+
+    /**
+     * Start the shared upload thread used by TiledTexture.
+     *
+     * Call on the main thread after the GL loader ran, with the window's
+     * context current.
+     *
+     * @param window Main window
+     * @param wake Wakes the render loop when uploads finished
+     * @return True when uploads now run off the render thread
+     */
+    bool start_upload_thread(GLFWwindow* window, std::function<void()> wake);
+
+    /// Stop the upload thread; textures not taken yet are deleted (main thread)
+    void stop_upload_thread();
+
+    /// The running upload thread, nullptr when uploads are synchronous
+    UploadThread* upload_thread();
+
+} // namespace Display
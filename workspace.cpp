@@ -0,0 +1,1089 @@
+#include "workspace.h"
+
+#include "imgui.h"
+#include <spdlog/spdlog.h>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
+
+#include "jpeg_decoder.h"
+#include "memory_governor.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+
+// load image
+unsigned char *load_image(const std::string &path, int &width, int &height,
+                          int &channels) {
+  unsigned char *pixels =
+      stbi_load(path.c_str(), &width, &height, &channels, STBI_rgb);
+  if (!pixels) {
+    spdlog::error("Failed to load image: {}", path.c_str());
+  }
+  return pixels;
+}
+
+// Bilinear interpolation downscaling function
+unsigned char* downscale_image_bilinear(const unsigned char* src_data, 
+                                       int src_width, int src_height, int channels,
+                                       int dst_width, int dst_height) {
+  unsigned char* dst_data = new unsigned char[dst_width * dst_height * channels];
+  
+  float x_ratio = (float)src_width / dst_width;
+  float y_ratio = (float)src_height / dst_height;
+  
+  for (int y = 0; y < dst_height; y++) {
+    for (int x = 0; x < dst_width; x++) {
+      float src_x = x * x_ratio;
+      float src_y = y * y_ratio;
+      
+      int x1 = (int)src_x;
+      int y1 = (int)src_y;
+      int x2 = std::min(x1 + 1, src_width - 1);
+      int y2 = std::min(y1 + 1, src_height - 1);
+      
+      float dx = src_x - x1;
+      float dy = src_y - y1;
+      
+      for (int c = 0; c < channels; c++) {
+        // Get the four surrounding pixels
+        float p11 = src_data[(y1 * src_width + x1) * channels + c];
+        float p12 = src_data[(y1 * src_width + x2) * channels + c];
+        float p21 = src_data[(y2 * src_width + x1) * channels + c];
+        float p22 = src_data[(y2 * src_width + x2) * channels + c];
+        
+        // Bilinear interpolation
+        float interpolated = p11 * (1 - dx) * (1 - dy) +
+                           p12 * dx * (1 - dy) +
+                           p21 * (1 - dx) * dy +
+                           p22 * dx * dy;
+        
+        dst_data[(y * dst_width + x) * channels + c] = (unsigned char)std::round(interpolated);
+      }
+    }
+  }
+  
+  return dst_data;
+}
+
+// Wrap buffers from stb_image / new[] so jobs and the UI can share them
+static PixelBuffer adopt_stb_pixels(unsigned char *pixels) {
+  return PixelBuffer(pixels, [](unsigned char *p) { stbi_image_free(p); });
+}
+
+static PixelBuffer adopt_array_pixels(unsigned char *pixels) {
+  return PixelBuffer(pixels, std::default_delete<unsigned char[]>());
+}
+
+template <typename T> static bool is_ready(const std::future<T> &future) {
+  return future.valid() &&
+         future.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+}
+
+// Slider range of the target width in percent of the original
+static constexpr float kMinScalePerc = 10.0f;
+static constexpr float kMaxScalePerc = 100.0f;
+
+static int target_width_for(const ImageDocument &doc, float scale_perc) {
+  return (int)(doc.img_w * scale_perc / 100.0f);
+}
+
+static const char *algorithm_name(SeamCarving::Algorithm algorithm) {
+  return (algorithm == SeamCarving::Algorithm::GREEDY) ? "Greedy" : "Dynamic Programming";
+}
+
+Workspace::Workspace(Jobs::JobPool &pool, std::function<void()> wake)
+    : pool_(pool), wake_(std::move(wake)) {}
+
+void Workspace::open(const std::string &path) {
+  auto doc = std::make_unique<ImageDocument>();
+  doc->id = next_id_++;
+  doc->path = path;
+  std::string file_name = path.substr(path.find_last_of("/\\") + 1);
+  doc->title = fmt::format("{}##image{}", file_name, doc->id);
+  launch_load(*doc);
+  documents_.push_back(std::move(doc));
+}
+
+void Workspace::clear() {
+  for (auto &doc : documents_) {
+    close(*doc);
+  }
+  documents_.clear();
+}
+
+void Workspace::close(ImageDocument &doc) {
+  doc.load_handle.cancel();
+  doc.order_handle.cancel();
+  doc.recompute_handle.cancel();
+  doc.speculation_handle.cancel();
+  doc.warped_view.clear();
+  doc.original_view.clear();
+  doc.carved_view.clear();
+  doc.primitive_view.clear();
+}
+
+// Record a seam order on the DCT block energy of a JPEG. Entropy decoding
+// alone is a fraction of a full decode, and the block grid has 1/64 of the
+// pixels, so this is ready long before the exact order.
+static CoarseOrder compute_coarse_order(const std::string &path, SeamCarving::Algorithm algorithm,
+                                        Jobs::JobContext &ctx) {
+  CoarseOrder coarse;
+  Jpeg::BlockEnergy blocks;
+  if (!Jpeg::read_block_energy(path, blocks)) {
+    return coarse;
+  }
+
+  // Only whole blocks are carved; a partial last block column is always kept
+  int width = std::min(blocks.blocks_x, blocks.image_width / blocks.block_width);
+  int min_width = (int)(blocks.image_width * kMinScalePerc / 100.0f);
+  int coarse_min = (min_width + blocks.block_width - 1) / blocks.block_width;
+  if (width <= coarse_min) {
+    return coarse;
+  }
+
+  auto order = std::make_shared<Memory::LargeBuffer<int>>(static_cast<size_t>(width) * blocks.blocks_y);
+  SeamCarving::CarveBuffers buffers;
+  SeamCarving::MatrixView<const float> energy{blocks.values.data(), width, blocks.blocks_y, blocks.blocks_x};
+  coarse.seams = SeamCarving::compute_seam_order_from_energy(
+      energy, coarse_min, {order->data(), width, blocks.blocks_y, width}, buffers, algorithm,
+      [&ctx](int, int) { return ctx.checkpoint(); });
+  coarse.order = std::move(order);
+  coarse.width = width;
+  coarse.height = blocks.blocks_y;
+  coarse.factor_x = blocks.block_width;
+  coarse.factor_y = blocks.block_height;
+  coarse.algorithm = algorithm;
+  spdlog::info("Coarse seam order ready: {} block seams of {} px ({} algorithm)", coarse.seams,
+               coarse.factor_x, algorithm_name(algorithm));
+  return coarse;
+}
+
+// Decode the image on the pool so the UI is interactive at startup.
+// JPEGs first publish a DCT-scaled preview, then the full decode follows.
+void Workspace::launch_load(ImageDocument &doc) {
+  auto preview_promise = std::make_shared<std::promise<PreviewImage>>();
+  auto full_promise = std::make_shared<std::promise<FullImage>>();
+  doc.preview_future = preview_promise->get_future();
+  doc.full_future = full_promise->get_future();
+
+  std::string path = doc.path;
+  SeamCarving::Algorithm algorithm = doc.selected_algorithm;
+  std::function<void()> wake = wake_;
+  doc.load_handle = pool_.submit(doc.priority, [=](Jobs::JobContext &ctx) {
+    PreviewImage preview;
+    bool jpeg = Jpeg::is_jpeg(path);
+    if (jpeg && !Jpeg::decode_scaled(path, 256, preview.pixels, preview.width, preview.height,
+                                     preview.full_width, preview.full_height)) {
+      preview.pixels.clear();
+    }
+    preview_promise->set_value(std::move(preview));
+    wake();
+
+    if (!ctx.checkpoint()) {
+      return;
+    }
+
+    FullImage full;
+    if (jpeg) {
+      full.coarse_order = compute_coarse_order(path, algorithm, ctx);
+      if (!ctx.checkpoint()) {
+        return;
+      }
+    }
+
+    unsigned char *pixels = load_image(path, full.width, full.height, full.channels);
+    if (pixels) {
+      // load_image always requests RGB from stb
+      full.pixels = adopt_stb_pixels(pixels);
+      full.channels = 3;
+      full.levels = Display::build_pyramid(pixels, full.width, full.height, full.channels);
+    }
+    full_promise->set_value(std::move(full));
+    wake();
+  });
+}
+
+// DP storage modes a job can fall back to, fastest first. With the 16-bit
+// search selected it replaces the full float table.
+using DpModes = std::array<SeamCarving::DpMemory, 3>;
+
+static DpModes dp_modes(bool quantized) {
+  return {quantized ? SeamCarving::DpMemory::QUANTIZED : SeamCarving::DpMemory::FULL,
+          SeamCarving::DpMemory::BACKPOINTERS, SeamCarving::DpMemory::CHECKPOINTED};
+}
+
+// Reserve a job's memory with the governor, in the first DP mode that fits.
+// While none does the job queues outside the pool, so other jobs use its
+// slot in the meantime; invalid when cancelled. Take no locks before it.
+static Memory::MemoryGovernor::Reservation
+reserve_memory(const DpModes &modes, const std::function<size_t(SeamCarving::DpMemory)> &footprint,
+               Jobs::JobContext &ctx) {
+  std::vector<size_t> options;
+  for (SeamCarving::DpMemory mode : modes) {
+    options.push_back(footprint(mode));
+  }
+  bool queued = false;
+  Memory::MemoryGovernor::Reservation reservation =
+      Memory::MemoryGovernor::instance().reserve(std::move(options), [&ctx, &queued] {
+        if (!queued) {
+          ctx.leave_slot();
+          queued = true;
+        }
+        return !ctx.cancelled();
+      });
+  if (queued) {
+    ctx.rejoin_slot();
+  }
+  return reservation;
+}
+
+// Called between seams: while another job waits for memory, switch to the
+// next smaller DP mode and hand the difference back
+static void yield_memory(const DpModes &modes, Memory::MemoryGovernor::Reservation &reservation,
+                         const std::function<void(SeamCarving::DpMemory)> &set_mode) {
+  if (reservation.pressured()) {
+    set_mode(modes[reservation.level() + 1]);
+    reservation.degrade();
+  }
+}
+
+// Give a carver the DP mode of its new reservation. Its seams stay when it
+// only moves between float modes; turning the 16-bit search off goes through
+// FULL so they are dropped even when less memory is left.
+static void set_carver_dp_memory(SeamCarving::Carver &carver, const DpModes &modes, int level) {
+  if (carver.dp_memory() == SeamCarving::DpMemory::QUANTIZED && modes[0] != SeamCarving::DpMemory::QUANTIZED) {
+    carver.set_dp_memory(SeamCarving::DpMemory::FULL);
+  }
+  carver.set_dp_memory(modes[level]);
+}
+
+// Energy added to protected pixels; far above any Sobel energy (< 1500), so
+// even the DP sum over a whole column cannot make crossing them worthwhile
+static constexpr float kProtectionWeight = 1e6f;
+
+// Paint brush dabs into the carver's protection map, one bounding box each
+static void apply_protection_dabs(SeamCarving::Carver &carver, const std::vector<ProtectionDab> &dabs) {
+  std::vector<float> weights;
+  for (const ProtectionDab &dab : dabs) {
+    int x0 = std::max(0, dab.x - dab.radius), x1 = std::min(carver.width(), dab.x + dab.radius + 1);
+    int y0 = std::max(0, dab.y - dab.radius), y1 = std::min(carver.height(), dab.y + dab.radius + 1);
+    if (x0 >= x1 || y0 >= y1) {
+      continue;
+    }
+    int w = x1 - x0, h = y1 - y0;
+    weights.resize(static_cast<size_t>(w) * h);
+    SeamCarving::MatrixView<const float> current = carver.protection();
+    for (int y = y0; y < y1; y++) {
+      for (int x = x0; x < x1; x++) {
+        int dx = x - dab.x, dy = y - dab.y;
+        bool inside = dx * dx + dy * dy <= dab.radius * dab.radius;
+        float old_weight = current.data ? current.row(y)[x] : 0.0f;
+        weights[static_cast<size_t>(y - y0) * w + (x - x0)] = inside ? dab.weight : old_weight;
+      }
+    }
+    carver.update_protection(x0, y0, {weights.data(), w, h, w});
+  }
+}
+
+// Record the removal order of every pixel down to the slider minimum. Once it
+// is known, every slider position is a cheap gather (CPU) or lookup (GPU).
+// The document's carver keeps its seams between jobs, so after protection
+// edits only the seams from the first affected one onward are recomputed.
+void Workspace::launch_order(ImageDocument &doc) {
+  doc.order_handle.cancel();
+  cancel_speculation(doc);
+
+  auto promise = std::make_shared<std::promise<SeamOrder>>();
+  doc.order_future = promise->get_future();
+
+  PixelBuffer image_data = doc.image_data;
+  int img_w = doc.img_w, img_h = doc.img_h, img_channels = doc.img_channels;
+  int min_width = std::max(1, target_width_for(doc, kMinScalePerc));
+  SeamCarving::Algorithm algorithm = doc.selected_algorithm;
+  float smoothing = doc.smoothing_sigma;
+  std::shared_ptr<CarverSlot> slot = doc.carver;
+  DpModes modes = dp_modes(quantized_dp_);
+  std::function<void()> wake = wake_;
+
+  doc.order_handle = pool_.submit(doc.priority, [=](Jobs::JobContext &ctx) {
+    Memory::MemoryGovernor::Reservation reservation = reserve_memory(
+        modes,
+        [&](SeamCarving::DpMemory mode) {
+          return SeamCarving::Carver::footprint(img_w, img_h, img_channels, img_w - min_width, mode,
+                                                smoothing > 0.0f);
+        },
+        ctx);
+    if (!reservation.valid()) {
+      return;
+    }
+
+    // A superseded job gives the carver up at its next seam
+    std::lock_guard<std::mutex> lock(slot->carve_mutex);
+    SeamCarving::Carver &carver = slot->carver;
+    set_carver_dp_memory(carver, modes, reservation.level());
+
+    if (carver.width() == 0) {
+      carver.set_image(SeamCarving::ImageView::packed(image_data.get(), img_w, img_h, img_channels));
+    }
+    carver.set_algorithm(algorithm);
+    carver.set_smoothing(smoothing);
+    // The blur is one full pass when a carve starts; it shares the slots
+    // with the other running jobs
+    carver.set_threads(ctx.thread_share());
+
+    std::vector<ProtectionDab> dabs;
+    {
+      std::lock_guard<std::mutex> dabs_lock(slot->dabs_mutex);
+      dabs.swap(slot->pending_dabs);
+    }
+    apply_protection_dabs(carver, dabs);
+
+    // An aborted carve keeps its completed seams for the next job. The scratch
+    // goes back with the reservation: only running jobs can degrade theirs, so
+    // an idle carver must not hold memory queued jobs wait for.
+    carver.carve(min_width, [&](int, int) {
+      yield_memory(modes, reservation, [&carver](SeamCarving::DpMemory mode) { carver.set_dp_memory(mode); });
+      return ctx.checkpoint();
+    });
+    carver.release_scratch();
+    if (ctx.cancelled()) {
+      return;
+    }
+    SeamCarving::MatrixView<const int> map = carver.seam_order();
+    auto order = std::make_shared<Memory::LargeBuffer<int>>(map.data, map.data + static_cast<size_t>(img_w) * img_h);
+    spdlog::info("Seam order map ready ({} algorithm, down to {} px, {} seams reused)",
+                 algorithm_name(algorithm), min_width, carver.reused_seams());
+    promise->set_value(std::move(order));
+    wake();
+  });
+}
+
+// Drop every speculative result; jobs still running publish nothing
+static void drop_speculation(SpeculationCache &cache) {
+  std::lock_guard<std::mutex> lock(cache.mutex);
+  cache.generation++;
+  cache.results.clear();
+  cache.orders.clear();
+  cache.slot = std::make_shared<CarverSlot>();
+}
+
+// Queue a brush dab at image pixel (x, y) and refresh the order map. Dabs are
+// spaced half a radius apart, which keeps strokes continuous.
+void Workspace::paint_protection(ImageDocument &doc, int x, int y, float view_scale) {
+  ImGui::GetForegroundDrawList()->AddCircle(ImGui::GetIO().MousePos, doc.brush_radius * view_scale,
+                                            IM_COL32(255, 96, 64, 255));
+  bool protect = ImGui::IsMouseDown(0);
+  bool erase = ImGui::IsMouseDown(1);
+  if (!protect && !erase) {
+    doc.last_dab_x = doc.last_dab_y = -1;
+    return;
+  }
+
+  int spacing = std::max(1, doc.brush_radius / 2);
+  if (doc.last_dab_x >= 0 && std::abs(x - doc.last_dab_x) < spacing && std::abs(y - doc.last_dab_y) < spacing) {
+    return;
+  }
+  doc.last_dab_x = x;
+  doc.last_dab_y = y;
+  {
+    std::lock_guard<std::mutex> lock(doc.carver->dabs_mutex);
+    doc.carver->pending_dabs.push_back({x, y, doc.brush_radius, protect ? kProtectionWeight : 0.0f});
+  }
+  // Everything speculated so far assumed the old protection map
+  drop_speculation(*doc.speculation);
+  launch_order(doc);
+}
+
+void Workspace::set_quantized_dp(bool quantized) {
+  if (quantized == quantized_dp_) {
+    return;
+  }
+  quantized_dp_ = quantized;
+  // DYNAMIC order maps, including speculative ones, came from the other search
+  for (auto &doc : documents_) {
+    drop_speculation(*doc->speculation);
+    if (doc->image_loaded && doc->selected_algorithm == SeamCarving::Algorithm::DYNAMIC) {
+      launch_order(*doc);
+    }
+  }
+}
+
+bool Workspace::warp_active(const ImageDocument &doc) const {
+  return doc.seam_order && doc.warped_view.has_source();
+}
+
+// Carved image at target_width gathered from an order map, with its pyramid
+static void gather_carved(const SeamCarving::ImageView &source, const SeamOrder &seam_order, int target_width,
+                          RecomputeResult &result) {
+  result.carved_pixels = adopt_array_pixels(
+      new unsigned char[static_cast<size_t>(target_width) * source.height * source.channels]);
+  SeamCarving::carve_from_order(
+      source, {seam_order->data(), source.width, source.height, source.width},
+      SeamCarving::MutableImageView::packed(result.carved_pixels.get(), target_width, source.height, source.channels));
+  result.carved_width = target_width;
+  result.carved_levels = Display::build_pyramid(
+      result.carved_pixels.get(), target_width, source.height, source.channels);
+}
+
+// Bilinear (horizontal only) resize at target_width, with its pyramid
+static void resize_primitive(const unsigned char *image, int img_w, int img_h, int img_channels, int target_width,
+                             RecomputeResult &result) {
+  result.primitive_pixels = adopt_array_pixels(downscale_image_bilinear(
+      image, img_w, img_h, img_channels, target_width, img_h));
+  result.primitive_levels = Display::build_pyramid(
+      result.primitive_pixels.get(), target_width, img_h, img_channels);
+  result.target_width = target_width;
+}
+
+// Speculation: whole percent slider steps precomputed on either side of the
+// current position, and what the cache may keep alive
+static constexpr int kSpeculativeSteps = 2;
+static constexpr size_t kSpeculativeBytes = size_t{256} << 20;
+static constexpr size_t kSpeculativeOrders = 2;
+
+// Pixels and pyramids a result keeps alive
+static size_t result_bytes(const RecomputeResult &result, int height, int channels) {
+  size_t bytes = static_cast<size_t>(result.carved_width + result.target_width) * height * channels;
+  for (const std::vector<Display::PyramidLevel> *levels : {&result.carved_levels, &result.primitive_levels}) {
+    for (const Display::PyramidLevel &level : *levels) {
+      bytes += level.pixels.size();
+    }
+  }
+  return bytes;
+}
+
+// A cached result serves a request of the same width; the carved image also
+// has to match algorithm and blur. Primitive-only results serve the warp view.
+static bool speculative_match(const SpeculativeResult &entry, SeamCarving::Algorithm algorithm, float smoothing,
+                              int target_width, bool carve) {
+  if (entry.result.target_width != target_width) {
+    return false;
+  }
+  return !carve || (entry.result.carved_pixels && entry.algorithm == algorithm && entry.smoothing == smoothing);
+}
+
+static bool has_speculative_result(SpeculationCache &cache, SeamCarving::Algorithm algorithm, float smoothing,
+                                   int target_width, bool carve) {
+  std::lock_guard<std::mutex> lock(cache.mutex);
+  return std::any_of(cache.results.begin(), cache.results.end(), [&](const SpeculativeResult &entry) {
+    return speculative_match(entry, algorithm, smoothing, target_width, carve);
+  });
+}
+
+// Move a matching result out of the cache, with the protection generation
+// it was made for; false when there is none
+static bool take_speculative_result(SpeculationCache &cache, SeamCarving::Algorithm algorithm, float smoothing,
+                                    int target_width, bool carve, SpeculativeResult &entry, int &generation) {
+  std::lock_guard<std::mutex> lock(cache.mutex);
+  auto it = std::find_if(cache.results.begin(), cache.results.end(), [&](const SpeculativeResult &cached) {
+    return speculative_match(cached, algorithm, smoothing, target_width, carve);
+  });
+  if (it == cache.results.end()) {
+    return false;
+  }
+  entry = std::move(*it);
+  generation = cache.generation;
+  cache.results.erase(it);
+  return true;
+}
+
+// Add a result made for the given protection generation; the oldest ones
+// make room when the cache is over its byte budget
+static void store_speculative_result(SpeculationCache &cache, int generation, SpeculativeResult entry, int height,
+                                     int channels) {
+  std::lock_guard<std::mutex> lock(cache.mutex);
+  if (cache.generation != generation) {
+    return;
+  }
+  cache.results.push_back(std::move(entry));
+  size_t bytes = 0;
+  for (const SpeculativeResult &cached : cache.results) {
+    bytes += result_bytes(cached.result, height, channels);
+  }
+  while (cache.results.size() > 1 && bytes > kSpeculativeBytes) {
+    bytes -= result_bytes(cache.results.front().result, height, channels);
+    cache.results.erase(cache.results.begin());
+  }
+}
+
+static SeamOrder find_speculative_order(SpeculationCache &cache, SeamCarving::Algorithm algorithm,
+                                        float smoothing) {
+  std::lock_guard<std::mutex> lock(cache.mutex);
+  for (const SpeculativeOrder &entry : cache.orders) {
+    if (entry.algorithm == algorithm && entry.smoothing == smoothing) {
+      return entry.order;
+    }
+  }
+  return nullptr;
+}
+
+static void store_speculative_order(SpeculationCache &cache, int generation, SpeculativeOrder entry) {
+  std::lock_guard<std::mutex> lock(cache.mutex);
+  if (cache.generation != generation) {
+    return;
+  }
+  cache.orders.erase(std::remove_if(cache.orders.begin(), cache.orders.end(),
+                                    [&](const SpeculativeOrder &cached) {
+                                      return cached.algorithm == entry.algorithm && cached.smoothing == entry.smoothing;
+                                    }),
+                     cache.orders.end());
+  cache.orders.push_back(std::move(entry));
+  if (cache.orders.size() > kSpeculativeOrders) {
+    cache.orders.erase(cache.orders.begin());
+  }
+}
+
+void Workspace::cancel_speculation(ImageDocument &doc) {
+  doc.speculation_handle.cancel();
+  doc.speculation_stale = true;
+}
+
+// Spend idle time on what the user is likely to ask for next: the slider
+// widths around the current one, each a gather from the order map that is
+// already there, and the order map of the other algorithm, which turns an
+// algorithm switch into a lookup. Every speculative width comes from an
+// order map, so one energy pass per algorithm serves them all. The job runs
+// at BACKGROUND priority, which parks it at the next checkpoint whenever
+// anything else waits, and each real request of the document cancels it.
+void Workspace::launch_speculation(ImageDocument &doc) {
+  doc.speculation_stale = false;
+
+  std::shared_ptr<SpeculationCache> cache = doc.speculation;
+  int generation;
+  std::shared_ptr<CarverSlot> slot;
+  {
+    std::lock_guard<std::mutex> lock(cache->mutex);
+    generation = cache->generation;
+    slot = cache->slot;
+  }
+  PixelBuffer image_data = doc.image_data;
+  int img_w = doc.img_w, img_h = doc.img_h, img_channels = doc.img_channels;
+  int min_width = std::max(1, target_width_for(doc, kMinScalePerc));
+  int current_width = target_width_for(doc, doc.target_scale_perc);
+  SeamCarving::Algorithm algorithm = doc.selected_algorithm;
+  SeamCarving::Algorithm alternate = (algorithm == SeamCarving::Algorithm::GREEDY)
+                                         ? SeamCarving::Algorithm::DYNAMIC
+                                         : SeamCarving::Algorithm::GREEDY;
+  float smoothing = doc.smoothing_sigma;
+  bool carve = !warp_active(doc);
+  SeamOrder seam_order = doc.seam_order;
+  std::shared_ptr<CarverSlot> document_slot = doc.carver;
+  DpModes modes = dp_modes(quantized_dp_);
+  std::function<void()> wake = wake_;
+
+  // Nearest first; without the order map a carved width would be a full carve
+  std::vector<int> widths;
+  size_t result_estimate = static_cast<size_t>(carve ? 2 : 1) * current_width * img_h * img_channels * 4 / 3;
+  if ((seam_order || !carve) && result_estimate * 2 * kSpeculativeSteps <= kSpeculativeBytes) {
+    for (int step = 1; step <= kSpeculativeSteps; step++) {
+      for (int direction : {1, -1}) {
+        float perc = std::round(doc.target_scale_perc) + direction * step;
+        int width = target_width_for(doc, perc);
+        if (perc >= kMinScalePerc && perc <= kMaxScalePerc && width > 0 && width != current_width) {
+          widths.push_back(width);
+        }
+      }
+    }
+  }
+  bool alternate_needed = !find_speculative_order(*cache, alternate, smoothing);
+  if (widths.empty() && !alternate_needed) {
+    return;
+  }
+
+  doc.speculation_handle = pool_.submit(Jobs::Priority::BACKGROUND, [=](Jobs::JobContext &ctx) {
+    SeamCarving::ImageView source =
+        SeamCarving::ImageView::packed(image_data.get(), img_w, img_h, img_channels);
+    auto speculate_width = [&](SeamCarving::Algorithm order_algorithm, const SeamOrder &order, int width) {
+      if (has_speculative_result(*cache, order_algorithm, smoothing, width, carve)) {
+        return;
+      }
+      SpeculativeResult entry{order_algorithm, smoothing, {}};
+      if (carve) {
+        gather_carved(source, order, width, entry.result);
+      }
+      resize_primitive(image_data.get(), img_w, img_h, img_channels, width, entry.result);
+      store_speculative_result(*cache, generation, std::move(entry), img_h, img_channels);
+    };
+
+    for (int width : widths) {
+      if (!ctx.checkpoint()) {
+        return;
+      }
+      speculate_width(algorithm, seam_order, width);
+    }
+
+    if (alternate_needed && ctx.checkpoint()) {
+      auto footprint = [&](SeamCarving::DpMemory mode) {
+        return SeamCarving::Carver::footprint(img_w, img_h, img_channels, img_w - min_width, mode, smoothing > 0.0f);
+      };
+      // Speculation only takes memory nobody else is waiting for
+      Memory::MemoryGovernor &governor = Memory::MemoryGovernor::instance();
+      if (governor.budget() > 0 &&
+          (governor.waiting() > 0 || governor.reserved() + footprint(modes.back()) > governor.budget())) {
+        spdlog::info("Not enough spare memory to precompute the {} order map", algorithm_name(alternate));
+        wake();
+        return;
+      }
+      Memory::MemoryGovernor::Reservation reservation = reserve_memory(modes, footprint, ctx);
+      if (!reservation.valid()) {
+        return;
+      }
+
+      std::lock_guard<std::mutex> lock(slot->carve_mutex);
+      SeamCarving::Carver &carver = slot->carver;
+      set_carver_dp_memory(carver, modes, reservation.level());
+
+      if (carver.width() == 0) {
+        // Same protection as the document's carver. A busy carver means an
+        // order job started, and that one cancels this job anyway.
+        std::unique_lock<std::mutex> document_lock(document_slot->carve_mutex, std::try_to_lock);
+        if (!document_lock.owns_lock()) {
+          return;
+        }
+        carver.set_image(source);
+        SeamCarving::MatrixView<const float> protection = document_slot->carver.protection();
+        if (protection.data) {
+          carver.update_protection(0, 0, protection);
+        }
+      }
+      carver.set_algorithm(alternate);
+      carver.set_smoothing(smoothing);
+
+      // A preempted carve keeps its seams; the next speculation resumes there,
+      // with a new reservation
+      carver.carve(min_width, [&](int, int) {
+        yield_memory(modes, reservation, [&carver](SeamCarving::DpMemory mode) { carver.set_dp_memory(mode); });
+        return ctx.checkpoint();
+      });
+      if (ctx.cancelled()) {
+        carver.release_scratch();
+        return;
+      }
+      SeamCarving::MatrixView<const int> map = carver.seam_order();
+      SeamOrder order =
+          std::make_shared<Memory::LargeBuffer<int>>(map.data, map.data + static_cast<size_t>(img_w) * img_h);
+      store_speculative_order(*cache, generation, {alternate, smoothing, order});
+      spdlog::info("Precomputed the {} seam order map", algorithm_name(alternate));
+
+      // Only the order map is kept; the carver's buffers go back to the budget
+      carver = SeamCarving::Carver();
+      reservation.release();
+
+      // The current width under the other algorithm, shown right after a switch
+      if (carve && ctx.checkpoint()) {
+        speculate_width(alternate, order, current_width);
+      }
+    }
+    wake();
+  });
+}
+
+// Run the expensive part of a slider/algorithm change on the pool. A running
+// job for the same document is superseded and cancelled at its next seam.
+void Workspace::launch_recompute(ImageDocument &doc, int target_width) {
+  doc.recompute_handle.cancel();
+  cancel_speculation(doc);
+
+  auto promise = std::make_shared<std::promise<RecomputeResult>>();
+  doc.recompute_future = promise->get_future();
+
+  // Previous results are only used to find the columns that need re-upload
+  PixelBuffer image_data = doc.image_data;
+  PixelBuffer previous_carved = doc.carved_view.valid() ? doc.carved_image_data : nullptr;
+  PixelBuffer previous_primitive = doc.primitive_view.valid() ? doc.primitive_resized_data : nullptr;
+  int previous_carved_width = doc.carved_width;
+  int previous_primitive_width = doc.primitive_target_width;
+  int img_w = doc.img_w, img_h = doc.img_h, img_channels = doc.img_channels;
+  SeamCarving::Algorithm algorithm = doc.selected_algorithm;
+  float smoothing = doc.smoothing_sigma;
+  // The warp shader draws the carved view by itself; otherwise gather from the
+  // order map when it is ready and carve seam by seam until then
+  bool carve = !warp_active(doc);
+  SeamOrder seam_order = doc.seam_order;
+  // Block seams of a JPEG can stand in while the exact order is computed
+  CoarseOrder coarse_order;
+  if (!seam_order && doc.coarse_order.order && doc.coarse_order.algorithm == algorithm && smoothing == 0.0f &&
+      img_w - target_width <= doc.coarse_order.seams * doc.coarse_order.factor_x) {
+    coarse_order = doc.coarse_order;
+  }
+  std::shared_ptr<SpeculationCache> cache = doc.speculation;
+  DpModes modes = dp_modes(quantized_dp_);
+  std::function<void()> wake = wake_;
+
+  doc.recompute_handle = pool_.submit(doc.priority, [=](Jobs::JobContext &ctx) {
+    RecomputeResult result;
+    SeamCarving::ImageView source =
+        SeamCarving::ImageView::packed(image_data.get(), img_w, img_h, img_channels);
+
+    // Speculation may have made this result already. Only a running job
+    // takes it, and a superseded one puts it back for the next slider move.
+    SpeculativeResult precomputed;
+    int generation = 0;
+    bool speculated = !ctx.cancelled() &&
+                      take_speculative_result(*cache, algorithm, smoothing, target_width, carve, precomputed,
+                                              generation);
+    if (speculated) {
+      // Only the dirty columns depend on what is shown now
+      result = std::move(precomputed.result);
+      spdlog::info("Using precomputed result for {}x{}", target_width, img_h);
+    } else {
+      if (carve) {
+        result.carved_pixels = adopt_array_pixels(
+            new unsigned char[static_cast<size_t>(target_width) * img_h * img_channels]);
+        SeamCarving::MutableImageView carved = SeamCarving::MutableImageView::packed(
+            result.carved_pixels.get(), target_width, img_h, img_channels);
+
+        if (seam_order) {
+          SeamCarving::carve_from_order(source, {seam_order->data(), img_w, img_h, img_w}, carved);
+        } else if (coarse_order.order) {
+          SeamCarving::carve_from_coarse_order(
+              source, {coarse_order.order->data(), coarse_order.width, coarse_order.height, coarse_order.width},
+              coarse_order.factor_x, coarse_order.factor_y, carved);
+        } else {
+          spdlog::info("Starting iterative seam carving: {}x{} -> {}x{} using {} algorithm",
+                       img_w, img_h, target_width, img_h, algorithm_name(algorithm));
+
+          // Scratch memory is kept per pool thread, so repeated slider moves do not
+          // allocate; a parked job keeps its thread, so no two jobs share the buffers.
+          // Under a memory budget it is released after each job instead.
+          thread_local SeamCarving::CarveBuffers carve_buffers;
+          Memory::MemoryGovernor::Reservation reservation = reserve_memory(
+              modes, [&](SeamCarving::DpMemory mode) {
+                size_t blur = smoothing > 0.0f ? 4 * sizeof(float) * static_cast<size_t>(img_w) * img_h : 0;
+                return SeamCarving::CarveBuffers::footprint(img_w, img_h, img_channels, mode) + blur;
+              },
+              ctx);
+          if (!reservation.valid()) {
+            return;
+          }
+          carve_buffers.set_dp_memory(modes[reservation.level()]);
+          carve_buffers.threads = ctx.thread_share();
+
+          // Perform iterative seam removal straight into the result buffer;
+          // checkpoints let focused images preempt us
+          SeamCarving::reduce_width_smoothed(source, carved, smoothing, carve_buffers, algorithm, [&](int, int) {
+            yield_memory(modes, reservation, [](SeamCarving::DpMemory mode) { carve_buffers.set_dp_memory(mode); });
+            return ctx.checkpoint();
+          });
+          if (Memory::MemoryGovernor::instance().budget() > 0) {
+            carve_buffers = SeamCarving::CarveBuffers();
+          }
+          if (ctx.cancelled()) {
+            return;
+          }
+        }
+
+        result.carved_width = target_width;
+        result.carved_levels = Display::build_pyramid(
+            result.carved_pixels.get(), result.carved_width, img_h, img_channels);
+        spdlog::info("Seam carving completed: final size {}x{}", result.carved_width, img_h);
+      }
+
+      // Create resized pixel array using bilinear interpolation (horizontal scaling only)
+      spdlog::info("Creating primitive resized image using bilinear interpolation: {}x{} -> {}x{}",
+                   img_w, img_h, target_width, img_h);
+      resize_primitive(image_data.get(), img_w, img_h, img_channels, target_width, result);
+    }
+
+    if (carve && result.carved_pixels) {
+      result.carved_dirty_x0 = Display::first_changed_column(
+          previous_carved.get(), previous_carved_width, result.carved_pixels.get(),
+          result.carved_width, img_h, img_channels);
+    }
+    result.primitive_dirty_x0 = Display::first_changed_column(
+        previous_primitive.get(), previous_primitive_width, result.primitive_pixels.get(),
+        target_width, img_h, img_channels);
+
+    if (speculated) {
+      if (ctx.cancelled()) {
+        precomputed.result = std::move(result);
+        store_speculative_result(*cache, generation, std::move(precomputed), img_h, img_channels);
+        return;
+      }
+      if (!carve) {
+        // The warp shader draws the carved view
+        result.carved_pixels = nullptr;
+        result.carved_levels.clear();
+        result.carved_width = 0;
+      }
+    }
+
+    // Publish before waking so the woken frame sees a ready future
+    promise->set_value(std::move(result));
+    wake();
+  });
+}
+
+void Workspace::update_priority(ImageDocument &doc, Jobs::Priority priority) {
+  if (doc.priority == priority) {
+    return;
+  }
+  doc.priority = priority;
+  doc.load_handle.set_priority(priority);
+  doc.order_handle.set_priority(priority);
+  doc.recompute_handle.set_priority(priority);
+  // Only the focused image speculates; the others resume when focused again
+  if (priority != Jobs::Priority::FOCUSED) {
+    cancel_speculation(doc);
+  }
+}
+
+void Workspace::poll_jobs(ImageDocument &doc) {
+  if (is_ready(doc.preview_future)) {
+    PreviewImage preview = doc.preview_future.get();
+    if (!preview.pixels.empty() && !doc.image_loaded) {
+      doc.preview_data = std::move(preview.pixels);
+      doc.preview_w = preview.width;
+      doc.img_w = preview.full_width;
+      doc.img_h = preview.full_height;
+      doc.original_view.set_image(doc.preview_data.data(), preview.width, preview.height, 3, {});
+    }
+  }
+
+  if (is_ready(doc.full_future)) {
+    FullImage full = doc.full_future.get();
+    if (full.pixels) {
+      doc.image_data = full.pixels;
+      doc.img_w = full.width;
+      doc.img_h = full.height;
+      doc.img_channels = full.channels;
+      doc.coarse_order = std::move(full.coarse_order);
+      spdlog::info("Image loaded successfully: {}x{}x{}", doc.img_w, doc.img_h, doc.img_channels);
+
+      // Only the pyramid level matching the view gets uploaded on draw
+      doc.original_view.set_image(doc.image_data.get(), doc.img_w, doc.img_h,
+                                  doc.img_channels, std::move(full.levels), 0, doc.image_data);
+      doc.preview_data = std::vector<unsigned char>();
+      doc.image_loaded = true;
+
+      // The original is uploaded once for the warp shader (if it fits one texture)
+      if (Display::WarpedTexture::supported() &&
+          !doc.warped_view.set_source(doc.image_data.get(), doc.img_w, doc.img_h, doc.img_channels)) {
+        spdlog::info("Image too large for the warp shader, carved views use CPU results");
+      }
+      launch_order(doc);
+    } else {
+      spdlog::error("Failed to load image: {}", doc.path);
+      doc.original_view.clear();
+      doc.image_failed = true;
+    }
+  }
+
+  if (is_ready(doc.order_future)) {
+    doc.seam_order = doc.order_future.get();
+    doc.warped_width = 0;
+    doc.speculation_stale = true;
+    // Without the warp shader the carved view is gathered on the CPU
+    if (!warp_active(doc)) {
+      doc.recompute_pending = true;
+    }
+  }
+
+  if (is_ready(doc.recompute_future)) {
+    RecomputeResult result = doc.recompute_future.get();
+
+    // Views point into the buffers; replace both together. The buffers also
+    // go along as owners, so their tiles upload off the render thread.
+    if (result.carved_pixels) {
+      doc.carved_image_data = result.carved_pixels;
+      doc.carved_width = result.carved_width;
+      doc.carved_view.set_image(doc.carved_image_data.get(), doc.carved_width, doc.img_h,
+                                doc.img_channels, std::move(result.carved_levels),
+                                result.carved_dirty_x0, doc.carved_image_data);
+    }
+
+    doc.primitive_resized_data = result.primitive_pixels;
+    doc.primitive_target_width = result.target_width;
+    doc.primitive_view.set_image(doc.primitive_resized_data.get(), doc.primitive_target_width,
+                                 doc.img_h, doc.img_channels,
+                                 std::move(result.primitive_levels), result.primitive_dirty_x0,
+                                 doc.primitive_resized_data);
+  }
+}
+
+void Workspace::draw() {
+  // Closed windows cancel their jobs; running ones keep their buffers alive.
+  // Done before drawing so no draw command of this frame refers to them.
+  for (auto it = documents_.begin(); it != documents_.end();) {
+    if (!(*it)->open) {
+      close(**it);
+      it = documents_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+
+  for (auto &doc : documents_) {
+    // Results are collected even for hidden windows
+    poll_jobs(*doc);
+
+    ImGui::SetNextWindowSize(ImVec2(900, 700), ImGuiCond_FirstUseEver);
+    bool visible = ImGui::Begin(doc->title.c_str(), &doc->open);
+    bool focused = visible && ImGui::IsWindowFocused(ImGuiFocusedFlags_RootAndChildWindows);
+    update_priority(*doc, focused ? Jobs::Priority::FOCUSED
+                          : visible ? Jobs::Priority::VISIBLE
+                                    : Jobs::Priority::BACKGROUND);
+    if (visible) {
+      draw_document(*doc);
+    }
+    ImGui::End();
+  }
+
+}
+
+void Workspace::draw_document(ImageDocument &doc) {
+  ImGui::TextDisabled("%s", doc.path.c_str());
+
+  // All three views share the scale that fits the original to the window
+  ImGui::SliderFloat("Zoom", &doc.zoom, 1.0f, 16.0f, "%.1fx", ImGuiSliderFlags_Logarithmic);
+  float fit_scale = std::min(1.0f, ImGui::GetContentRegionAvail().x / std::max(doc.img_w, 1));
+  float view_scale = fit_scale * doc.zoom;
+  float max_view_height = doc.img_h * fit_scale;
+
+  // Protection brush: protected pixels are never removed by a seam
+  ImGui::Checkbox("Protect brush", &doc.protect_mode);
+  if (doc.protect_mode) {
+    ImGui::SameLine();
+    ImGui::SliderInt("Brush radius", &doc.brush_radius, 2, 200);
+    ImGui::TextDisabled("Left drag on the original protects, right drag erases");
+  }
+
+  // Original image
+  ImGui::Text("Original");
+  if (doc.image_loaded && doc.original_view.valid()) {
+    ImVec2 hovered;
+    doc.original_view.draw("original_view", view_scale, max_view_height, &hovered);
+    if (doc.protect_mode && hovered.x >= 0.0f) {
+      paint_protection(doc, static_cast<int>(hovered.x), static_cast<int>(hovered.y), view_scale);
+    } else {
+      doc.last_dab_x = doc.last_dab_y = -1;
+    }
+    ImGui::Text("Level %d, uploaded %.1f KB", doc.original_view.current_level(),
+                doc.original_view.uploaded_bytes() / 1024.0);
+  } else if (doc.original_view.valid()) {
+    // Preview covers the same area as the full image will
+    doc.original_view.draw("original_view", view_scale * doc.img_w / doc.preview_w, max_view_height);
+    ImGui::Text("Loading full resolution image...");
+  } else if (doc.image_failed) {
+    ImGui::Text("Failed to load image");
+  } else {
+    ImGui::Text("Loading image...");
+  }
+
+  // Slider to scale the image from 10 to 100%
+  bool needs_recompute = false;
+  if (ImGui::SliderFloat("Scale Image By", &doc.target_scale_perc, kMinScalePerc, kMaxScalePerc, "%.0f%%")) {
+    needs_recompute = true;
+  }
+
+  // Algorithm selection radio buttons
+  ImGui::Text("Seam Finding Algorithm:");
+  SeamCarving::Algorithm previous_algorithm = doc.selected_algorithm;
+  if (ImGui::RadioButton("Greedy (Fast)", doc.selected_algorithm == SeamCarving::Algorithm::GREEDY)) {
+    doc.selected_algorithm = SeamCarving::Algorithm::GREEDY;
+    needs_recompute = true;
+  }
+  ImGui::SameLine();
+  if (ImGui::RadioButton("Dynamic Programming (Optimal)", doc.selected_algorithm == SeamCarving::Algorithm::DYNAMIC)) {
+    doc.selected_algorithm = SeamCarving::Algorithm::DYNAMIC;
+    needs_recompute = true;
+  }
+  // Blurring the luma first keeps noise and JPEG artefacts from steering seams
+  float previous_smoothing = doc.smoothing_sigma;
+  if (ImGui::SliderFloat("Denoise", &doc.smoothing_sigma, 0.0f, 4.0f, doc.smoothing_sigma > 0.0f ? "sigma %.1f px" : "off")) {
+    needs_recompute = true;
+  }
+  // The order map belongs to one algorithm and blur; until the new one is
+  // ready the recompute below carves on the CPU. Speculation may have it
+  // already, and the current one is kept for switching back.
+  if ((doc.selected_algorithm != previous_algorithm || doc.smoothing_sigma != previous_smoothing) &&
+      doc.image_loaded) {
+    int generation;
+    {
+      std::lock_guard<std::mutex> lock(doc.speculation->mutex);
+      generation = doc.speculation->generation;
+    }
+    if (doc.seam_order && doc.order_handle.done()) {
+      store_speculative_order(*doc.speculation, generation, {previous_algorithm, previous_smoothing, doc.seam_order});
+    }
+    doc.seam_order = find_speculative_order(*doc.speculation, doc.selected_algorithm, doc.smoothing_sigma);
+    doc.warped_width = 0;
+    if (doc.seam_order) {
+      // An order job still running for the old settings must not replace it
+      doc.order_handle.cancel();
+      doc.order_future = std::future<SeamOrder>();
+      cancel_speculation(doc);
+      spdlog::info("Using precomputed {} seam order map", algorithm_name(doc.selected_algorithm));
+    } else {
+      launch_order(doc);
+    }
+  }
+
+  // Requests made while the image is still loading run once it arrives
+  if (needs_recompute) {
+    doc.recompute_pending = true;
+  }
+  if (doc.recompute_pending && doc.image_loaded) {
+    doc.recompute_pending = false;
+    launch_recompute(doc, target_width_for(doc, doc.target_scale_perc));
+  }
+
+  if (!doc.recompute_handle.done()) {
+    ImGui::Text("Recomputing...");
+  }
+  if (!doc.order_handle.done()) {
+    ImGui::Text("Computing seam order map...");
+  }
+
+  // Nothing in flight: spend the idle time on what may be asked for next
+  if (doc.speculation_stale && doc.priority == Jobs::Priority::FOCUSED && doc.image_loaded &&
+      !doc.recompute_pending && doc.order_handle.done() && doc.recompute_handle.done()) {
+    launch_speculation(doc);
+  }
+  {
+    std::lock_guard<std::mutex> lock(doc.speculation->mutex);
+    ImGui::TextDisabled("%s %zu width(s), %zu order map(s) precomputed",
+                        doc.speculation_handle.done() ? "Idle:" : "Speculating:",
+                        doc.speculation->results.size(), doc.speculation->orders.size());
+  }
+
+  // With the order map, any width is a per-row prefix filter: rebuild the
+  // column lookup (O(width * height)) and let the shader skip removed pixels
+  int target_width = target_width_for(doc, doc.target_scale_perc);
+  if (warp_active(doc) && target_width > 0 && doc.warped_width != target_width) {
+    doc.warp_lookup.resize(static_cast<size_t>(target_width) * doc.img_h);
+    SeamCarving::build_carve_lookup({doc.seam_order->data(), doc.img_w, doc.img_h, doc.img_w},
+                                    {doc.warp_lookup.data(), target_width, doc.img_h, target_width});
+    if (doc.warped_view.set_lookup(doc.warp_lookup.data(), target_width, doc.img_h)) {
+      doc.warped_width = target_width;
+    }
+  }
+
+  ImGui::Text("Processed (Seam Carved)");
+  if (warp_active(doc) && doc.warped_view.valid()) {
+    doc.warped_view.draw("carved_view", view_scale, max_view_height);
+    ImGui::Text("Carved image size: %dx%d (removed %d seams), shader warp, lookups uploaded %.1f KB",
+                doc.warped_view.width(), doc.img_h, doc.img_w - doc.warped_view.width(),
+                doc.warped_view.lookup_bytes() / 1024.0);
+  } else if (doc.carved_view.valid()) {
+    doc.carved_view.draw("carved_view", view_scale, max_view_height);
+    ImGui::Text("Carved image size: %dx%d (removed %d seams), uploaded %.1f KB",
+                doc.carved_width, doc.img_h, doc.img_w - doc.carved_width,
+                doc.carved_view.uploaded_bytes() / 1024.0);
+  } else {
+    ImGui::Text("Move the slider to see seam carved result");
+  }
+
+  ImGui::Text("Primitive Resized");
+  if (doc.primitive_view.valid()) {
+    doc.primitive_view.draw("primitive_view", view_scale, max_view_height);
+    ImGui::Text("Primitive resized image size: %dx%d (bilinear interpolation), uploaded %.1f KB",
+                doc.primitive_target_width, doc.img_h, doc.primitive_view.uploaded_bytes() / 1024.0);
+  } else {
+    ImGui::Text("Move the slider to see primitive resized result");
+  }
+}
@@ -0,0 +1,229 @@
+#pragma once
+
+#include "carver.h"
+#include "display_texture.h"
+#include "job_pool.h"
+#include "seam_carving.h"
+
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Pixel buffer shared between the UI and the jobs reading it. Jobs hold a
+// reference for as long as they run, so superseded jobs never see freed data.
+using PixelBuffer = std::shared_ptr<unsigned char>;
+
+// Seam order map of an image (see SeamCarving::compute_seam_order), shared
+// read-only with the recompute jobs that gather carved images from it.
+using SeamOrder = std::shared_ptr<const Memory::LargeBuffer<int>>;
+
+// Circle painted into the protection map; weight 0 erases
+struct ProtectionDab {
+  int x = 0, y = 0, radius = 0;
+  float weight = 0.0f;
+};
+
+// Seam order of a JPEG's 8x8 (or larger) DCT block grid, recorded from
+// coefficient energy before the pixels are decoded. Stands in for the exact
+// order until that one is ready; each coarse seam removes factor_x columns.
+struct CoarseOrder {
+  std::shared_ptr<const Memory::LargeBuffer<int>> order; // nullptr = none
+  int width = 0, height = 0;
+  int factor_x = 1, factor_y = 1;
+  int seams = 0;
+  SeamCarving::Algorithm algorithm = SeamCarving::Algorithm::GREEDY;
+};
+
+// Incremental carver of one document. Order jobs hold carve_mutex while they
+// run; the UI only queues dabs, under their own lock, for the next job. The
+// carver keeps its seams between jobs but not its scratch buffers, which are
+// reserved with the memory governor for one job at a time.
+struct CarverSlot {
+  std::mutex carve_mutex;
+  SeamCarving::Carver carver;
+  std::mutex dabs_mutex;
+  std::vector<ProtectionDab> pending_dabs;
+};
+
+// Fast low resolution stand-in shown while the full image decodes
+struct PreviewImage {
+  std::vector<unsigned char> pixels;
+  int width = 0, height = 0;
+  int full_width = 0, full_height = 0;
+};
+
+// Full resolution image as decoded by stb_image
+struct FullImage {
+  PixelBuffer pixels; // nullptr when decoding failed
+  int width = 0, height = 0, channels = 0;
+  std::vector<Display::PyramidLevel> levels;
+  CoarseOrder coarse_order; // JPEGs only
+};
+
+// Output of one background recompute (seam carving + primitive resize)
+struct RecomputeResult {
+  PixelBuffer carved_pixels;
+  std::vector<Display::PyramidLevel> carved_levels;
+  int carved_width = 0;
+  int carved_dirty_x0 = 0; // first column that differs from the previous result
+  PixelBuffer primitive_pixels;
+  std::vector<Display::PyramidLevel> primitive_levels;
+  int target_width = 0;
+  int primitive_dirty_x0 = 0;
+};
+
+// Recompute result made ahead of time for a slider position the user may
+// move to next; carved_pixels is nullptr when the warp shader draws the view
+struct SpeculativeResult {
+  SeamCarving::Algorithm algorithm = SeamCarving::Algorithm::GREEDY;
+  float smoothing = 0.0f;
+  RecomputeResult result;
+};
+
+// Seam order map made ahead of time for an algorithm / blur not selected
+struct SpeculativeOrder {
+  SeamCarving::Algorithm algorithm = SeamCarving::Algorithm::GREEDY;
+  float smoothing = 0.0f;
+  SeamOrder order;
+};
+
+// Results of idle-time speculation, filled by the speculation job and taken
+// by the UI. Everything here belongs to one protection map: painting bumps
+// the generation and drops it all, and jobs of an older generation publish
+// nothing. The slot carves the alternate algorithm; an aborted carve keeps
+// its seams, so preempted speculation resumes where it stopped.
+struct SpeculationCache {
+  std::mutex mutex;
+  int generation = 0;
+  std::vector<SpeculativeResult> results; // least recently made first
+  std::vector<SpeculativeOrder> orders;
+  std::shared_ptr<CarverSlot> slot = std::make_shared<CarverSlot>();
+};
+
+/**
+ * @brief One open image with its own slider, algorithm choice and results
+ */
+struct ImageDocument {
+  int id = 0;
+  std::string path;
+  std::string title; // ImGui window name, unique per document
+  bool open = true;
+  Jobs::Priority priority = Jobs::Priority::VISIBLE;
+
+  // Loading (preview first, then the full image)
+  Jobs::JobHandle load_handle;
+  std::future<PreviewImage> preview_future;
+  std::future<FullImage> full_future;
+  std::vector<unsigned char> preview_data;
+  int preview_w = 0;
+  bool image_loaded = false;
+  bool image_failed = false;
+
+  // Original image
+  PixelBuffer image_data;
+  int img_w = 0, img_h = 0, img_channels = 0;
+
+  // Settings
+  float target_scale_perc = 100.0f; // Scale percentage (10-100%)
+  float zoom = 1.0f;                // View zoom relative to fit-to-window
+  SeamCarving::Algorithm selected_algorithm = SeamCarving::Algorithm::GREEDY;
+  float smoothing_sigma = 0.0f;     // Blur before the energy in pixels, 0 = off
+
+  // Recompute (one job in flight, superseded ones are cancelled)
+  Jobs::JobHandle recompute_handle;
+  std::future<RecomputeResult> recompute_future;
+  bool recompute_pending = false;
+
+  // Seam order map of the selected algorithm, down to the slider minimum.
+  // The carver keeps the seams, so protection edits only redo the seams
+  // they can affect.
+  Jobs::JobHandle order_handle;
+  std::future<SeamOrder> order_future;
+  SeamOrder seam_order;
+  CoarseOrder coarse_order;
+  std::shared_ptr<CarverSlot> carver = std::make_shared<CarverSlot>();
+
+  // Idle-time precomputation of neighbouring slider widths and the other
+  // algorithm's order map. Runs at BACKGROUND priority and is cancelled by
+  // every real request; stale = the cache does not cover the current state.
+  Jobs::JobHandle speculation_handle;
+  std::shared_ptr<SpeculationCache> speculation = std::make_shared<SpeculationCache>();
+  bool speculation_stale = true;
+
+  // Protection brush on the original view
+  bool protect_mode = false;
+  int brush_radius = 24;
+  int last_dab_x = -1, last_dab_y = -1; // -1 = no stroke in progress
+
+  // Carved view warped on the GPU from the order map; slider moves only
+  // rebuild and upload the column lookup
+  Display::WarpedTexture warped_view;
+  std::vector<int> warp_lookup;
+  int warped_width = 0; // width the lookup was built for, 0 = stale
+
+  // Results
+  PixelBuffer carved_image_data;
+  int carved_width = 0;
+  PixelBuffer primitive_resized_data;
+  int primitive_target_width = 0;
+
+  // Display textures of the original, carved and primitive resized images
+  Display::LodTexture original_view;
+  Display::LodTexture carved_view;
+  Display::LodTexture primitive_view;
+};
+
+/**
+ * @brief All open images; their jobs share one priority-aware pool
+ *
+ * The focused image's jobs run at FOCUSED priority, other visible images at
+ * VISIBLE and hidden ones (collapsed or behind another dock tab) at BACKGROUND,
+ * which parks them whenever anything more important is waiting. While the
+ * focused image is idle its speculation job fills the SpeculationCache at
+ * BACKGROUND priority too.
+ */
+class Workspace {
+public:
+  /**
+   * @param pool Worker pool shared by all documents
+   * @param wake Called from worker threads when a result is ready
+   */
+  Workspace(Jobs::JobPool &pool, std::function<void()> wake);
+
+  /// Open an image in a new window; decoding starts immediately
+  void open(const std::string &path);
+
+  /// Draw every document window and collect finished jobs
+  void draw();
+
+  /// Cancel all jobs and release GL textures (needs a current GL context)
+  void clear();
+
+  size_t size() const { return documents_.size(); }
+
+  /// Search DYNAMIC seams in 16-bit levels (SeamCarving::DpMemory::QUANTIZED); redoes open order maps
+  void set_quantized_dp(bool quantized);
+  bool quantized_dp() const { return quantized_dp_; }
+
+private:
+  void launch_load(ImageDocument &doc);
+  void launch_order(ImageDocument &doc);
+  void paint_protection(ImageDocument &doc, int x, int y, float view_scale);
+  void launch_recompute(ImageDocument &doc, int target_width);
+  void launch_speculation(ImageDocument &doc);
+  void cancel_speculation(ImageDocument &doc);
+  bool warp_active(const ImageDocument &doc) const;
+  void poll_jobs(ImageDocument &doc);
+  void update_priority(ImageDocument &doc, Jobs::Priority priority);
+  void draw_document(ImageDocument &doc);
+  void close(ImageDocument &doc);
+
+  Jobs::JobPool &pool_;
+  std::function<void()> wake_;
+  std::vector<std::unique_ptr<ImageDocument>> documents_;
+  int next_id_ = 1;
+  bool quantized_dp_ = false;
+};